@@ -37,6 +37,49 @@ extern "C" {
 # define JSDefaultCalibration		".joystick"
 #endif
 
+/*
+ *	Synthetic Device:
+ *
+ *	A device name that starts with this prefix opens a synthetic
+ *	joystick (Linux only) that generates events for benchmarks and
+ *	tests, the prefix is followed by a comma separated list of
+ *	parameter=value:
+ *
+ *	axes		Number of axises (default 2)
+ *	buttons		Number of buttons (default 2)
+ *	name		Descriptive name
+ *	pattern		One of idle, sweep (default), buttons, burst or
+ *			mixed
+ *	rate		Events per second (default 1000), 0 to generate
+ *			them as fast as they are read
+ *	count		Number of events to generate, 0 for no limit
+ *			(default)
+ *	burst		Events in each burst of the burst pattern
+ *			(default 16)
+ *	seed		Seed for the mixed pattern
+ *
+ *	For example "synthetic:axes=4,buttons=8,pattern=mixed,rate=0".
+ */
+#define JSSyntheticDevicePrefix		"synthetic:"
+
+/*
+ *	Replay Device:
+ *
+ *	A device name that starts with this prefix replays a recording
+ *	made by JSRecordStart() (Linux only), the prefix is followed by
+ *	a comma separated list of parameter=value:
+ *
+ *	speed		1.0 for the recorded speed (default), 0 to replay
+ *			the events as fast as they are read
+ *	start		Time in the recording to start at (in ms)
+ *	file		The recording, this must be the last parameter
+ *
+ *	If there are no parameters then the rest of the device name
+ *	is the recording, for example "replay:speed=0,file=session.jsr"
+ *	or "replay:session.jsr".
+ */
+#define JSReplayDevicePrefix		"replay:"
+
 
 /*
  *	Default Ranges (in raw units):
@@ -58,6 +101,21 @@ extern "C" {
 #define JSFlagIsInit			(1 << 1)
 #define JSFlagNonBlocking		(1 << 2)	/* Open in non-blocking mode */
 #define JSFlagForceFeedback		(1 << 3)	/* Open in read/write mode */
+#define JSFlagReconnect			(1 << 4)	/* Re-attach to the same
+							 * device when it is
+							 * reconnected */
+#define JSFlagCoalesce			(1 << 5)	/* Apply only the last
+							 * event for each axis
+							 * read at once */
+#define JSFlagLatency			(1 << 6)	/* Record the input
+							 * latency */
+
+/*
+ *	Joystick Attributes List Flags:
+ */
+#define JSAttributesFlagCheckInUse	(1 << 1)	/* Open each device
+							 * to check if it is
+							 * in use */
 
 /*
  *	Axis Flags:
@@ -82,6 +140,26 @@ extern "C" {
  */
 #define JSNoEvent			0
 #define JSGotEvent			1
+#define JSEventError			-1	/* Error while waiting for
+							 * events */
+
+/*
+ *	Hotplug Event Codes:
+ */
+#define JSHotplugAdded			1	/* Device connected */
+#define JSHotplugRemoved		2	/* Device disconnected */
+
+/*
+ *	Input Event Types:
+ *
+ *	Also used as the event mask for JSAddEventCallback().
+ */
+#define JSEventAxis			(1 << 0)	/* Axis moved */
+#define JSEventButtonPress		(1 << 1)	/* Button off to on */
+#define JSEventButtonRelease		(1 << 2)	/* Button on to off */
+#define JSEventButton			(JSEventButtonPress | \
+					 JSEventButtonRelease)
+#define JSEventAll			(JSEventAxis | JSEventButton)
 
 /*
  *	Button States:
@@ -151,9 +229,34 @@ typedef struct {
 	time_t		time,
 			last_time;
 
+	/* Number of presses and releases since the last call to
+	 * JSBeginFrame(), a press and release read by the same
+	 * JSUpdate() are both counted
+	 */
+	unsigned int	presses,
+			releases;
+
 } js_button_struct;
 #define JS_BUTTON(p)		((js_button_struct *)(p))
 
+/*
+ *	Joystick Device Identity:
+ *
+ *	Identifies a physical device regardless of which device node
+ *	it is connected as, the calibration for a device is looked up
+ *	by its identity first and then by its device name.
+ */
+typedef struct {
+
+	char		*name;		/* Name reported by the driver */
+	unsigned int	vendor,		/* Vendor and product codes, can */
+			product;	/* be 0 if unknown */
+	char		*phys;		/* Physical location (ie the USB
+					 * port), can be NULL if unknown */
+
+} js_identity_struct;
+#define JS_IDENTITY(p)		((js_identity_struct *)(p))
+
 /*
  *	Opened Joystick Calibration & Resources:
  */
@@ -183,6 +286,11 @@ typedef struct {
 					 * seconds, can be 0 for never
 					 * calibrated */
 	void		*force_feedback;/* Reserved, always NULL for now */
+	void		*priv;		/* Private data of the library,
+					 * can be NULL */
+
+	/* Public (Read-Only) */
+	js_identity_struct	identity;	/* Stable device identity */
 
 } js_data_struct;
 #define JS_DARA(p)		((js_data_struct *)(p))
@@ -208,9 +316,163 @@ typedef struct {
 	 * (see is_configured for that information) */
 	int		not_accessable;
 
+	/* Identity of the device, obtained without opening the
+	 * device */
+	js_identity_struct	identity;
+
 } js_attribute_struct;
 #define JS_ATTRIBUTE(p)		((js_attribute_struct *)(p))
 
+/*
+ *	Joystick Event:
+ *
+ *	An axis or button change read from an event ring by
+ *	JSEventReaderRead().
+ */
+typedef struct {
+
+	int		type;		/* One of JSEvent* */
+	int		number;		/* Axis or button number */
+	int		value;		/* New axis value or button state */
+	time_t		time;		/* Time stamp (in ms) */
+
+} js_event_struct;
+#define JS_EVENT(p)		((js_event_struct *)(p))
+
+/*
+ *	Joystick Event Reader:
+ *
+ *	Each reader has its own position in a joystick's event ring so
+ *	every reader sees every event.
+ */
+typedef struct {
+
+	void		*ring;		/* Private */
+	unsigned long	position;	/* Position of the next event */
+	unsigned long	overruns;	/* Number of events overwritten
+					 * before they were read */
+
+} js_event_reader_struct;
+#define JS_EVENT_READER(p)	((js_event_reader_struct *)(p))
+
+/*
+ *	Joystick Statistics:
+ *
+ *	Counted by JSUpdate() since the joystick was initialized or
+ *	since the last call to JSResetStats().
+ */
+#define JSStatsMaxAxises		64	/* Axises with event
+							 * counts */
+typedef struct {
+
+	unsigned long	updates,	/* Calls to JSUpdate() */
+			reads,		/* Reads from the device */
+			empty_reads,	/* Reads that got no events */
+			events,		/* Events read */
+			events_coalesced,	/* Axis events skipped
+						 * by JSFlagCoalesce */
+			full_reads,	/* Reads that got as many events
+					 * as JSUpdate() handles at once,
+					 * more may have been queued */
+			overflows;	/* Times the driver's event queue
+					 * overflowed */
+	unsigned long	axis_events[JSStatsMaxAxises];	/* Events for
+							 * each axis */
+	unsigned long	elapsed_ms;	/* Time counted (in ms) */
+
+} js_stats_struct;
+#define JS_STATS(p)		((js_stats_struct *)(p))
+
+/*
+ *	Latency Histograms:
+ */
+#define JSLatencyApply			0	/* From the driver's time
+							 * stamp to JSUpdate() */
+#define JSLatencyConsume		1	/* From the driver's time
+							 * stamp to
+							 * JSMarkConsumed() */
+
+/*
+ *	Latency Summary (in microseconds):
+ */
+typedef struct {
+
+	unsigned long	count;		/* Events recorded */
+	unsigned long	min,
+			max,
+			mean;
+	unsigned long	p50,		/* Percentiles */
+			p90,
+			p99,
+			p999;
+
+} js_latency_struct;
+#define JS_LATENCY(p)		((js_latency_struct *)(p))
+
+/*
+ *	Poll Policy:
+ *
+ *	How JSWaitEvent(), JSWaitEventMany() and the reader thread
+ *	started by JSReaderStart() wait for events.
+ */
+#define JSPollModeDefault		0	/* Wait as requested */
+#define JSPollModeIdle			1	/* Wait longer and longer
+						 * while there are no
+						 * events */
+#define JSPollModeLatency		2	/* Busy-poll without
+						 * sleeping */
+
+#define JSDefaultPollIdleQuietMS	1000
+#define JSDefaultPollIdleMaxMS		2000
+
+typedef struct {
+
+	int		mode;		/* One of JSPollMode* */
+
+	/* JSPollModeIdle, 0 for the defaults */
+	int		idle_quiet_ms,	/* Time without events before
+					 * backing off */
+			idle_max_ms;	/* Longest wait */
+
+	/* JSPollModeLatency reader thread */
+	int		cpu,		/* CPU to run on or -1 for any */
+			priority;	/* SCHED_FIFO priority or 0 for
+					 * the normal scheduler */
+
+} js_poll_policy_struct;
+#define JS_POLL_POLICY(p)	((js_poll_policy_struct *)(p))
+
+/*
+ *	Hotplug Callback:
+ *
+ *	The event is one of JSHotplug*, the device_name is the device
+ *	node and identity is the device's identity.
+ */
+typedef void (*js_hotplug_func)(
+	int event,
+	const char *device_name,
+	const js_identity_struct *identity,
+	void *data
+);
+
+/*
+ *	Event Callback:
+ *
+ *	The event is one of JSEvent* and number is the axis or button
+ *	number on jsd, the new value is already set on jsd when the
+ *	callback is called.
+ *
+ *	The callback may call JSClose() on jsd, the joystick is then
+ *	closed when JSUpdate() returns. It must not call JSClose() when
+ *	it is run by the reader thread started by JSReaderStart().
+ */
+typedef void (*js_event_func)(
+	js_data_struct *jsd,
+	int event,
+	int number,
+	void *data
+);
+
 
 /*
  *      Loads the calibration data from the calibration file specifeid
@@ -219,6 +481,9 @@ typedef struct {
  *      file if (and only if) it is found then the axis and button
  *      values for that device will be loaded.
  *
+ *	The entry is looked up by the identity on the jsd first and
+ *	then by its device name.
+ *
  *      Additional axises and buttons may be allocated on the given
  *      jsd structure by this function if they are found to be defined
  *      for the device in question in the calibration file.
@@ -249,6 +514,10 @@ extern char **JSLoadDeviceNamesUNIX(
 
 /*
  *	Checks if the joystick is initialized.
+ *
+ *	A joystick opened with JSFlagReconnect is not initialized
+ *	while its device is disconnected, it must still be closed
+ *	with JSClose().
  */
 #if defined(__cplusplus) || defined(c_plusplus)
 extern "C" int JSIsInit(js_data_struct *jsd);
@@ -267,6 +536,9 @@ extern int JSIsInit(js_data_struct *jsd);
  *
  *	If the specified calibration file calibration is NULL then the
  *	is_configured and name values will not be obtained.
+ *
+ *	The devices are found through sysfs when it is available and
+ *	are not opened, so is_in_use is always 0.
  */
 #if defined(__cplusplus) || defined(c_plusplus)
 extern "C" js_attribute_struct *JSGetAttributesList(
@@ -278,6 +550,61 @@ extern js_attribute_struct *JSGetAttributesList(
 );
 #endif
 
+/*
+ *	Same as JSGetAttributesList() except that flags specifies
+ *	which additional values to obtain, any of JSAttributesFlag*.
+ *
+ *	If JSAttributesFlagCheckInUse is specified then each device is
+ *	opened to check if it is in use.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" js_attribute_struct *JSGetAttributesListFlags(
+	int *total, const char *calibration,
+	unsigned int flags
+);
+#else
+extern js_attribute_struct *JSGetAttributesListFlags(
+	int *total, const char *calibration,
+	unsigned int flags
+);
+#endif
+
+/*
+ *	Same as JSGetAttributesList() except that the list is taken
+ *	from a cache which is rebuilt only when a joystick device node
+ *	or the calibration file calibration has changed.
+ *
+ *	If generation is not NULL then it will be set to the cache's
+ *	generation, see JSGetAttributesGeneration().
+ *
+ *	The returned list must be deleted by calling
+ *	JSFreeAttributesList().
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" js_attribute_struct *JSGetAttributesListCached(
+	int *total, const char *calibration,
+	unsigned long *generation
+);
+#else
+extern js_attribute_struct *JSGetAttributesListCached(
+	int *total, const char *calibration,
+	unsigned long *generation
+);
+#endif
+
+/*
+ *	Returns the generation of the cached Joystick Attributes list
+ *	for the calibration file calibration.
+ *
+ *	The generation changes only when the list changes, so callers
+ *	can skip getting the list again when it is unchanged.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" unsigned long JSGetAttributesGeneration(const char *calibration);
+#else
+extern unsigned long JSGetAttributesGeneration(const char *calibration);
+#endif
+
 /*
  *	Deletes the Joystick Attributes list.
  */
@@ -362,6 +689,137 @@ extern "C" int JSGetButtonState(js_data_struct *jsd, int n);
 extern int JSGetButtonState(js_data_struct *jsd, int n);
 #endif
 
+/*
+ *	Inline Accessors:
+ *
+ *	If JSW_INLINE_ACCESSORS is defined before this file is
+ *	included, JSIsAxisAllocated(), JSIsButtonAllocated() and
+ *	JSGetButtonState() are expanded inline instead of calling the
+ *	library. Taking their addresses still gives the library's
+ *	functions.
+ *
+ *	JSGetAxisCoeff() and JSGetAxisCoeffNZ() are not trivial, they
+ *	can be inlined by linking with the static library built with
+ *	link time optimization.
+ */
+#if defined(JSW_INLINE_ACCESSORS)
+#if defined(__cplusplus) || defined(c_plusplus) || \
+    (defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 199901L))
+# define JSW_INLINE	static inline
+#else
+# define JSW_INLINE	static __inline__
+#endif
+
+JSW_INLINE int JSIsAxisAllocatedInline(js_data_struct *jsd, int n)
+{
+	return(
+	    (jsd != NULL) && (n >= 0) && (n < jsd->total_axises) &&
+	    (jsd->axis[n] != NULL)
+	);
+}
+
+JSW_INLINE int JSIsButtonAllocatedInline(js_data_struct *jsd, int n)
+{
+	return(
+	    (jsd != NULL) && (n >= 0) && (n < jsd->total_buttons) &&
+	    (jsd->button[n] != NULL)
+	);
+}
+
+JSW_INLINE int JSGetButtonStateInline(js_data_struct *jsd, int n)
+{
+	return(
+	    JSIsButtonAllocatedInline(jsd, n) ?
+		jsd->button[n]->state : JSButtonStateOff
+	);
+}
+
+#define JSIsAxisAllocated(jsd,n)	JSIsAxisAllocatedInline((jsd), (n))
+#define JSIsButtonAllocated(jsd,n)	JSIsButtonAllocatedInline((jsd), (n))
+#define JSGetButtonState(jsd,n)		JSGetButtonStateInline((jsd), (n))
+#endif	/* JSW_INLINE_ACCESSORS */
+
+/*
+ *	Gets the number of times button n was pressed or released
+ *	since the last call to JSBeginFrame().
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" unsigned int JSGetButtonPresses(js_data_struct *jsd, int n);
+extern "C" unsigned int JSGetButtonReleases(js_data_struct *jsd, int n);
+#else
+extern unsigned int JSGetButtonPresses(js_data_struct *jsd, int n);
+extern unsigned int JSGetButtonReleases(js_data_struct *jsd, int n);
+#endif
+
+/*
+ *	Starts a new frame, resets the number of presses and releases
+ *	counted on each button.
+ *
+ *	Call this once per frame before reading the buttons so that a
+ *	button that was pressed and released between two frames is
+ *	not missed. This must be called from the thread that calls
+ *	JSUpdate(), which is the event callbacks while the reader
+ *	thread started by JSReaderStart() is running.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" void JSBeginFrame(js_data_struct *jsd);
+#else
+extern void JSBeginFrame(js_data_struct *jsd);
+#endif
+
+/*
+ *	Keeps the values and time stamps of the last samples events
+ *	of axis n, 0 stops keeping them.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" int JSSetAxisHistory(js_data_struct *jsd, int n, int samples);
+#else
+extern int JSSetAxisHistory(js_data_struct *jsd, int n, int samples);
+#endif
+
+/*
+ *	Gets sample i of axis n's history, 0 is the newest.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" int JSGetAxisHistorySample(
+	js_data_struct *jsd, int n, int i,
+	int *value, time_t *t
+);
+#else
+extern int JSGetAxisHistorySample(
+	js_data_struct *jsd, int n, int i,
+	int *value, time_t *t
+);
+#endif
+
+/*
+ *	Returns the velocity (in raw units per second) and the
+ *	acceleration (in raw units per second squared) of axis n over
+ *	its history.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" double JSGetAxisVelocity(js_data_struct *jsd, int n);
+extern "C" double JSGetAxisAcceleration(js_data_struct *jsd, int n);
+#else
+extern double JSGetAxisVelocity(js_data_struct *jsd, int n);
+extern double JSGetAxisAcceleration(js_data_struct *jsd, int n);
+#endif
+
+/*
+ *	Gets the smallest and largest raw values in axis n's history.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" int JSGetAxisHistoryRange(
+	js_data_struct *jsd, int n,
+	int *min, int *max
+);
+#else
+extern int JSGetAxisHistoryRange(
+	js_data_struct *jsd, int n,
+	int *min, int *max
+);
+#endif
+
 /*
  *      Applies the tolorance value defined on each axis on the given
  *      jsd to the low-level joystick driver's tolorance.
@@ -392,6 +850,8 @@ extern void JSResetAllAxisTolorance(js_data_struct *jsd);
  *
  *	JSFlagNonBlocking		Open in non-blocking mode.
  *	JSFlagForceFeedback		Open in read/write mode.
+ *	JSFlagReconnect			Re-attach to the same device
+ *					when it is reconnected.
  */
 #if defined(__cplusplus) || defined(c_plusplus)
 extern "C" int JSInit(
@@ -409,6 +869,70 @@ extern int JSInit(
 );
 #endif
 
+/*
+ *	Same as JSInit() except that the calibration is loaded on a
+ *	worker thread.
+ *
+ *	The joystick can be used as soon as this function returns, its
+ *	axises will have default calibration values until the
+ *	calibration has been loaded. The calibration is applied by
+ *	JSUpdate() once it has been loaded or by JSInitWait().
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" int JSInitAsync(
+	js_data_struct *jsd,
+	const char *device,
+	const char *calibration,
+	unsigned int flags
+);
+#else
+extern int JSInitAsync(
+	js_data_struct *jsd,
+	const char *device,
+	const char *calibration,
+	unsigned int flags
+);
+#endif
+
+/*
+ *	Initializes total joysticks at the same time, the joystick
+ *	specified by device[i] is initialized on jsd[i] as if by
+ *	JSInit() and status[i] is set to what JSInit() would have
+ *	returned. The calibration file is read only once.
+ *
+ *	Returns JSSuccess if all the joysticks were initialized or
+ *	JSError if some were not.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" int JSInitMany(
+	js_data_struct *jsd,
+	const char **device,
+	int total,
+	const char *calibration,
+	unsigned int flags,
+	int *status
+);
+#else
+extern int JSInitMany(
+	js_data_struct *jsd,
+	const char **device,
+	int total,
+	const char *calibration,
+	unsigned int flags,
+	int *status
+);
+#endif
+
+/*
+ *	Waits for the calibration being loaded by JSInitAsync() and
+ *	applies it.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" int JSInitWait(js_data_struct *jsd);
+#else
+extern int JSInitWait(js_data_struct *jsd);
+#endif
+
 /*
  *	Fetches the next event and updates joystick values specified in
  *	the jsd.  Can return JSNoEvent or JSGotEvent depending on if
@@ -420,10 +944,255 @@ extern "C" int JSUpdate(js_data_struct *jsd);
 extern int JSUpdate(js_data_struct *jsd);
 #endif
 
+/*
+ *	Sets up the reader to read the events that JSUpdate() adds to
+ *	the joystick's event ring from now on, each reader sees every
+ *	event.
+ *
+ *	This must be called from the thread that calls JSUpdate(), the
+ *	reader can then be read from any thread until jsd is closed.
+ *	With the reader thread started by JSReaderStart() this must be
+ *	called before it is started or from an event callback.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" int JSEventReaderInit(
+	js_data_struct *jsd, js_event_reader_struct *reader
+);
+#else
+extern int JSEventReaderInit(
+	js_data_struct *jsd, js_event_reader_struct *reader
+);
+#endif
+
+/*
+ *	Reads up to total events from the reader into the array
+ *	event, returns the number of events read.
+ *
+ *	Events overwritten before they were read are counted in the
+ *	reader's overruns.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" int JSEventReaderRead(
+	js_event_reader_struct *reader,
+	js_event_struct *event, int total
+);
+#else
+extern int JSEventReaderRead(
+	js_event_reader_struct *reader,
+	js_event_struct *event, int total
+);
+#endif
+
+/*
+ *	Gets the joystick's statistics, the counters can be read from
+ *	any thread while another thread calls JSUpdate().
+ *
+ *	Dividing reads by updates gives the system calls made by each
+ *	JSUpdate(), events by reads gives the events handled by each
+ *	read and axis_events by elapsed_ms gives each axis' event rate.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" int JSGetStats(js_data_struct *jsd, js_stats_struct *stats);
+#else
+extern int JSGetStats(js_data_struct *jsd, js_stats_struct *stats);
+#endif
+
+/*
+ *	Resets the joystick's statistics to zero.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" void JSResetStats(js_data_struct *jsd);
+#else
+extern void JSResetStats(js_data_struct *jsd);
+#endif
+
+/*
+ *	Marks all the events applied by JSUpdate() so far as consumed
+ *	by the application, their latency is recorded in the
+ *	JSLatencyConsume histogram.
+ *
+ *	Does nothing unless the joystick was initialized with
+ *	JSFlagLatency. This must be called from the thread that calls
+ *	JSUpdate(), which is the event callbacks while the reader
+ *	thread started by JSReaderStart() is running.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" void JSMarkConsumed(js_data_struct *jsd);
+#else
+extern void JSMarkConsumed(js_data_struct *jsd);
+#endif
+
+/*
+ *	Gets the summary of the latency histogram which, one of
+ *	JSLatency*, the values are in microseconds.
+ *
+ *	The joystick must be initialized with JSFlagLatency. This can
+ *	be called from any thread.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" int JSGetLatency(
+	js_data_struct *jsd, int which,
+	js_latency_struct *latency
+);
+#else
+extern int JSGetLatency(
+	js_data_struct *jsd, int which,
+	js_latency_struct *latency
+);
+#endif
+
+/*
+ *	Resets the latency histograms.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" void JSResetLatency(js_data_struct *jsd);
+#else
+extern void JSResetLatency(js_data_struct *jsd);
+#endif
+
+/*
+ *	Starts recording every event that JSUpdate() reads from the
+ *	joystick, with its time stamps, to the file specified by path.
+ *
+ *	The recording can be replayed through JSUpdate() by opening it
+ *	with JSInit() as a device named JSReplayDevicePrefix followed
+ *	by the path.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" int JSRecordStart(js_data_struct *jsd, const char *path);
+#else
+extern int JSRecordStart(js_data_struct *jsd, const char *path);
+#endif
+
+/*
+ *	Stops recording and writes the rest of the recording.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" void JSRecordStop(js_data_struct *jsd);
+#else
+extern void JSRecordStop(js_data_struct *jsd);
+#endif
+
+/*
+ *	Returns a descriptor that becomes readable when JSUpdate()
+ *	should be called, for use with select(), poll() or an external
+ *	event loop.
+ *
+ *	If JSFlagReconnect is set then the descriptor stays the same
+ *	when the device is disconnected and reconnected, otherwise it
+ *	is the device's descriptor. While the reader thread started by
+ *	JSReaderStart() is running it is an eventfd that becomes
+ *	readable after each JSUpdate() by the thread.
+ *
+ *	Returns -1 on error or if the joystick is not initialized.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" int JSGetPollFD(js_data_struct *jsd);
+#else
+extern int JSGetPollFD(js_data_struct *jsd);
+#endif
+
+/*
+ *	Waits until the joystick has events for JSUpdate() to handle or
+ *	until timeout_ms milliseconds have passed, if timeout_ms is
+ *	negative then waits forever.
+ *
+ *	Returns JSGotEvent if JSUpdate() should be called, JSNoEvent on
+ *	timeout or JSEventError on error.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" int JSWaitEvent(js_data_struct *jsd, int timeout_ms);
+#else
+extern int JSWaitEvent(js_data_struct *jsd, int timeout_ms);
+#endif
+
+/*
+ *	Same as JSWaitEvent() except that it waits on the array of
+ *	total joysticks jsd.
+ *
+ *	If ready is not NULL then it must be an array of total ints,
+ *	each is set to JSGotEvent or JSNoEvent for the joystick at the
+ *	same index.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" int JSWaitEventMany(
+	js_data_struct *jsd, int total,
+	int timeout_ms, int *ready
+);
+#else
+extern int JSWaitEventMany(
+	js_data_struct *jsd, int total,
+	int timeout_ms, int *ready
+);
+#endif
+
+/*
+ *	Sets how JSWaitEvent(), JSWaitEventMany() and the reader
+ *	thread wait for events, if policy is NULL then the default
+ *	is set.
+ *
+ *	JSPollModeIdle doubles the timeout of each wait once there
+ *	have been no events for idle_quiet_ms, up to idle_max_ms, and
+ *	goes back to the requested timeout on the first event.
+ *	JSPollModeLatency busy-polls and runs the reader thread with
+ *	the SCHED_FIFO priority on the CPU.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" int JSSetPollPolicy(
+	js_data_struct *jsd, const js_poll_policy_struct *policy
+);
+#else
+extern int JSSetPollPolicy(
+	js_data_struct *jsd, const js_poll_policy_struct *policy
+);
+#endif
+
+/*
+ *	Starts a thread that calls JSUpdate() whenever the joystick
+ *	has events. JSUpdate() must then not be called by any other
+ *	thread, the events can be read with JSEventReaderRead() or
+ *	handled by event callbacks which are called by the thread.
+ *
+ *	JSEventReaderInit(), JSBeginFrame() and JSMarkConsumed() must
+ *	then only be called from the event callbacks.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" int JSReaderStart(js_data_struct *jsd);
+#else
+extern int JSReaderStart(js_data_struct *jsd);
+#endif
+
+/*
+ *	Gets the poll policy that the reader thread runs with, the
+ *	priority is 0 and the cpu is -1 if JSReaderStart() could not
+ *	set them.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" int JSGetReaderPolicy(
+	js_data_struct *jsd, js_poll_policy_struct *policy
+);
+#else
+extern int JSGetReaderPolicy(
+	js_data_struct *jsd, js_poll_policy_struct *policy
+);
+#endif
+
+/*
+ *	Stops the reader thread, JSClose() also stops it.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" void JSReaderStop(js_data_struct *jsd);
+#else
+extern void JSReaderStop(js_data_struct *jsd);
+#endif
+
 /*
  *      Closes the joystick and deallocates all resources on the given
  *      jsd structure. The jsd structure itself is not deallocated however
  *      its values will be reset to defaults.
+ *
+ *	When called by an event callback the joystick is closed when
+ *	JSUpdate() returns.
  */
 #if defined(__cplusplus) || defined(c_plusplus)
 extern "C" void JSClose(js_data_struct *jsd);
@@ -432,6 +1201,94 @@ extern void JSClose(js_data_struct *jsd);
 #endif
 
 
+/*
+ *	Adds a callback to be called by JSUpdate() when an axis or
+ *	button on jsd changes, only the axises and buttons that changed
+ *	are reported.
+ *
+ *	The event_mask specifies which events to call the callback for,
+ *	any of JSEvent*. The number specifies the axis or button number
+ *	or -1 for all of them.
+ *
+ *	jsd needs to be previously initialized by a call to JSInit(),
+ *	the callbacks are removed by JSClose().
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" int JSAddEventCallback(
+	js_data_struct *jsd,
+	unsigned int event_mask, int number,
+	js_event_func func, void *data
+);
+#else
+extern int JSAddEventCallback(
+	js_data_struct *jsd,
+	unsigned int event_mask, int number,
+	js_event_func func, void *data
+);
+#endif
+
+/*
+ *	Removes all the callbacks on jsd with the same func and data
+ *	added by JSAddEventCallback().
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" void JSRemoveEventCallback(
+	js_data_struct *jsd,
+	js_event_func func, void *data
+);
+#else
+extern void JSRemoveEventCallback(
+	js_data_struct *jsd,
+	js_event_func func, void *data
+);
+#endif
+
+
+/*
+ *	Adds a callback to be called by JSHotplugUpdate() when a
+ *	joystick device is connected or disconnected.
+ *
+ *	The hotplug monitor is started when the first callback is
+ *	added and stopped when the last callback is removed.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" int JSHotplugAddCallback(js_hotplug_func func, void *data);
+#else
+extern int JSHotplugAddCallback(js_hotplug_func func, void *data);
+#endif
+
+/*
+ *	Removes a callback added by JSHotplugAddCallback().
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" void JSHotplugRemoveCallback(js_hotplug_func func, void *data);
+#else
+extern void JSHotplugRemoveCallback(js_hotplug_func func, void *data);
+#endif
+
+/*
+ *	Returns the hotplug monitor's descriptor for use with select()
+ *	or poll(), it becomes readable when JSHotplugUpdate() has
+ *	events to handle. Returns -1 if the monitor is not started.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" int JSHotplugGetFD(void);
+#else
+extern int JSHotplugGetFD(void);
+#endif
+
+/*
+ *	Handles pending hotplug events and calls the callbacks. Can
+ *	return JSNoEvent or JSGotEvent depending on if any callbacks
+ *	were called.
+ */
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" int JSHotplugUpdate(void);
+#else
+extern int JSHotplugUpdate(void);
+#endif
+
+
 #ifdef __cplusplus
 }
 #endif
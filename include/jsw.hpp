@@ -0,0 +1,573 @@
+/*
+	        Joystick Wrapper Library - C++20 Coroutines
+
+	Awaitable joystick events on top of libjsw, for example:
+
+		jsw::reactor r;
+		jsw::joystick js(r, "/dev/input/js0");
+
+		jsw::task watch(jsw::joystick &js)
+		{
+		    for(;;)
+		    {
+			jsw::event ev = co_await js.next_event();
+			...
+		    }
+		}
+
+		r.run();
+
+	The coroutines are resumed by the reactor's thread from
+	reactor::run() or reactor::run_once(), one epoll descriptor
+	serves all the joysticks so no thread is parked per joystick.
+
+	Awaiting an event does not allocate, the events are queued in
+	a fixed size ring on each joystick and the awaiters are linked
+	into lists in place.
+ */
+
+#ifndef JSW_HPP
+#define JSW_HPP
+
+#include <cerrno>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "jsw.h"
+
+
+namespace jsw {
+
+class reactor;
+class joystick;
+
+
+/*
+ *	Event:
+ *
+ *	The type is one of JSEvent* and number is the axis or button
+ *	number, value is the axis value or button state after the
+ *	event.
+ *
+ *	The type is JSEventError if the joystick's device was lost,
+ *	see joystick::lost().
+ */
+struct event {
+
+	int		type;
+	int		number;
+	int		value;
+
+};
+
+
+/*
+ *	Detached Coroutine:
+ *
+ *	A coroutine returning task starts right away and deletes
+ *	itself when it finishes.
+ */
+struct task {
+
+	struct promise_type {
+		task get_return_object() noexcept { return task(); }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() noexcept {}
+		void unhandled_exception() { std::terminate(); }
+	};
+
+};
+
+
+namespace detail {
+
+/*
+ *	Awaiter Link:
+ *
+ *	Each suspended awaiter is linked into its joystick's list of
+ *	waiters and then into the reactor's list of awaiters to resume.
+ */
+struct waiter {
+
+	waiter		*prev = nullptr,
+			*next = nullptr;
+	std::coroutine_handle<>	handle;
+	int		button = -1;	/* Button number or -1 for the
+					 * next event */
+	event		result = {};
+	bool		linked = false;
+
+};
+
+/*
+ *	Intrusive List of Awaiters:
+ */
+struct waiter_list {
+
+	waiter		*head = nullptr,
+			*tail = nullptr;
+
+	bool empty() const noexcept { return(head == nullptr); }
+
+	void push_back(waiter *w) noexcept
+	{
+	    w->prev = tail;
+	    w->next = nullptr;
+	    if(tail != nullptr)
+		tail->next = w;
+	    else
+		head = w;
+	    tail = w;
+	    w->linked = true;
+	}
+
+	void erase(waiter *w) noexcept
+	{
+	    if(w->prev != nullptr)
+		w->prev->next = w->next;
+	    else
+		head = w->next;
+	    if(w->next != nullptr)
+		w->next->prev = w->prev;
+	    else
+		tail = w->prev;
+	    w->prev = w->next = nullptr;
+	    w->linked = false;
+	}
+
+	waiter *pop_front() noexcept
+	{
+	    waiter *w = head;
+	    if(w != nullptr)
+		erase(w);
+	    return(w);
+	}
+
+};
+
+}	/* namespace detail */
+
+
+/*
+ *	Reactor:
+ *
+ *	Waits on all of its joysticks with one epoll descriptor, calls
+ *	JSUpdate() on the ones that are ready and resumes the
+ *	coroutines waiting on them.
+ */
+class reactor {
+
+    public:
+	reactor() : epoll_fd(epoll_create1(EPOLL_CLOEXEC)) {}
+	~reactor()
+	{
+	    if(epoll_fd > -1)
+		close(epoll_fd);
+	}
+
+	reactor(const reactor &) = delete;
+	reactor &operator=(const reactor &) = delete;
+
+	/*
+	 *	Waits up to timeout_ms milliseconds (forever if negative)
+	 *	for joystick events and resumes the coroutines waiting
+	 *	for them.
+	 *
+	 *	Returns the number of coroutines resumed or -1 on error.
+	 */
+	inline int run_once(int timeout_ms = -1);
+
+	/*
+	 *	Calls run_once() until stop() is called or there are no
+	 *	more joysticks.
+	 */
+	void run()
+	{
+	    stopped = false;
+	    while(!stopped && (total_joysticks > 0))
+	    {
+		if(run_once(-1) < 0)
+		    break;
+	    }
+	}
+
+	void stop() noexcept { stopped = true; }
+
+    private:
+	friend class joystick;
+
+	/* Number of joysticks handled by each epoll_wait() */
+	static constexpr int max_events = 16;
+
+	int		epoll_fd;
+	int		total_joysticks = 0;
+	bool		stopped = false;
+
+	/* Awaiters to resume after JSUpdate() has returned */
+	detail::waiter_list	ready;
+
+	inline bool add(joystick *js, int fd);
+	inline void remove(int fd);
+
+};
+
+
+/*
+ *	Joystick:
+ *
+ *	Opens the joystick as if by JSInit() in non-blocking mode and
+ *	adds it to the reactor. The joystick must outlive the
+ *	coroutines awaiting on it.
+ */
+class joystick {
+
+    public:
+	/* Number of events queued for next_event() */
+	static constexpr int queue_size = 64;
+
+	joystick(
+	    reactor &r,
+	    const char *device = JSDefaultDevice,
+	    const char *calibration = nullptr,
+	    unsigned int flags = 0
+	) : owner(r)
+	{
+	    status_code = JSInit(
+		&jsd, device, calibration, flags | JSFlagNonBlocking
+	    );
+	    if(status_code != JSSuccess)
+		return;
+
+	    /* The callbacks record each changed axis and button */
+	    JSAddEventCallback(&jsd, JSEventAll, -1, &joystick::on_event, this);
+
+	    poll_fd = JSGetPollFD(&jsd);
+	    if(!owner.add(this, poll_fd))
+		poll_fd = -1;
+	}
+
+	~joystick()
+	{
+	    if(poll_fd > -1)
+		owner.remove(poll_fd);
+	    JSClose(&jsd);
+	}
+
+	joystick(const joystick &) = delete;
+	joystick &operator=(const joystick &) = delete;
+
+	/* Returns the result of JSInit() */
+	int status() const noexcept { return(status_code); }
+
+	/* Returns the libjsw joystick, which can be used with all the
+	 * libjsw functions except JSUpdate() and JSClose()
+	 */
+	js_data_struct *get() noexcept { return(&jsd); }
+
+	/* Number of events dropped because the queue was full */
+	unsigned long dropped() const noexcept { return(total_dropped); }
+
+	/* Returns true if the device was disconnected while the
+	 * joystick was opened without JSFlagReconnect, the joystick is
+	 * then removed from the reactor and all its awaiters complete
+	 * with a JSEventError event
+	 */
+	bool lost() const noexcept { return(device_lost); }
+
+
+	/*
+	 *	Awaitable for the next queued event.
+	 */
+	class next_event_awaiter {
+
+	    public:
+		explicit next_event_awaiter(joystick &js) noexcept : js(js) {}
+		~next_event_awaiter()
+		{
+		    if(w.linked)
+			js.unlink(&w);
+		}
+
+		bool await_ready() noexcept
+		{
+		    if(js.pop(w.result))
+			return(true);
+		    if(js.device_lost)
+		    {
+			w.result = lost_event();
+			return(true);
+		    }
+		    return(false);
+		}
+		void await_suspend(std::coroutine_handle<> h) noexcept
+		{
+		    w.handle = h;
+		    w.button = -1;
+		    js.event_waiters.push_back(&w);
+		}
+		event await_resume() noexcept { return(w.result); }
+
+	    private:
+		joystick	&js;
+		detail::waiter	w;
+
+	};
+
+	/*
+	 *	Awaitable for the next press of a button, the result is
+	 *	the press event.
+	 */
+	class button_awaiter {
+
+	    public:
+		button_awaiter(joystick &js, int n) noexcept : js(js)
+		{
+		    w.button = n;
+		}
+		~button_awaiter()
+		{
+		    if(w.linked)
+			js.unlink(&w);
+		}
+
+		bool await_ready() noexcept
+		{
+		    if(js.device_lost)
+		    {
+			w.result = lost_event();
+			return(true);
+		    }
+		    return(false);
+		}
+		void await_suspend(std::coroutine_handle<> h) noexcept
+		{
+		    w.handle = h;
+		    js.button_waiters.push_back(&w);
+		}
+		event await_resume() noexcept { return(w.result); }
+
+	    private:
+		joystick	&js;
+		detail::waiter	w;
+
+	};
+
+	next_event_awaiter next_event() noexcept
+	{
+	    return(next_event_awaiter(*this));
+	}
+	button_awaiter wait_button(int n) noexcept
+	{
+	    return(button_awaiter(*this, n));
+	}
+
+    private:
+	friend class reactor;
+
+	reactor		&owner;
+	js_data_struct	jsd = {};
+	int		status_code = JSError,
+			poll_fd = -1;
+	bool		device_lost = false;
+
+	/* Queued events */
+	event		queue[queue_size];
+	int		queue_head = 0,
+			total_queued = 0;
+	unsigned long	total_dropped = 0;
+
+	detail::waiter_list	event_waiters,
+				button_waiters;
+
+	static event lost_event() noexcept
+	{
+	    event ev;
+	    ev.type = JSEventError;
+	    ev.number = -1;
+	    ev.value = 0;
+	    return(ev);
+	}
+
+	bool pop(event &ev) noexcept
+	{
+	    if(total_queued == 0)
+		return(false);
+	    ev = queue[queue_head];
+	    queue_head = (queue_head + 1) % queue_size;
+	    total_queued--;
+	    return(true);
+	}
+
+	void push(const event &ev) noexcept
+	{
+	    if(total_queued == queue_size)
+	    {
+		/* Drop the oldest event */
+		queue_head = (queue_head + 1) % queue_size;
+		total_queued--;
+		total_dropped++;
+	    }
+	    queue[(queue_head + total_queued) % queue_size] = ev;
+	    total_queued++;
+	}
+
+	void unlink(detail::waiter *w) noexcept
+	{
+	    /* The awaiter is either waiting on this joystick or is
+	     * about to be resumed by the reactor
+	     */
+	    detail::waiter *p;
+	    for(p = owner.ready.head; p != nullptr; p = p->next)
+	    {
+		if(p == w)
+		{
+		    owner.ready.erase(w);
+		    return;
+		}
+	    }
+	    if(w->button < 0)
+		event_waiters.erase(w);
+	    else
+		button_waiters.erase(w);
+	}
+
+	/* Called by JSUpdate() for each changed axis and button */
+	static void on_event(
+	    js_data_struct *jsd, int type, int number, void *data
+	)
+	{
+	    joystick *js = static_cast<joystick *>(data);
+	    detail::waiter *w, *next;
+	    event ev;
+
+	    ev.type = type;
+	    ev.number = number;
+	    ev.value = (type == JSEventAxis) ?
+		jsd->axis[number]->cur : jsd->button[number]->state;
+
+	    if(type == JSEventButtonPress)
+	    {
+		for(w = js->button_waiters.head; w != nullptr; w = next)
+		{
+		    next = w->next;
+		    if(w->button != number)
+			continue;
+		    js->button_waiters.erase(w);
+		    w->result = ev;
+		    js->owner.ready.push_back(w);
+		}
+	    }
+
+	    js->push(ev);
+	}
+
+	/* Called by the reactor after JSUpdate() to hand the queued
+	 * events to the coroutines waiting for them
+	 */
+	void deliver() noexcept
+	{
+	    detail::waiter *w;
+	    while(!event_waiters.empty() && (total_queued > 0))
+	    {
+		w = event_waiters.pop_front();
+		pop(w->result);
+		owner.ready.push_back(w);
+	    }
+	}
+
+	/* Called by the reactor when the device was disconnected and
+	 * will not be reconnected, removes the joystick from the
+	 * reactor and completes all of its awaiters
+	 */
+	void lose() noexcept
+	{
+	    detail::waiter *w;
+
+	    owner.remove(poll_fd);
+	    poll_fd = -1;
+	    device_lost = true;
+
+	    while((w = event_waiters.pop_front()) != nullptr)
+	    {
+		w->result = lost_event();
+		owner.ready.push_back(w);
+	    }
+	    while((w = button_waiters.pop_front()) != nullptr)
+	    {
+		w->result = lost_event();
+		owner.ready.push_back(w);
+	    }
+	}
+
+};
+
+
+inline bool reactor::add(joystick *js, int fd)
+{
+	struct epoll_event ev = {};
+
+	if((epoll_fd < 0) || (fd < 0))
+	    return(false);
+
+	ev.events = EPOLLIN;
+	ev.data.ptr = js;
+	if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev))
+	    return(false);
+
+	total_joysticks++;
+	return(true);
+}
+
+inline void reactor::remove(int fd)
+{
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+	total_joysticks--;
+}
+
+inline int reactor::run_once(int timeout_ms)
+{
+	int i, n, total_resumed = 0;
+	struct epoll_event ev[max_events];
+	joystick *js;
+	detail::waiter *w;
+
+	n = epoll_wait(epoll_fd, ev, max_events, timeout_ms);
+	if(n < 0)
+	    return((errno == EINTR) ? 0 : -1);
+
+	for(i = 0; i < n; i++)
+	{
+	    js = static_cast<joystick *>(ev[i].data.ptr);
+	    JSUpdate(&js->jsd);
+	    js->deliver();
+
+	    /* The device's descriptor stays hung up after the device
+	     * is disconnected, only the poll descriptor of a joystick
+	     * with JSFlagReconnect waits for it to be reconnected
+	     */
+	    if((ev[i].events & (EPOLLHUP | EPOLLERR)) &&
+	       !(js->jsd.flags & JSFlagReconnect)
+	    )
+		js->lose();
+	}
+
+	/* Resume after all the joysticks have been updated, a resumed
+	 * coroutine may await again or destroy its joystick
+	 */
+	while((w = ready.pop_front()) != nullptr)
+	{
+	    w->handle.resume();
+	    total_resumed++;
+	}
+
+	return(total_resumed);
+}
+
+}	/* namespace jsw */
+
+
+#endif	/* JSW_HPP */
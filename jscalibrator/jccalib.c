@@ -147,8 +147,9 @@ void JCDoCalibrate(jc_struct *jc)
  */
 void JCDoSetAxisTolorance(jc_struct *jc, gint axis_num)
 {
-	gint i, status;
-	gint total_loops = 15;	/* 1.5 seconds */
+	gint status;
+	gulong elapsed_ms, total_ms = 1500;
+	GTimer *timer;
 	js_data_struct *jsd;
 	js_axis_struct *axis_ptr;
 	gint x, e1, e2;
@@ -177,12 +178,19 @@ void JCDoSetAxisTolorance(jc_struct *jc, gint axis_num)
 
 
 	/* Begin calculating error for tolorance */
-	for(i = 0, x = axis_ptr->cur, e1 = 0;
-	    i < total_loops;
-	    i++
+	timer = g_timer_new();
+	for(x = axis_ptr->cur, e1 = 0,
+	    elapsed_ms = (gulong)(g_timer_elapsed(timer, NULL) * 1000.0);
+	    elapsed_ms < total_ms;
+	    elapsed_ms = (gulong)(g_timer_elapsed(timer, NULL) * 1000.0)
 	)
 	{
-	    usleep(100000);
+	    /* Wait for new axis value positions */
+	    status = JSWaitEvent(jsd, (int)(total_ms - elapsed_ms));
+	    if(status == JSEventError)
+		break;
+	    if(status == JSNoEvent)
+		continue;
 
 	    /* Get new axis value positions */
 	    status = JSUpdate(jsd);
@@ -202,6 +210,8 @@ void JCDoSetAxisTolorance(jc_struct *jc, gint axis_num)
 	    x = axis_ptr->cur;
 	}
 
+	g_timer_destroy(timer);
+
 	/* Set new tolorance based on the calculated error */
 	axis_ptr->tolorance = e1;
 
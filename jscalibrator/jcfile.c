@@ -1,6 +1,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include "../include/cfgfmt.h"
 #include "../include/string.h"
@@ -21,11 +26,30 @@ static void JCWriteAxisCalibBlock(
 	FILE *fp, js_data_struct *jsd, gint axis_num
 );
 static void JCWriteJSCalibBlock(FILE *fp, js_data_struct *jsd);
+static gchar *JCGetCalibrationTarget(const gchar *path);
+static FILE *JCOpenCalibrationTemp(
+	const gchar *path, gchar **tmp_path_rtn
+);
+static gint JCCloseCalibrationTemp(
+	FILE *fp, gchar *tmp_path, const gchar *path, gboolean commit
+);
+static gboolean JCIsCalibParm(const gchar *s, const gchar *parm);
+static gboolean JCIsIdentitySet(const js_identity_struct *id);
+static gboolean JCIsSameIdentity(
+	const js_identity_struct *a, const js_identity_struct *b
+);
+static long JCReadCalibBlockInfo(
+	FILE *fp, gchar **device_name_rtn, js_identity_struct *id
+);
+static gint JCCopyCalibBytes(FILE *fp, FILE *tmp_fp, long len);
 static gint JCDoWriteCalibration(
 	const gchar *path,
 	js_data_struct **jsd, int total_jsds,
 	js_data_struct *src_jsd         /* Can be NULL */
 );
+static gint JCDoWriteCalibrationBlock(
+	const gchar *path, js_data_struct *src_jsd
+);
 gint JCDoSaveCalibration(jc_struct *jc, const gchar *path);
 gint JCDoCalibrationCleanUp(jc_struct *jc, const gchar *path);
 
@@ -117,6 +141,11 @@ js_data_struct **JCGetJSDList(
 		    jsd_ptr->driver_version = 0;
 		    jsd_ptr->last_calibrated = 0;
 		    jsd_ptr->force_feedback = NULL;
+		    jsd_ptr->priv = NULL;
+		    jsd_ptr->identity.name = NULL;
+		    jsd_ptr->identity.vendor = 0;
+		    jsd_ptr->identity.product = 0;
+		    jsd_ptr->identity.phys = NULL;
 		}
 	    }
 	}
@@ -310,6 +339,33 @@ static void JCWriteJSCalibBlock(FILE *fp, js_data_struct *jsd)
 	    }
 	}
 
+	/* Write the device's identity so that its calibration can be
+	 * found if it is connected as a different device
+	 */
+	if((jsd->identity.vendor != 0) || (jsd->identity.product != 0) ||
+	   !STRISEMPTY(jsd->identity.phys)
+	)
+	{
+	    if(!STRISEMPTY(jsd->identity.name))
+		fprintf(
+		    fp, "    IdentityName = %s\n",
+		    jsd->identity.name
+		);
+	    fprintf(
+		fp, "    IdentityVendor = %.4x\n",
+		jsd->identity.vendor
+	    );
+	    fprintf(
+		fp, "    IdentityProduct = %.4x\n",
+		jsd->identity.product
+	    );
+	    if(!STRISEMPTY(jsd->identity.phys))
+		fprintf(
+		    fp, "    IdentityPhys = %s\n",
+		    jsd->identity.phys
+		);
+	}
+
 	/* Last calibrated time */
 	fprintf(fp, "    LastCalibrated = %ld\n", jsd->last_calibrated);
 
@@ -325,6 +381,381 @@ static void JCWriteJSCalibBlock(FILE *fp, js_data_struct *jsd)
 	fprintf(fp, "EndJoystick\n");
 }
 
+/*
+ *	Returns the path of the file that a save to the calibration file
+ *	specified by path should actually replace.
+ *
+ *	If path is a symbolic link then the link's destination is
+ *	returned so that the link itself is not replaced.
+ *
+ *	The returned string must be deallocated by the calling function.
+ */
+static gchar *JCGetCalibrationTarget(const gchar *path)
+{
+	gchar *target;
+	char *real_path;
+
+	if(path == NULL)
+	    return(NULL);
+
+	real_path = realpath(path, NULL);
+	if(real_path != NULL)
+	{
+	    target = STRDUP(real_path);
+	    free(real_path);
+	}
+	else
+	{
+	    /* Does not exist yet, use path as is */
+	    target = STRDUP(path);
+	}
+
+	return(target);
+}
+
+/*
+ *	Opens a new temporary file in the same directory as the
+ *	calibration file specified by path.
+ *
+ *	The temporary file will have the same permissions as the file
+ *	specified by path or, if it does not exist, the permissions
+ *	that a newly created file would have.
+ *
+ *	The temporary file's path will be returned in tmp_path_rtn,
+ *	it and the returned stream must be passed to
+ *	JCCloseCalibrationTemp().
+ *
+ *	If the temporary file cannot be created in the directory then
+ *	the calibration file cannot be replaced in a single step, so
+ *	it is not written at all.
+ *
+ *	Returns NULL on error with errno set.
+ */
+static FILE *JCOpenCalibrationTemp(
+	const gchar *path, gchar **tmp_path_rtn
+)
+{
+	gint fd;
+	mode_t m;
+	gchar *tmp_path;
+	FILE *fp;
+	struct stat stat_buf;
+
+	*tmp_path_rtn = NULL;
+
+	if(path == NULL)
+	    return(NULL);
+
+	tmp_path = g_strdup_printf("%s.XXXXXX", path);
+	if(tmp_path == NULL)
+	    return(NULL);
+
+	fd = mkstemp(tmp_path);
+	if(fd < 0)
+	{
+	    const gint error_code = errno;
+	    g_free(tmp_path);
+	    errno = error_code;
+	    return(NULL);
+	}
+
+	if(!stat(path, &stat_buf))
+	{
+	    m = stat_buf.st_mode & 07777;
+	}
+	else
+	{
+	    m = umask(0);
+	    (void)umask(m);
+	    m = (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH) & ~m;
+	}
+	(void)fchmod(fd, m);
+
+	fp = fdopen(fd, "wb");
+	if(fp == NULL)
+	{
+	    const gint error_code = errno;
+	    close(fd);
+	    unlink(tmp_path);
+	    g_free(tmp_path);
+	    errno = error_code;
+	    return(NULL);
+	}
+
+	*tmp_path_rtn = tmp_path;
+
+	return(fp);
+}
+
+/*
+ *	Closes the temporary file opened by JCOpenCalibrationTemp().
+ *
+ *	If commit is TRUE then the temporary file is flushed to disk
+ *	and then renamed to path, replacing it in a single step so
+ *	that the calibration file is never left partially written.
+ *	Otherwise the temporary file is removed.
+ *
+ *	The given tmp_path will be deallocated.
+ *
+ *	Returns non-zero on error with errno set.
+ */
+static gint JCCloseCalibrationTemp(
+	FILE *fp, gchar *tmp_path, const gchar *path, gboolean commit
+)
+{
+	gint status = 0, error_code = 0;
+
+	if((fp == NULL) || (tmp_path == NULL))
+	{
+	    if(fp != NULL)
+		fclose(fp);
+	    g_free(tmp_path);
+	    errno = EINVAL;
+	    return(-1);
+	}
+
+/* Marks an error, keeping errno of the first error */
+#define SET_ERROR	{		\
+ if(!status) {				\
+  status = -1;				\
+  error_code = errno;			\
+ }					\
+}
+
+	if(commit)
+	{
+	    if(fflush(fp) || ferror(fp))
+		SET_ERROR
+	    else if(fsync(fileno(fp)))
+		SET_ERROR
+	}
+
+	if(fclose(fp))
+	    SET_ERROR
+
+	if(commit && !status)
+	{
+	    if(rename(tmp_path, path))
+		SET_ERROR
+	}
+
+#undef SET_ERROR
+
+	if(!commit || status)
+	    unlink(tmp_path);
+
+	g_free(tmp_path);
+
+	errno = error_code;
+
+	return(commit ? status : 0);
+}
+
+/*
+ *	Checks if the configuration line s specifies the parameter
+ *	parm, without parsing the rest of the line.
+ */
+static gboolean JCIsCalibParm(const gchar *s, const gchar *parm)
+{
+	const gint len = STRLEN(parm);
+
+	if((s == NULL) || (len <= 0))
+	    return(FALSE);
+
+	while((*s == ' ') || (*s == '\t'))
+	    s++;
+
+	if(g_strncasecmp(s, parm, len))
+	    return(FALSE);
+
+	s += len;
+	switch(*s)
+	{
+	  case ' ':
+	  case '\t':
+	  case '\r':
+	  case '\n':
+	  case '\0':
+	  case CFG_PARAMETER_DELIMITER:
+	    return(TRUE);
+	  default:
+	    return(FALSE);
+	}
+}
+
+/*
+ *	Checks if the identity has enough information to tell apart
+ *	devices of the same kind, as libjsw does.
+ */
+static gboolean JCIsIdentitySet(const js_identity_struct *id)
+{
+	if(id == NULL)
+	    return(FALSE);
+	else if((id->vendor != 0) || (id->product != 0) ||
+		!STRISEMPTY(id->phys)
+	)
+	    return(TRUE);
+	else
+	    return(FALSE);
+}
+
+/*
+ *	Checks if the identities a and b are both set and are of the
+ *	same device.
+ */
+static gboolean JCIsSameIdentity(
+	const js_identity_struct *a, const js_identity_struct *b
+)
+{
+	if(!JCIsIdentitySet(a) || !JCIsIdentitySet(b))
+	    return(FALSE);
+
+	if((a->vendor != b->vendor) || (a->product != b->product))
+	    return(FALSE);
+	if(strcmp(
+	    (a->name != NULL) ? a->name : "",
+	    (b->name != NULL) ? b->name : ""
+	))
+	    return(FALSE);
+	if(strcmp(
+	    (a->phys != NULL) ? a->phys : "",
+	    (b->phys != NULL) ? b->phys : ""
+	))
+	    return(FALSE);
+
+	return(TRUE);
+}
+
+/*
+ *	Reads the joystick calibration block at the current position of
+ *	fp, which must be the start of the block's BeginJoystick line.
+ *
+ *	The block's device name is returned in device_name_rtn and its
+ *	identity in id, both must be deallocated by the calling
+ *	function.
+ *
+ *	As when the calibration is loaded, the block ends after its
+ *	EndJoystick line or else at the next BeginJoystick line or the
+ *	end of the file. The position of fp is left at the end of the
+ *	block.
+ *
+ *	Returns the position of the end of the block or -1 on error.
+ */
+static long JCReadCalibBlockInfo(
+	FILE *fp, gchar **device_name_rtn, js_identity_struct *id
+)
+{
+	gboolean at_line_start = TRUE, is_first_line = TRUE;
+	long pos;
+	const gchar *val;
+	gchar buf[CFG_STRING_MAX];
+
+	*device_name_rtn = NULL;
+	memset(id, 0x00, sizeof(js_identity_struct));
+
+	while(1)
+	{
+	    gboolean is_line_start = at_line_start;
+	    gint len;
+
+	    pos = ftell(fp);
+	    if(fgets(buf, sizeof(buf), fp) == NULL)
+		break;
+
+	    len = STRLEN(buf);
+	    at_line_start = ((len > 0) && (buf[len - 1] == '\n')) ?
+		TRUE : FALSE;
+	    if(!is_line_start)
+		continue;
+
+	    if(JCIsCalibParm(buf, "BeginJoystick"))
+	    {
+		/* Start of the next block? */
+		if(!is_first_line)
+		{
+		    if(fseek(fp, pos, SEEK_SET))
+			return(-1);
+		    return(pos);
+		}
+
+		val = StringCfgParseValue(buf);
+		*device_name_rtn = STRDUP((val != NULL) ? val : "");
+	    }
+	    else if(JCIsCalibParm(buf, "EndJoystick"))
+	    {
+		/* Skip the rest of a long line */
+		while(!at_line_start && (fgets(buf, sizeof(buf), fp) != NULL))
+		{
+		    len = STRLEN(buf);
+		    at_line_start = ((len > 0) && (buf[len - 1] == '\n')) ?
+			TRUE : FALSE;
+		}
+		break;
+	    }
+	    else if(JCIsCalibParm(buf, "IdentityName"))
+	    {
+		val = StringCfgParseValue(buf);
+		g_free(id->name);
+		id->name = STRDUP(val);
+	    }
+	    else if(JCIsCalibParm(buf, "IdentityVendor"))
+	    {
+		val = StringCfgParseValue(buf);
+		if(val != NULL)
+		    id->vendor = (unsigned int)strtoul(val, NULL, 16);
+	    }
+	    else if(JCIsCalibParm(buf, "IdentityProduct"))
+	    {
+		val = StringCfgParseValue(buf);
+		if(val != NULL)
+		    id->product = (unsigned int)strtoul(val, NULL, 16);
+	    }
+	    else if(JCIsCalibParm(buf, "IdentityPhys"))
+	    {
+		val = StringCfgParseValue(buf);
+		g_free(id->phys);
+		id->phys = STRDUP(val);
+	    }
+
+	    is_first_line = FALSE;
+	}
+
+	if(ferror(fp))
+	    return(-1);
+
+	return(ftell(fp));
+}
+
+/*
+ *	Copies len bytes from fp to tmp_fp.
+ *
+ *	Returns the last byte copied, -1 if no bytes were copied or -2
+ *	on error.
+ */
+static gint JCCopyCalibBytes(FILE *fp, FILE *tmp_fp, long len)
+{
+	gint last = -1;
+	size_t n;
+	gchar buf[CFG_STRING_MAX];
+
+	while(len > 0)
+	{
+	    n = fread(
+		buf, 1,
+		(len < (long)sizeof(buf)) ? (size_t)len : sizeof(buf),
+		fp
+	    );
+	    if(n == 0)
+		return(-2);
+	    if(fwrite(buf, 1, n, tmp_fp) != n)
+		return(-2);
+	    last = (guchar)buf[n - 1];
+	    len -= (long)n;
+	}
+
+	return(last);
+}
+
 /*
  *	Writes the calibration file specified by path with respect to the
  *	given list of jsd structures.
@@ -341,9 +772,10 @@ static gint JCDoWriteCalibration(
 	js_data_struct *src_jsd		/* Can be NULL */
 )
 {
-	gint i;
+	gint i, status;
 	gboolean wrote_src_js = FALSE;
 	FILE *fp;
+	gchar *target, *tmp_path;
 	js_data_struct *jsd_ptr;
 	const gchar *device_name, *src_device_name;
 
@@ -357,9 +789,18 @@ static gint JCDoWriteCalibration(
 	    src_jsd->device_name : NULL;
 
 
-	/* Open calibration file for writing */
-	fp = FOpen(path, "w");
-	if(fp != NULL)
+	/* Open a temporary file next to the calibration file for
+	 * writing, it will replace the calibration file once it has
+	 * been completely written
+	 */
+	target = JCGetCalibrationTarget(path);
+	fp = JCOpenCalibrationTemp(target, &tmp_path);
+	if(fp == NULL)
+	{
+	    g_free(target);
+	    return(-1);
+	}
+	else
 	{
 	    /* Write header */
 	    fprintf(
@@ -433,14 +874,221 @@ static gint JCDoWriteCalibration(
 		wrote_src_js = TRUE;
 	    }
 
-	    /* Close calibration file */
-	    FClose(fp);
+	    /* Close the temporary file and move it into place */
+	    status = JCCloseCalibrationTemp(fp, tmp_path, target, TRUE);
 	    fp = NULL;
+	    tmp_path = NULL;
 	}
 
-	return(0);
+	g_free(target);
+
+	return(status);
 }
 
+/*
+ *	Writes the calibration block for the joystick specified by
+ *	src_jsd to the calibration file specified by path.
+ *
+ *	Only the joystick calibration block for src_jsd's device is
+ *	replaced (or appended if it is not in the calibration file),
+ *	all other lines are copied as is without being parsed.
+ *
+ *	A block is src_jsd's if it has src_jsd's identity, even if it
+ *	was saved for a different device name when the device was
+ *	connected as another device, or if it has src_jsd's device
+ *	name and its identity is not of a different device. The first
+ *	such block is replaced and any others are dropped.
+ *
+ *	The calibration file is written to a temporary file which
+ *	replaces the calibration file once it has been completely
+ *	written.
+ *
+ *	Returns non-zero on error with errno set.
+ */
+static gint JCDoWriteCalibrationBlock(
+	const gchar *path, js_data_struct *src_jsd
+)
+{
+	gboolean	at_line_start = TRUE,
+			wrote_src_js = FALSE;
+	gint error_code = 0;
+	long pos, end;
+	gchar *target, *tmp_path, *block_device;
+	const gchar *src_device_name;
+	const js_identity_struct *src_id;
+	js_identity_struct block_id;
+	FILE *fp, *tmp_fp;
+	gchar buf[CFG_STRING_MAX];
+
+	if((path == NULL) || (src_jsd == NULL))
+	{
+	    errno = EINVAL;
+	    return(-1);
+	}
+
+	src_device_name = src_jsd->device_name;
+	if(src_device_name == NULL)
+	{
+	    errno = EINVAL;
+	    return(-1);
+	}
+	src_id = &src_jsd->identity;
+
+	target = JCGetCalibrationTarget(path);
+
+	/* Open the temporary file that will replace the calibration
+	 * file
+	 */
+	tmp_fp = JCOpenCalibrationTemp(target, &tmp_path);
+	if(tmp_fp == NULL)
+	{
+	    error_code = errno;
+	    g_free(target);
+	    errno = error_code;
+	    return(-1);
+	}
+
+	/* Open the existing calibration file, it may not exist */
+	fp = FOpen(target, "rb");
+	if(fp != NULL)
+	{
+	    /* Copy each line to the temporary file, replacing the
+	     * joystick calibration blocks for the source joystick
+	     *
+	     * Lines longer than buf are read in pieces and only
+	     * the first piece of each line is checked for a
+	     * parameter
+	     */
+	    while(1)
+	    {
+		gboolean is_line_start = at_line_start;
+		gint len;
+
+		pos = ftell(fp);
+		if(fgets(buf, sizeof(buf), fp) == NULL)
+		    break;
+
+		len = STRLEN(buf);
+		at_line_start = ((len > 0) && (buf[len - 1] == '\n')) ?
+		    TRUE : FALSE;
+
+		/* Not the start of a joystick block? */
+		if(!is_line_start || !JCIsCalibParm(buf, "BeginJoystick"))
+		{
+		    fputs(buf, tmp_fp);
+		    continue;
+		}
+
+		/* Get the block's device name and identity */
+		if(fseek(fp, pos, SEEK_SET))
+		{
+		    error_code = errno;
+		    break;
+		}
+		end = JCReadCalibBlockInfo(fp, &block_device, &block_id);
+		if(end < 0)
+		{
+		    error_code = EIO;
+		    g_free(block_device);
+		    g_free(block_id.name);
+		    g_free(block_id.phys);
+		    break;
+		}
+
+		if(JCIsSameIdentity(&block_id, src_id) ||
+		   ((block_device != NULL) &&
+		    !strcmp(block_device, src_device_name) &&
+		    (!JCIsIdentitySet(&block_id) ||
+		     !JCIsIdentitySet(src_id))
+		   )
+		)
+		{
+		    /* Write the source joystick's block in place of
+		     * the first old one, any further blocks for the
+		     * source joystick are dropped
+		     */
+		    if(!wrote_src_js)
+		    {
+			JCWriteJSCalibBlock(tmp_fp, src_jsd);
+			wrote_src_js = TRUE;
+		    }
+		    at_line_start = TRUE;
+		}
+		else
+		{
+		    /* Copy the other joystick's block as is */
+		    gint last;
+		    if(fseek(fp, pos, SEEK_SET))
+			last = -2;
+		    else
+			last = JCCopyCalibBytes(fp, tmp_fp, end - pos);
+		    if(last == -2)
+		    {
+			error_code = EIO;
+		    }
+		    else
+		    {
+			at_line_start = (last == '\n') ? TRUE : FALSE;
+		    }
+		}
+
+		g_free(block_device);
+		g_free(block_id.name);
+		g_free(block_id.phys);
+
+		if(error_code != 0)
+		    break;
+	    }
+
+	    /* Error reading the existing calibration file? */
+	    if(ferror(fp) && (error_code == 0))
+		error_code = EIO;
+	    if(error_code != 0)
+	    {
+		FClose(fp);
+		JCCloseCalibrationTemp(tmp_fp, tmp_path, target, FALSE);
+		g_free(target);
+		errno = error_code;
+		return(-1);
+	    }
+
+	    FClose(fp);
+
+	    /* Make sure the appended block starts on a new line */
+	    if(!wrote_src_js && !at_line_start)
+		fputc('\n', tmp_fp);
+	}
+	else
+	{
+	    /* New calibration file, write header */
+	    fprintf(
+		tmp_fp,
+"# Joystick calibration file.\n\
+# Generated by %s version %s.\n\
+#\n",
+		PROG_NAME_FULL, PROG_VERSION
+	    );
+	}
+
+	/* The source joystick was not in the calibration file, so
+	 * append its block
+	 */
+	if(!wrote_src_js)
+	    JCWriteJSCalibBlock(tmp_fp, src_jsd);
+
+	/* Close the temporary file and move it into place */
+	if(JCCloseCalibrationTemp(tmp_fp, tmp_path, target, TRUE))
+	{
+	    error_code = errno;
+	    g_free(target);
+	    errno = error_code;
+	    return(-1);
+	}
+
+	g_free(target);
+
+	return(0);
+}
 
 /*
  *	Saves calibration values in the jsd structure on the specified
@@ -458,9 +1106,9 @@ static gint JCDoWriteCalibration(
  */
 gint JCDoSaveCalibration(jc_struct *jc, const gchar *path)
 {
-	gint i, status, total_jsds;
+	gint status, error_code;
 	gchar *calib_file, *dev_name;
-	js_data_struct *src_jsd, *jsd_ptr, **jsd;
+	js_data_struct *src_jsd;
 
 	if(jc == NULL)
 	    return(-1);
@@ -508,31 +1156,12 @@ gint JCDoSaveCalibration(jc_struct *jc, const gchar *path)
 	    dev_name = STRDUP("/dev/js0");
 #endif
 
-	/* Get jsd list from the calibration file */
-	jsd = JCGetJSDList(calib_file, &total_jsds);
-
-	/* Write calibration specified by the jsd list to the
-	 * calibration file
+	/* Write the source joystick's calibration block to the
+	 * calibration file, the blocks for all the other joysticks
+	 * in the calibration file are left as they are
 	 */
-	status = JCDoWriteCalibration(
-	    calib_file,
-	    jsd, total_jsds,
-	    src_jsd
-	);
-
-	/* Delete the jsd list */
-	for(i = 0; i < total_jsds; i++)
-	{
-	    jsd_ptr = jsd[i];
-	    if(jsd_ptr == NULL)
-		continue;
-
-	    JSClose(jsd_ptr);
-	    g_free(jsd_ptr);
-	}
-	g_free(jsd);
-	jsd = NULL;
-	total_jsds = 0;
+	status = JCDoWriteCalibrationBlock(calib_file, src_jsd);
+	error_code = (errno != 0) ? errno : EIO;
 
 	/* Check if we successfully saved the joystick calibration to
 	 * the calibration file
@@ -561,8 +1190,10 @@ gint JCDoSaveCalibration(jc_struct *jc, const gchar *path)
 \n\
 To calibration file:\n\
 \n\
-    %s\n",
-		dev_name, calib_file
+    %s\n\
+\n\
+%s.\n",
+		dev_name, calib_file, g_strerror(error_code)
 	    );
 
 	    StatusBarSetMesg(&jc->status_bar, NULL);
@@ -585,7 +1216,7 @@ the calibration file is valid.",
 	g_free(calib_file);
 	g_free(dev_name);
 
-	return(0);
+	return(status);
 }
 
 
@@ -39,9 +39,11 @@ int main(int argc, char *argv[])
 	    calib = argv[1];
 	}
 
-	/* Get list of joystick device attributes. */
-	js_attrib = JSGetAttributesList(
-	    &total_js_attribs, calib
+	/* Get list of joystick device attributes, each device is
+	 * opened to check if it is in use.
+	 */
+	js_attrib = JSGetAttributesListFlags(
+	    &total_js_attribs, calib, JSAttributesFlagCheckInUse
 	);
 	/* Got list? */
 	if(js_attrib != NULL)
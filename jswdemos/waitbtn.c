@@ -8,7 +8,6 @@
  */
 #include <stdio.h>
 #include <jsw.h>   
-#include <unistd.h>
 
 int main(int argc, char *argv[])
 {
@@ -56,6 +55,10 @@ int main(int argc, char *argv[])
 
 	while(1)
 	{
+	    /* Wait for joystick event */
+	    if(JSWaitEvent(&jsd, -1) == JSEventError)
+		break;
+
 	    /* Get joystick event */
 	    if(JSUpdate(&jsd) == JSGotEvent)
 	    {
@@ -77,8 +80,6 @@ int main(int argc, char *argv[])
 		if(pressed_button > 0)
 		    break;
 	    }
-
-	    usleep(8000);
 	}
 
 	/* Close the joystick device */
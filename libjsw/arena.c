@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "arena.h"
+
+
+/*
+ *	Arena Block:
+ *
+ *	An arena is a list of blocks that small allocations are taken
+ *	from, the allocations are never deallocated individually but
+ *	all at once when the arena is deleted. The arena itself is
+ *	just the pointer to its newest block, NULL for an empty arena.
+ */
+typedef struct _js_arena_block_struct js_arena_block_struct;
+struct _js_arena_block_struct {
+
+	js_arena_block_struct	*next;	/* Older block */
+	size_t		size,		/* Bytes of data in this block */
+			used;		/* Bytes of data taken */
+
+	/* Data follows, aligned to JS_ARENA_ALIGN */
+
+};
+
+
+void *JSArenaAlloc(void **arena, size_t size);
+char *JSArenaStrDup(void **arena, const char *s);
+int JSArenaOwns(void *arena, const void *p);
+void JSArenaFree(void *arena, void *p);
+void JSArenaDelete(void *arena);
+
+
+/*
+ *	Alignment of each allocation:
+ */
+#define JS_ARENA_ALIGN			16
+
+/*
+ *	Size of data in each new block, allocations larger than this
+ *	get a block of their own:
+ */
+#define JS_ARENA_BLOCK_SIZE		1024
+
+#define JS_ARENA_ROUND(n)		\
+	(((n) + (JS_ARENA_ALIGN - 1)) & ~((size_t)JS_ARENA_ALIGN - 1))
+
+#define JS_ARENA_BLOCK_DATA(b)		\
+	((char *)(b) + JS_ARENA_ROUND(sizeof(js_arena_block_struct)))
+
+
+/*
+ *	Allocates size bytes from the arena, the returned memory is
+ *	cleared to zero.
+ *
+ *	A new block will be added to the arena as needed.
+ *
+ *	Returns NULL on error.
+ */
+void *JSArenaAlloc(void **arena, size_t size)
+{
+	void *p;
+	js_arena_block_struct *b;
+
+	if(arena == NULL)
+	    return(NULL);
+
+	size = JS_ARENA_ROUND((size > 0) ? size : 1);
+
+	/* Not enough room in the newest block? */
+	b = (js_arena_block_struct *)*arena;
+	if((b == NULL) || ((b->size - b->used) < size))
+	{
+	    const size_t block_size = (size > JS_ARENA_BLOCK_SIZE) ?
+		size : JS_ARENA_BLOCK_SIZE;
+	    js_arena_block_struct *nb = (js_arena_block_struct *)malloc(
+		JS_ARENA_ROUND(sizeof(js_arena_block_struct)) + block_size
+	    );
+	    if(nb == NULL)
+		return(NULL);
+
+	    nb->size = block_size;
+	    nb->used = 0;
+
+	    /* Allocations that get a block of their own are put
+	     * behind the newest block, so that the room left in the
+	     * newest block can still be used
+	     */
+	    if((b != NULL) && (size > JS_ARENA_BLOCK_SIZE))
+	    {
+		nb->next = b->next;
+		b->next = nb;
+	    }
+	    else
+	    {
+		nb->next = b;
+		*arena = nb;
+	    }
+	    b = nb;
+	}
+
+	p = JS_ARENA_BLOCK_DATA(b) + b->used;
+	b->used += size;
+	memset(p, 0x00, size);
+
+	return(p);
+}
+
+/*
+ *	Coppies the string s to memory allocated from the arena.
+ *
+ *	Returns NULL if s is NULL or on error.
+ */
+char *JSArenaStrDup(void **arena, const char *s)
+{
+	size_t len;
+	char *p;
+
+	if(s == NULL)
+	    return(NULL);
+
+	len = strlen(s) + 1;
+	p = (char *)JSArenaAlloc(arena, len);
+	if(p != NULL)
+	    memcpy(p, s, len);
+
+	return(p);
+}
+
+/*
+ *	Checks if p was allocated from the arena.
+ */
+int JSArenaOwns(void *arena, const void *p)
+{
+	const char *c = (const char *)p;
+	js_arena_block_struct *b;
+
+	if(p == NULL)
+	    return(0);
+
+	for(b = (js_arena_block_struct *)arena; b != NULL; b = b->next)
+	{
+	    if((c >= JS_ARENA_BLOCK_DATA(b)) &&
+	       (c < (JS_ARENA_BLOCK_DATA(b) + b->size))
+	    )
+		return(1);
+	}
+
+	return(0);
+}
+
+/*
+ *	Deallocates p if it was not allocated from the arena.
+ *
+ *	This is used for values that may have been set by the calling
+ *	application instead of by libjsw.
+ */
+void JSArenaFree(void *arena, void *p)
+{
+	if(p == NULL)
+	    return;
+
+	if(!JSArenaOwns(arena, p))
+	    free(p);
+}
+
+/*
+ *	Deletes the arena and all the memory allocated from it.
+ */
+void JSArenaDelete(void *arena)
+{
+	js_arena_block_struct *next, *b = (js_arena_block_struct *)arena;
+
+	while(b != NULL)
+	{
+	    next = b->next;
+	    free(b);
+	    b = next;
+	}
+}
@@ -0,0 +1,14 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <sys/types.h>
+
+
+extern void *JSArenaAlloc(void **arena, size_t size);
+extern char *JSArenaStrDup(void **arena, const char *s);
+extern int JSArenaOwns(void *arena, const void *p);
+extern void JSArenaFree(void *arena, void *p);
+extern void JSArenaDelete(void *arena);
+
+
+#endif	/* ARENA_H */
@@ -7,14 +7,124 @@
 #include <sys/ioctl.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#if defined(__linux__)
+# include <sys/sysmacros.h>
+#endif
 
 #include "../include/string.h"
 #include "../include/jsw.h"
 
+#include "arena.h"
+#include "identity.h"
+#include "hotplug.h"
+
+
+/*
+ *	Joystick Attributes List Header:
+ *
+ *	Stored just before the first Joystick Attribute in the list
+ *	returned by JSGetAttributesList(), the list's strings are
+ *	allocated from its arena.
+ */
+typedef struct {
+
+	void		*arena;
+	int		total_allocated;	/* Joystick Attributes
+						 * allocated in the list */
+	int		reserved;
+
+} js_attribute_list_header_struct;
+#define JS_ATTRIBUTE_LIST_HEADER(p)	\
+	(((js_attribute_list_header_struct *)(p)) - 1)
+
+/*
+ *	Cached Joystick Attributes List:
+ *
+ *	Rebuilt by JSGetAttributesListCached() and
+ *	JSGetAttributesGeneration() only when a joystick device node or
+ *	the calibration file has changed.
+ */
+typedef struct {
+
+	pthread_mutex_t	mutex;
+
+	int		valid;		/* Built and not invalidated */
+	void		*watch;		/* Device node watch, can be NULL
+					 * if not available */
+
+	/* Calibration file that the list was built with and its
+	 * statistics at that time */
+	char		*calibration;
+	int		calibration_exists;
+	dev_t		calibration_dev;
+	ino_t		calibration_ino;
+	off_t		calibration_size;
+	time_t		calibration_mtime;
+	long		calibration_mtime_nsec;
+
+	js_attribute_struct	*list;
+	int		total;
 
+	/* Incremented each time the list changes */
+	unsigned long	generation;
+
+} js_attribute_cache_struct;
+
+
+static js_attribute_struct *JSAttributesListAppend(
+	js_attribute_list_header_struct **header, int *total
+);
+static void JSAttributesSetIdentity(
+	js_attribute_list_header_struct *header,
+	js_attribute_struct *attrib, const js_identity_struct *id
+);
+static void JSAttributesCheckDevice(
+	js_attribute_struct *attrib, unsigned int flags
+);
+static void JSAttributesAppendDevice(
+	js_attribute_list_header_struct **header, int *total,
+	const char *dev_path, const js_identity_struct *id,
+	unsigned int flags
+);
+#if defined(__linux__)
+static int JSAttributesCompareNumbers(const void *a, const void *b);
+static int JSAttributesListSysFS(
+	js_attribute_list_header_struct **header, int *total,
+	unsigned int flags
+);
+#endif
+static void JSAttributesListProbe(
+	js_attribute_list_header_struct **header, int *total,
+	unsigned int flags
+);
+static js_attribute_struct *JSAttributesListCopy(
+	const js_attribute_struct *list, int total
+);
+static int JSAttributesListEqual(
+	const js_attribute_struct *a, int total_a,
+	const js_attribute_struct *b, int total_b
+);
+static int JSAttributesCacheIsValid(
+	js_attribute_cache_struct *cache, const char *calibration
+);
+static void JSAttributesCacheUpdate(
+	js_attribute_cache_struct *cache, const char *calibration
+);
 js_attribute_struct *JSGetAttributesList(
 	int *total, const char *calibration
 );
+js_attribute_struct *JSGetAttributesListFlags(
+	int *total, const char *calibration,
+	unsigned int flags
+);
+js_attribute_struct *JSGetAttributesListCached(
+	int *total, const char *calibration,
+	unsigned long *generation
+);
+unsigned long JSGetAttributesGeneration(const char *calibration);
 void JSFreeAttributesList(js_attribute_struct *list, int total);
 
 
@@ -28,6 +138,369 @@ void JSFreeAttributesList(js_attribute_struct *list, int total);
 #define CLIP(a,l,h)     (MIN(MAX((a),(l)),(h)))
 #define STRLEN(s)       (((s) != NULL) ? strlen(s) : 0)
 #define STRISEMPTY(s)   (((s) != NULL) ? (*(s) == '\0') : 1)
+#define STRCMPNULL(a,b)	strcmp(((a) != NULL) ? (a) : "", ((b) != NULL) ? (b) : "")
+
+#if defined(__linux__)
+# define JS_STAT_MTIME_NSEC(s)	((long)(s)->st_mtim.tv_nsec)
+#else
+# define JS_STAT_MTIME_NSEC(s)	0l
+#endif
+
+
+/*
+ *	Highest joystick device number probed when sysfs is not
+ *	available, missing device numbers below it are skipped.
+ */
+#define JS_ATTRIBUTES_PROBE_MAX		32
+
+/*
+ *	Sysfs input class directory:
+ */
+#ifndef JS_ATTRIBUTES_SYSFS_INPUT
+# define JS_ATTRIBUTES_SYSFS_INPUT	"/sys/class/input"
+#endif
+
+
+static js_attribute_cache_struct js_attribute_cache = {
+	PTHREAD_MUTEX_INITIALIZER,
+	0, NULL,
+	NULL, 0, 0, 0, 0, 0, 0,
+	NULL, 0,
+	0
+};
+
+
+/*
+ *	Appends a new Joystick Attribute to the list, the list is grown
+ *	by doubling the number of allocated Joystick Attributes.
+ *
+ *	Returns the new Joystick Attribute or NULL on error.
+ */
+static js_attribute_struct *JSAttributesListAppend(
+	js_attribute_list_header_struct **header, int *total
+)
+{
+	const int n = MAX(*total, 0);
+	js_attribute_struct *attrib;
+
+	if((*header == NULL) || (n >= (*header)->total_allocated))
+	{
+	    const int m = (*header != NULL) ?
+		((*header)->total_allocated * 2) : 8;
+	    js_attribute_list_header_struct *h =
+		(js_attribute_list_header_struct *)realloc(
+		    *header,
+		    sizeof(js_attribute_list_header_struct) +
+		    (m * sizeof(js_attribute_struct))
+		);
+	    if(h == NULL)
+		return(NULL);
+
+	    if(*header == NULL)
+		h->arena = NULL;
+	    h->total_allocated = m;
+	    *header = h;
+	}
+
+	attrib = &((js_attribute_struct *)(*header + 1))[n];
+	memset(attrib, 0x00, sizeof(js_attribute_struct));
+	*total = n + 1;
+
+	return(attrib);
+}
+
+/*
+ *	Coppies the identity id to the Joystick Attribute, the values
+ *	are allocated from the list's arena.
+ */
+static void JSAttributesSetIdentity(
+	js_attribute_list_header_struct *header,
+	js_attribute_struct *attrib, const js_identity_struct *id
+)
+{
+	if(id == NULL)
+	    return;
+
+	attrib->identity.name = JSArenaStrDup(&header->arena, id->name);
+	attrib->identity.vendor = id->vendor;
+	attrib->identity.product = id->product;
+	attrib->identity.phys = JSArenaStrDup(&header->arena, id->phys);
+}
+
+/*
+ *	Sets the Joystick Attribute's not_accessable and is_in_use
+ *	values.
+ *
+ *	The device is only opened if JSAttributesFlagCheckInUse is
+ *	specified in flags.
+ */
+static void JSAttributesCheckDevice(
+	js_attribute_struct *attrib, unsigned int flags
+)
+{
+	int fd;
+	const char *dev_path = attrib->device_name;
+
+	/* Device node does not exist? */
+	if(STRISEMPTY(dev_path) || access(dev_path, F_OK))
+	{
+	    attrib->not_accessable = 1;
+	    return;
+	}
+
+	if(!(flags & JSAttributesFlagCheckInUse))
+	    return;
+
+	/* Try to open the device */
+	fd = open(dev_path, O_RDONLY);
+
+	/* Unable to open device? */
+	if(fd < 0)
+	{
+	    /* Could not open it, handle errno */
+	    switch(errno)
+	    {
+	      case ENODEV:
+	      case ENFILE:
+		attrib->not_accessable = 1;
+		break;
+
+	      default:
+		/* All else assume is in use */
+		attrib->is_in_use = 1;
+		break;
+	    }
+	}
+	else
+	{
+	    /* Opened it just fine, now close it */
+	    close(fd);
+	}
+}
+
+/*
+ *	Appends a Joystick Attribute for the device node dev_path with
+ *	the identity id to the list.
+ */
+static void JSAttributesAppendDevice(
+	js_attribute_list_header_struct **header, int *total,
+	const char *dev_path, const js_identity_struct *id,
+	unsigned int flags
+)
+{
+	js_attribute_struct *attrib = JSAttributesListAppend(header, total);
+	if(attrib == NULL)
+	    return;
+
+	/* Record device path as the Joystick Attribute's device
+	 * name
+	 */
+	attrib->device_name = JSArenaStrDup(&(*header)->arena, dev_path);
+	JSAttributesSetIdentity(*header, attrib, id);
+	JSAttributesCheckDevice(attrib, flags);
+}
+
+#if defined(__linux__)
+/*
+ *	Compares two joystick device numbers for qsort().
+ */
+static int JSAttributesCompareNumbers(const void *a, const void *b)
+{
+	return(*(const int *)a - *(const int *)b);
+}
+
+/*
+ *	Appends a Joystick Attribute for each joystick device listed in
+ *	"/sys/class/input" to the list.
+ *
+ *	Each joystick device's name, vendor, product and device node
+ *	are read from sysfs in a single pass over the directory, the
+ *	devices themselves are not opened unless
+ *	JSAttributesFlagCheckInUse is specified in flags.
+ *
+ *	Returns 0 on success or -1 if sysfs is not available.
+ */
+static int JSAttributesListSysFS(
+	js_attribute_list_header_struct **header, int *total,
+	unsigned int flags
+)
+{
+	int i, total_nums = 0, total_nums_allocated = 0, *nums = NULL;
+	unsigned int major_num, minor_num;
+	char *s, *dev_name, path[PATH_MAX], dev_path[PATH_MAX + NAME_MAX],
+		legacy_path[80];
+	const char *name;
+	struct dirent *dent;
+	struct stat stat_buf;
+	js_identity_struct id;
+	DIR *dir = opendir(JS_ATTRIBUTES_SYSFS_INPUT);
+	if(dir == NULL)
+	    return(-1);
+
+	/* Get the numbers of all the joystick devices, the directory
+	 * also lists event, mouse and input devices which are skipped
+	 */
+	while((dent = readdir(dir)) != NULL)
+	{
+	    name = dent->d_name;
+	    if(strncmp(name, "js", 2) || (name[2] < '0') || (name[2] > '9'))
+		continue;
+
+	    if(total_nums >= total_nums_allocated)
+	    {
+		int *v;
+		total_nums_allocated = MAX(total_nums_allocated * 2, 8);
+		v = (int *)realloc(
+		    nums, total_nums_allocated * sizeof(int)
+		);
+		if(v == NULL)
+		    break;
+		nums = v;
+	    }
+	    nums[total_nums] = ATOI(name + 2);
+	    total_nums++;
+	}
+	closedir(dir);
+
+	/* List the joystick devices in order of their numbers */
+	if(total_nums > 1)
+	    qsort(nums, total_nums, sizeof(int), JSAttributesCompareNumbers);
+
+	for(i = 0; i < total_nums; i++)
+	{
+	    memset(&id, 0x00, sizeof(js_identity_struct));
+	    sprintf(
+		path, JS_ATTRIBUTES_SYSFS_INPUT "/js%i/device", nums[i]
+	    );
+	    JSIdentityLoadSysFS(&id, path);
+
+	    /* Get the device numbers */
+	    major_num = minor_num = 0;
+	    sprintf(
+		path, JS_ATTRIBUTES_SYSFS_INPUT "/js%i/dev", nums[i]
+	    );
+	    s = JSIdentityReadSysFS(path);
+	    if((s == NULL) ||
+	       (sscanf(s, "%u:%u", &major_num, &minor_num) != 2)
+	    )
+		major_num = minor_num = 0;
+	    free(s);
+
+	    /* Get the device node's name relative to "/dev" from the
+	     * uevent, the joydev driver names it "input/js#"
+	     */
+	    dev_name = NULL;
+	    sprintf(
+		path, JS_ATTRIBUTES_SYSFS_INPUT "/js%i/uevent", nums[i]
+	    );
+	    if(1)
+	    {
+		char buf[256];
+		FILE *fp = fopen(path, "rb");
+		while((fp != NULL) && (fgets(buf, sizeof(buf), fp) != NULL))
+		{
+		    if(strncmp(buf, "DEVNAME=", 8))
+			continue;
+
+		    s = strpbrk(buf, "\r\n");
+		    if(s != NULL)
+			*s = '\0';
+		    dev_name = STRDUP(buf + 8);
+		    break;
+		}
+		if(fp != NULL)
+		    fclose(fp);
+	    }
+
+	    /* The legacy "/dev/js#" device node is listed as well if
+	     * it refers to the same device
+	     */
+	    sprintf(legacy_path, "/dev/js%i", nums[i]);
+	    if(!stat(legacy_path, &stat_buf) && S_ISCHR(stat_buf.st_mode) &&
+	       (major(stat_buf.st_rdev) == major_num) &&
+	       (minor(stat_buf.st_rdev) == minor_num)
+	    )
+		JSAttributesAppendDevice(
+		    header, total, legacy_path, &id, flags
+		);
+	    else
+		*legacy_path = '\0';
+
+	    if(dev_name != NULL)
+		snprintf(dev_path, sizeof(dev_path), "/dev/%s", dev_name);
+	    else
+		sprintf(dev_path, "/dev/input/js%i", nums[i]);
+	    if(strcmp(dev_path, legacy_path))
+		JSAttributesAppendDevice(
+		    header, total, dev_path, &id, flags
+		);
+
+	    free(dev_name);
+	    JSIdentityClear(&id);
+	}
+
+	free(nums);
+
+	return(0);
+}
+#endif	/* __linux__ */
+
+/*
+ *	Appends a Joystick Attribute for each joystick device node
+ *	found in "/dev", used when sysfs is not available.
+ *
+ *	Device numbers up to JS_ATTRIBUTES_PROBE_MAX are probed and
+ *	missing device numbers are skipped.
+ */
+static void JSAttributesListProbe(
+	js_attribute_list_header_struct **header, int *total,
+	unsigned int flags
+)
+{
+	int i;
+	char dev_path[PATH_MAX + NAME_MAX];
+	js_identity_struct id;
+
+	memset(&id, 0x00, sizeof(js_identity_struct));
+
+	/* Look in the "/dev/js#" paths where # is a number */
+	for(i = 0; i < JS_ATTRIBUTES_PROBE_MAX; i++)
+	{
+	    /* Format joystick device path */
+#if defined(__FreeBSD__)
+	    sprintf(dev_path, "/dev/joy%i", i);
+#else
+	    sprintf(dev_path, "/dev/js%i", i);
+#endif
+
+	    /* Joystick device does not exist? */
+	    if(access(dev_path, F_OK))
+		continue;
+
+	    JSIdentityLoad(&id, dev_path, NULL);
+	    JSAttributesAppendDevice(header, total, dev_path, &id, flags);
+	    JSIdentityClear(&id);
+	}
+
+#if defined(__linux__)
+	/* Repeat the above for USB devices, look in the
+	 * "/dev/input/js#" paths where # is a number
+	 */
+	for(i = 0; i < JS_ATTRIBUTES_PROBE_MAX; i++)
+	{
+	    /* Format joystick device path */
+	    sprintf(dev_path, "/dev/input/js%i", i);
+
+	    /* Joystick device does not exist? */
+	    if(access(dev_path, F_OK))
+		continue;
+
+	    JSIdentityLoad(&id, dev_path, NULL);
+	    JSAttributesAppendDevice(header, total, dev_path, &id, flags);
+	    JSIdentityClear(&id);
+	}
+#endif
+}
 
 
 /*
@@ -40,13 +513,30 @@ void JSFreeAttributesList(js_attribute_struct *list, int total);
  *
  *	If the specified calibration file calibration is NULL then the
  *	is_configured and name values will not be obtained.
+ *
+ *	The devices are not opened so is_in_use is always 0, use
+ *	JSGetAttributesListFlags() with JSAttributesFlagCheckInUse to
+ *	obtain it.
  */
 js_attribute_struct *JSGetAttributesList(
 	int *total, const char *calibration
 )
+{
+	return(JSGetAttributesListFlags(total, calibration, 0));
+}
+
+/*
+ *	Same as JSGetAttributesList() except that flags specifies
+ *	which additional values to obtain, any of JSAttributesFlag*.
+ */
+js_attribute_struct *JSGetAttributesListFlags(
+	int *total, const char *calibration,
+	unsigned int flags
+)
 {
 	int total_attribs = 0;
 	js_attribute_struct *attrib = NULL, *attrib_ptr;
+	js_attribute_list_header_struct *header = NULL;
 
 	if(total != NULL)
 	    *total = 0;
@@ -55,204 +545,275 @@ js_attribute_struct *JSGetAttributesList(
 	/* Begin fetching Joystick Attributes list */
 	if(1)
 	{
-	    int i, j, total_dev_names;
-	    const char *s;
-	    char **dev_name, dev_path[PATH_MAX + NAME_MAX];
+	    int i;
 	    js_data_struct jsd;
 
-#define JS_ATTRIB_LIST_APPEND	{		\
- const int n = MAX(total_attribs, 0);		\
- total_attribs = n + 1;				\
- attrib = (js_attribute_struct *)realloc(	\
-  attrib,					\
-  total_attribs * sizeof(js_attribute_struct)	\
- );						\
- if(attrib == NULL) {				\
-  total_attribs = 0;				\
-  attrib_ptr = NULL;				\
- } else {					\
-  attrib_ptr = &attrib[n];			\
-  memset(attrib_ptr, 0x00, sizeof(js_attribute_struct)); \
- }						\
-}
-
-	    /* Begin searching for each device until one is missing,
-	     * look in the "/dev/js#" paths where # is a number
+	    /* Get the joystick devices from sysfs or, if it is not
+	     * available, by looking for their device nodes
 	     */
-	    for(i = 0; 1; i++)
-	    {
-		/* Format joystick device path */
-#if defined(__FreeBSD__)
-		sprintf(dev_path, "/dev/joy%i", i);
-#else
-		sprintf(dev_path, "/dev/js%i", i);
+#if defined(__linux__)
+	    if(JSAttributesListSysFS(&header, &total_attribs, flags))
 #endif
+		JSAttributesListProbe(&header, &total_attribs, flags);
 
-		/* Joystick device does not exist? */
-		if(access(dev_path, F_OK))
-		     break;
+	    if(header != NULL)
+		attrib = (js_attribute_struct *)(header + 1);
 
-		/* Append a new Joystick Attribute to the list */
-		JS_ATTRIB_LIST_APPEND
-		if(attrib_ptr != NULL)
-		{
-		    /* Try to open the device */
-		    const int fd = open(dev_path, O_RDONLY);
-
-		    /* Record device path as the Joystick Attribute's
-		     * device name
-		     */
-		    free(attrib_ptr->device_name);
-		    attrib_ptr->device_name = STRDUP(dev_path);
-
-		    /* Unable to open device? */
-		    if(fd < 0)
-		    {
-			/* Could not open it, handle errno */
-			switch(errno)
-			{
-			  case ENODEV:
-			  case ENFILE:
-			    attrib_ptr->not_accessable = 1;
-			    break;
-
-			  default:
-			    /* All else assume is in use */
-			    attrib_ptr->is_in_use = 1;
-			    break;
-			}
-		    }
-		    else
-		    {
-			/* Opened it just fine, now close it */
-			close(fd);
-		    }
-		}
-	    }
-
-#if defined(__linux__)
-	    /* Repeat the above for USB devices, begin searching in
-	     * "/dev/input/js#" paths where # is a number
+	    /* The Joystick Attributes list has been obtained, now
+	     * load each device's calibration from the calibration file
+	     * (if calibration is not NULL) to see which devices are
+	     * configured properly
+	     *
+	     * The calibration is found by the device's identity first
+	     * and then by its device name, the same as when the device
+	     * is opened by JSInit()
 	     */
-	    for(i = 0; 1; i++)
+	    for(i = 0; (i < total_attribs) && !STRISEMPTY(calibration); i++)
 	    {
-		/* Format joystick device path */
-		sprintf(dev_path, "/dev/input/js%i", i);
+		attrib_ptr = &attrib[i];
+		if(STRISEMPTY(attrib_ptr->device_name))
+		    continue;
 
-		/* Joystick device does not exist? */
-		if(access(dev_path, F_OK))
-		     break;
+		memset(&jsd, 0x00, sizeof(js_data_struct));
+		jsd.fd = -1;
+		jsd.device_name = STRDUP(attrib_ptr->device_name);
+		jsd.calibration_file = STRDUP(calibration);
+		JSIdentityCopy(&jsd.identity, &attrib_ptr->identity);
 
-		/* Append a new Joystick Attribute to the list */
-		JS_ATTRIB_LIST_APPEND
-		if(attrib_ptr != NULL)
+		/* Calibration found for this device? */
+		if(!JSLoadCalibrationUNIX(&jsd))
 		{
-		    /* Try to open the device */
-		    const int fd = open(dev_path, O_RDONLY);
-
-		    /* Record device path as the Joystick Attribute's
-		     * device name
-		     */
-		    free(attrib_ptr->device_name);
-		    attrib_ptr->device_name = STRDUP(dev_path);
-
-		    /* Unable to open device? */
-		    if(fd < 0)
-		    {
-			/* Could not open it, handle errno */
-			switch(errno)
-			{
-			  case ENODEV:
-			  case ENFILE:
-			    attrib_ptr->not_accessable = 1;
-			    break;
-
-			  default:
-			    /* All else assume is in use */
-			    attrib_ptr->is_in_use = 1;
-			    break;
-			}
-		    }
-		    else
-		    {
-			/* Opened it just fine, now close it */
-			close(fd);
-		    }
+		    attrib_ptr->is_configured = 1;
+		    attrib_ptr->name = JSArenaStrDup(
+			&header->arena, jsd.name
+		    );
 		}
+
+		/* Delete the jsd's resources */
+		JSClose(&jsd);
 	    }
+	}
+#else
+#warning JSGetAttributesList() Does not support this platform
 #endif
 
-	    /* The Joystick Attributes list has been obtained, now
-	     * scan through calibration file (if calibration is not
-	     * NULL) and see which devices are configured properly
-	     */
-	    dev_name = JSLoadDeviceNamesUNIX(
-		&total_dev_names, calibration
+	/* Update returns */
+	if(total != NULL)
+	    *total = total_attribs;
+ 
+	return(attrib);
+}
+
+/*
+ *	Returns a copy of the Joystick Attributes list, the copy must
+ *	be deleted by calling JSFreeAttributesList().
+ */
+static js_attribute_struct *JSAttributesListCopy(
+	const js_attribute_struct *list, int total
+)
+{
+	int i, total_copy = 0;
+	const js_attribute_struct *src;
+	js_attribute_struct *tar;
+	js_attribute_list_header_struct *header = NULL;
+
+	for(i = 0; i < total; i++)
+	{
+	    src = &list[i];
+	    tar = JSAttributesListAppend(&header, &total_copy);
+	    if(tar == NULL)
+		break;
+
+	    tar->name = JSArenaStrDup(&header->arena, src->name);
+	    tar->device_name = JSArenaStrDup(
+		&header->arena, src->device_name
 	    );
+	    tar->is_configured = src->is_configured;
+	    tar->is_in_use = src->is_in_use;
+	    tar->not_accessable = src->not_accessable;
+	    JSAttributesSetIdentity(header, tar, &src->identity);
+	}
 
-	    /* Iterate through the Joystick Attributes list */
-	    for(i = 0; i < total_attribs; i++)
-	    {
-		attrib_ptr = &attrib[i];
-		if(STRISEMPTY(attrib_ptr->device_name))
-		    continue;
+	return((header != NULL) ? (js_attribute_struct *)(header + 1) : NULL);
+}
 
-		/* Iterate through device names, see if a device name
-		 * in the list matches this device's name
-		 */
-		for(j = 0; j < total_dev_names; j++)
-		{
-		    s = dev_name[j];
-		    if(STRISEMPTY(s))
-			continue;
+/*
+ *	Checks if the two Joystick Attributes lists have the same
+ *	values.
+ */
+static int JSAttributesListEqual(
+	const js_attribute_struct *a, int total_a,
+	const js_attribute_struct *b, int total_b
+)
+{
+	int i;
 
-		    /* Device name does not match device name on this
-		     * Joystick Attribute?
-		     */
-		    if(strcmp(s, attrib_ptr->device_name))
-		        continue;
+	if(total_a != total_b)
+	    return(0);
 
-		    /* This device is in the device names list, so
-		     * mark it as being configured properly
-		     */
-		    attrib_ptr->is_configured = 1;
+	for(i = 0; i < total_a; i++, a++, b++)
+	{
+	    if(STRCMPNULL(a->name, b->name) ||
+	       STRCMPNULL(a->device_name, b->device_name) ||
+	       (a->is_configured != b->is_configured) ||
+	       (a->is_in_use != b->is_in_use) ||
+	       (a->not_accessable != b->not_accessable) ||
+	       STRCMPNULL(a->identity.name, b->identity.name) ||
+	       (a->identity.vendor != b->identity.vendor) ||
+	       (a->identity.product != b->identity.product) ||
+	       STRCMPNULL(a->identity.phys, b->identity.phys)
+	    )
+		return(0);
+	}
 
-		    /* Get calibration info for this device, first
-		     * reset values on the jsd and then set the device
-		     * name on the jsd and call the calibration file
-		     * loader
-		     */
-		    memset(&jsd, 0x00, sizeof(js_data_struct));
-		    jsd.fd = -1;
-		    jsd.device_name = STRDUP(s);
-		    jsd.calibration_file = STRDUP(calibration);
-		    JSLoadCalibrationUNIX(&jsd);
+	return(1);
+}
 
-		    /* Update values to attribute */
-		    free(attrib_ptr->name);
-		    attrib_ptr->name = STRDUP(jsd.name);
+/*
+ *	Checks if the cached Joystick Attributes list is still valid
+ *	for the calibration file, the cache must be locked.
+ */
+static int JSAttributesCacheIsValid(
+	js_attribute_cache_struct *cache, const char *calibration
+)
+{
+	struct stat stat_buf;
+
+	if(!cache->valid)
+	    return(0);
+
+	/* Device nodes changed? This must be checked every time to
+	 * consume the pending changes
+	 */
+	if(JSHotplugWatchPoll(cache->watch))
+	    return(0);
+
+	/* Different calibration file? */
+	if(STRCMPNULL(cache->calibration, calibration))
+	    return(0);
+
+	/* Calibration file changed? */
+	if(STRISEMPTY(calibration) || stat(calibration, &stat_buf))
+	    return(!cache->calibration_exists);
+
+	return(
+	    cache->calibration_exists &&
+	    (cache->calibration_dev == stat_buf.st_dev) &&
+	    (cache->calibration_ino == stat_buf.st_ino) &&
+	    (cache->calibration_size == stat_buf.st_size) &&
+	    (cache->calibration_mtime == stat_buf.st_mtime) &&
+	    (cache->calibration_mtime_nsec == JS_STAT_MTIME_NSEC(&stat_buf))
+	);
+}
 
-		    /* Delete the jsd's resources */
-		    JSClose(&jsd);
+/*
+ *	Rebuilds the cached Joystick Attributes list if it is not valid
+ *	for the calibration file, the cache must be locked.
+ *
+ *	The generation is incremented only if the rebuilt list is
+ *	different.
+ */
+static void JSAttributesCacheUpdate(
+	js_attribute_cache_struct *cache, const char *calibration
+)
+{
+	int total;
+	struct stat stat_buf;
+	js_attribute_struct *list;
+
+	if(JSAttributesCacheIsValid(cache, calibration))
+	    return;
+
+	/* Start watching the device nodes before the list is built
+	 * so that no changes are missed
+	 */
+	if(cache->watch == NULL)
+	    cache->watch = JSHotplugWatchNew();
+
+	/* Get the calibration file's statistics before the list is
+	 * built, a change while it is built rebuilds it next time
+	 */
+	free(cache->calibration);
+	cache->calibration = STRDUP(calibration);
+	cache->calibration_exists = !STRISEMPTY(calibration) &&
+	    !stat(calibration, &stat_buf);
+	if(cache->calibration_exists)
+	{
+	    cache->calibration_dev = stat_buf.st_dev;
+	    cache->calibration_ino = stat_buf.st_ino;
+	    cache->calibration_size = stat_buf.st_size;
+	    cache->calibration_mtime = stat_buf.st_mtime;
+	    cache->calibration_mtime_nsec = JS_STAT_MTIME_NSEC(&stat_buf);
+	}
 
-		    break;
-		}
-	    }
+	list = JSGetAttributesListFlags(&total, calibration, 0);
+	if(!cache->valid ||
+	   !JSAttributesListEqual(cache->list, cache->total, list, total)
+	)
+	    cache->generation++;
 
-	    /* Free loaded device names */
-	    strlistfree(dev_name, total_dev_names);
+	JSFreeAttributesList(cache->list, cache->total);
+	cache->list = list;
+	cache->total = total;
 
-#undef JS_ATTRIB_LIST_APPEND
-	}
-#else
-#warning JSGetAttributesList() Does not support this platform
-#endif
+	/* Without the device node watch the list is rebuilt each
+	 * time
+	 */
+	cache->valid = (cache->watch != NULL) ? 1 : 0;
+}
 
-	/* Update returns */
+/*
+ *	Same as JSGetAttributesList() except that the list is taken
+ *	from a cache which is rebuilt only when a joystick device node
+ *	or the calibration file has changed.
+ *
+ *	If generation is not NULL then it is set to the cache's
+ *	generation, see JSGetAttributesGeneration().
+ *
+ *	The returned list must be deleted by calling
+ *	JSFreeAttributesList().
+ */
+js_attribute_struct *JSGetAttributesListCached(
+	int *total, const char *calibration,
+	unsigned long *generation
+)
+{
+	js_attribute_struct *list;
+	js_attribute_cache_struct *cache = &js_attribute_cache;
+
+	pthread_mutex_lock(&cache->mutex);
+
+	JSAttributesCacheUpdate(cache, calibration);
+	list = JSAttributesListCopy(cache->list, cache->total);
 	if(total != NULL)
-	    *total = total_attribs;
- 
-	return(attrib);
+	    *total = (list != NULL) ? cache->total : 0;
+	if(generation != NULL)
+	    *generation = cache->generation;
+
+	pthread_mutex_unlock(&cache->mutex);
+
+	return(list);
+}
+
+/*
+ *	Returns the generation of the cached Joystick Attributes list
+ *	for the calibration file, the generation changes each time
+ *	the list changes.
+ *
+ *	This is cheaper than JSGetAttributesListCached() when nothing
+ *	has changed since the list is not coppied.
+ */
+unsigned long JSGetAttributesGeneration(const char *calibration)
+{
+	unsigned long generation;
+	js_attribute_cache_struct *cache = &js_attribute_cache;
+
+	pthread_mutex_lock(&cache->mutex);
+	JSAttributesCacheUpdate(cache, calibration);
+	generation = cache->generation;
+	pthread_mutex_unlock(&cache->mutex);
+
+	return(generation);
 }
 
 /*
@@ -262,14 +823,25 @@ void JSFreeAttributesList(js_attribute_struct *list, int total)
 {
 	int i;
 	js_attribute_struct *a;
+	js_attribute_list_header_struct *header;
 
+	if(list == NULL)
+	    return;
+
+	header = JS_ATTRIBUTE_LIST_HEADER(list);
+
+	/* Delete any values that were not allocated from the arena */
 	for(i = 0; i < total; i++)
 	{
 	    a = &list[i];
 
-	    free(a->name);
-	    free(a->device_name);
+	    JSArenaFree(header->arena, a->name);
+	    JSArenaFree(header->arena, a->device_name);
+	    JSArenaFree(header->arena, a->identity.name);
+	    JSArenaFree(header->arena, a->identity.phys);
 	}
-	free(list);
-}
 
+	/* Delete the arena and the list */
+	JSArenaDelete(header->arena);
+	free(header);
+}
@@ -0,0 +1,437 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "../include/jsw.h"
+
+#include "axishistory.h"
+#include "private.h"
+
+
+/*
+ *	Window Extreme:
+ *
+ *	An entry of a monotonic queue, the queue holds the samples in
+ *	the window that no later sample is smaller (or larger) than so
+ *	its front is always the window's minimum (or maximum).
+ */
+typedef struct {
+
+	int		value;
+	unsigned long	seq;		/* Sequence number of the sample */
+
+} js_axis_history_extreme_struct;
+
+/*
+ *	Axis History:
+ *
+ *	The last size samples of an axis, allocated in one block
+ *	followed by its lists.
+ */
+typedef struct {
+
+	int		size,		/* Samples kept */
+			total,		/* Samples in the lists */
+			newest;		/* Index of the newest sample */
+	unsigned long	seq;		/* Sequence number of the next
+					 * sample */
+
+	int		*value;
+	time_t		*time;		/* Time stamps (in ms) */
+
+	/* Monotonic queues of the window's smallest and largest
+	 * values, each is a ring of size entries
+	 */
+	js_axis_history_extreme_struct	*min,
+					*max;
+	int		min_start, min_total,
+			max_start, max_total;
+
+} js_axis_history_struct;
+#define JS_AXIS_HISTORY(p)	((js_axis_history_struct *)(p))
+
+/*
+ *	Axis Histories:
+ */
+typedef struct {
+
+	js_axis_history_struct	**axis;	/* Indexed by axis number,
+					 * NULL if not kept */
+	int			total_axises;
+
+} js_axis_history_data_struct;
+#define JS_AXIS_HISTORY_DATA(p)	((js_axis_history_data_struct *)(p))
+
+
+static js_axis_history_struct *JSAxisHistoryNew(int size);
+static js_axis_history_struct *JSAxisHistoryGet(
+	js_data_struct *jsd, int n
+);
+static int JSAxisHistoryIndex(js_axis_history_struct *h, int i);
+static double JSAxisHistorySlope(
+	js_axis_history_struct *h, int i_new, int i_old
+);
+static void JSAxisHistoryPushExtreme(
+	js_axis_history_extreme_struct *list, int size,
+	int *start, int *total,
+	int value, unsigned long seq, int is_max
+);
+
+void JSAxisHistoryAdd(void *ptr, int n, int value, time_t t);
+void JSAxisHistoryDelete(void *ptr);
+
+int JSSetAxisHistory(js_data_struct *jsd, int n, int samples);
+int JSGetAxisHistorySample(
+	js_data_struct *jsd, int n, int i,
+	int *value, time_t *t
+);
+double JSGetAxisVelocity(js_data_struct *jsd, int n);
+double JSGetAxisAcceleration(js_data_struct *jsd, int n);
+int JSGetAxisHistoryRange(
+	js_data_struct *jsd, int n,
+	int *min, int *max
+);
+
+
+/*
+ *	Returns the milliseconds from time stamp a to b, the driver's
+ *	time stamps wrap around at 32 bits.
+ */
+#define JS_AXIS_HISTORY_DT(b,a)	\
+	((double)(unsigned int)((unsigned int)(b) - (unsigned int)(a)))
+
+
+/*
+ *	Allocates an empty history of size samples.
+ */
+static js_axis_history_struct *JSAxisHistoryNew(int size)
+{
+	js_axis_history_struct *h = (js_axis_history_struct *)calloc(
+	    1,
+	    sizeof(js_axis_history_struct) +
+	    (2 * size * sizeof(js_axis_history_extreme_struct)) +
+	    (size * sizeof(time_t)) +
+	    (size * sizeof(int))
+	);
+	if(h == NULL)
+	    return(NULL);
+
+	h->size = size;
+	h->newest = size - 1;
+	h->min = (js_axis_history_extreme_struct *)(h + 1);
+	h->max = h->min + size;
+	h->time = (time_t *)(h->max + size);
+	h->value = (int *)(h->time + size);
+
+	return(h);
+}
+
+/*
+ *	Returns the history of axis n on jsd or NULL if it is not
+ *	kept.
+ */
+static js_axis_history_struct *JSAxisHistoryGet(
+	js_data_struct *jsd, int n
+)
+{
+	js_axis_history_data_struct *d;
+
+	if(jsd == NULL)
+	    return(NULL);
+
+	d = JS_AXIS_HISTORY_DATA(JS_PRIVATE(jsd)->axis_history);
+	if((d == NULL) || (n < 0) || (n >= d->total_axises))
+	    return(NULL);
+
+	return(d->axis[n]);
+}
+
+/*
+ *	Returns the list index of sample i, 0 is the newest.
+ */
+static int JSAxisHistoryIndex(js_axis_history_struct *h, int i)
+{
+	i = h->newest - i;
+	return((i < 0) ? (i + h->size) : i);
+}
+
+/*
+ *	Returns the slope (in raw units per second) from sample i_old
+ *	to sample i_new, or 0.0 if they have the same time stamp.
+ */
+static double JSAxisHistorySlope(
+	js_axis_history_struct *h, int i_new, int i_old
+)
+{
+	const double dt = JS_AXIS_HISTORY_DT(h->time[i_new], h->time[i_old]);
+	if(dt <= 0.0)
+	    return(0.0);
+
+	return((double)(h->value[i_new] - h->value[i_old]) * 1000.0 / dt);
+}
+
+/*
+ *	Adds the sample with sequence number seq to the monotonic
+ *	queue, removing the samples that are no longer in the window
+ *	and the ones that can no longer be its minimum (or maximum if
+ *	is_max is true).
+ *
+ *	Each sample is added and removed once so this takes constant
+ *	time on average.
+ */
+static void JSAxisHistoryPushExtreme(
+	js_axis_history_extreme_struct *list, int size,
+	int *start, int *total,
+	int value, unsigned long seq, int is_max
+)
+{
+	int i;
+
+	/* Remove the sample leaving the window from the front */
+	if((*total > 0) && ((list[*start].seq + size) <= seq))
+	{
+	    *start = (*start + 1 < size) ? (*start + 1) : 0;
+	    *total = *total - 1;
+	}
+
+	/* Remove the samples superseded by value from the back */
+	while(*total > 0)
+	{
+	    i = *start + *total - 1;
+	    if(i >= size)
+		i -= size;
+	    if(is_max ? (list[i].value > value) : (list[i].value < value))
+		break;
+	    *total = *total - 1;
+	}
+
+	i = *start + *total;
+	if(i >= size)
+	    i -= size;
+	list[i].value = value;
+	list[i].seq = seq;
+	*total = *total + 1;
+}
+
+
+/*
+ *	Called by JSUpdate() to add the value of axis n from the event
+ *	with time stamp t (in ms).
+ */
+void JSAxisHistoryAdd(void *ptr, int n, int value, time_t t)
+{
+	js_axis_history_data_struct *d = JS_AXIS_HISTORY_DATA(ptr);
+	js_axis_history_struct *h;
+
+	if((d == NULL) || (n < 0) || (n >= d->total_axises))
+	    return;
+
+	h = d->axis[n];
+	if(h == NULL)
+	    return;
+
+	h->newest++;
+	if(h->newest >= h->size)
+	    h->newest = 0;
+	h->value[h->newest] = value;
+	h->time[h->newest] = t;
+	if(h->total < h->size)
+	    h->total++;
+
+	JSAxisHistoryPushExtreme(
+	    h->min, h->size, &h->min_start, &h->min_total,
+	    value, h->seq, 0
+	);
+	JSAxisHistoryPushExtreme(
+	    h->max, h->size, &h->max_start, &h->max_total,
+	    value, h->seq, 1
+	);
+	h->seq++;
+}
+
+/*
+ *	Deletes the Axis Histories.
+ */
+void JSAxisHistoryDelete(void *ptr)
+{
+	js_axis_history_data_struct *d = JS_AXIS_HISTORY_DATA(ptr);
+	int i;
+
+	if(d == NULL)
+	    return;
+
+	for(i = 0; i < d->total_axises; i++)
+	    free(d->axis[i]);
+	free(d->axis);
+	free(d);
+}
+
+
+/*
+ *	Keeps the values and time stamps of the last samples events
+ *	of axis n, 0 stops keeping them.
+ *
+ *	Any samples already kept for the axis are discarded.
+ */
+int JSSetAxisHistory(js_data_struct *jsd, int n, int samples)
+{
+	js_axis_history_data_struct *d;
+	js_axis_history_struct *h = NULL;
+	js_private_struct *priv;
+
+	if(!JSIsAxisAllocated(jsd, n) || (samples < 0))
+	    return(JSBadValue);
+
+	priv = JSPrivateGet(jsd);
+	if(priv == NULL)
+	    return(JSNoBuffers);
+
+	if(samples > 0)
+	{
+	    h = JSAxisHistoryNew(samples);
+	    if(h == NULL)
+		return(JSNoBuffers);
+	}
+
+	d = JS_AXIS_HISTORY_DATA(priv->axis_history);
+	if(d == NULL)
+	{
+	    if(h == NULL)
+		return(JSSuccess);
+
+	    priv->axis_history = d = JS_AXIS_HISTORY_DATA(calloc(
+		1, sizeof(js_axis_history_data_struct)
+	    ));
+	    if(d == NULL)
+	    {
+		free(h);
+		return(JSNoBuffers);
+	    }
+	}
+
+	/* Allocate the axis pointers up to n, the device can gain
+	 * axises when it is reconnected
+	 */
+	if(n >= d->total_axises)
+	{
+	    js_axis_history_struct **list;
+
+	    if(h == NULL)
+		return(JSSuccess);
+
+	    list = (js_axis_history_struct **)realloc(
+		d->axis, (n + 1) * sizeof(js_axis_history_struct *)
+	    );
+	    if(list == NULL)
+	    {
+		free(h);
+		return(JSNoBuffers);
+	    }
+	    memset(
+		&list[d->total_axises], 0x00,
+		(n + 1 - d->total_axises) * sizeof(js_axis_history_struct *)
+	    );
+	    d->axis = list;
+	    d->total_axises = n + 1;
+	}
+
+	free(d->axis[n]);
+	d->axis[n] = h;
+
+	return(JSSuccess);
+}
+
+/*
+ *	Gets sample i of axis n's history, 0 is the newest.
+ */
+int JSGetAxisHistorySample(
+	js_data_struct *jsd, int n, int i,
+	int *value, time_t *t
+)
+{
+	js_axis_history_struct *h = JSAxisHistoryGet(jsd, n);
+
+	if(h == NULL)
+	    return(JSBadValue);
+	if((i < 0) || (i >= h->total))
+	    return(JSError);
+
+	i = JSAxisHistoryIndex(h, i);
+	if(value != NULL)
+	    *value = h->value[i];
+	if(t != NULL)
+	    *t = h->time[i];
+
+	return(JSSuccess);
+}
+
+/*
+ *	Returns the velocity of axis n (in raw units per second) from
+ *	the oldest to the newest sample in its history.
+ */
+double JSGetAxisVelocity(js_data_struct *jsd, int n)
+{
+	js_axis_history_struct *h = JSAxisHistoryGet(jsd, n);
+
+	if((h == NULL) || (h->total < 2))
+	    return(0.0);
+
+	return(JSAxisHistorySlope(
+	    h, h->newest, JSAxisHistoryIndex(h, h->total - 1)
+	));
+}
+
+/*
+ *	Returns the acceleration of axis n (in raw units per second
+ *	squared) from the velocities over the older and the newer half
+ *	of its history.
+ */
+double JSGetAxisAcceleration(js_data_struct *jsd, int n)
+{
+	int i_new, i_mid, i_old;
+	double dt;
+	js_axis_history_struct *h = JSAxisHistoryGet(jsd, n);
+
+	if((h == NULL) || (h->total < 3))
+	    return(0.0);
+
+	i_new = h->newest;
+	i_mid = JSAxisHistoryIndex(h, h->total / 2);
+	i_old = JSAxisHistoryIndex(h, h->total - 1);
+
+	/* The two velocities are at the middle of each half */
+	dt = JS_AXIS_HISTORY_DT(h->time[i_new], h->time[i_old]) / 2.0;
+	if((dt <= 0.0) || (h->time[i_mid] == h->time[i_new]) ||
+	   (h->time[i_mid] == h->time[i_old])
+	)
+	    return(0.0);
+
+	return(
+	    (JSAxisHistorySlope(h, i_new, i_mid) -
+	     JSAxisHistorySlope(h, i_mid, i_old)) * 1000.0 / dt
+	);
+}
+
+/*
+ *	Gets the smallest and largest raw values in axis n's history.
+ */
+int JSGetAxisHistoryRange(
+	js_data_struct *jsd, int n,
+	int *min, int *max
+)
+{
+	js_axis_history_struct *h = JSAxisHistoryGet(jsd, n);
+
+	if(h == NULL)
+	    return(JSBadValue);
+	if(h->total == 0)
+	    return(JSError);
+
+	if(min != NULL)
+	    *min = h->min[h->min_start].value;
+	if(max != NULL)
+	    *max = h->max[h->max_start].value;
+
+	return(JSSuccess);
+}
@@ -0,0 +1,12 @@
+#ifndef AXISHISTORY_H
+#define AXISHISTORY_H
+
+#include <sys/types.h>
+#include "../include/jsw.h"
+
+
+extern void JSAxisHistoryAdd(void *ptr, int n, int value, time_t t);
+extern void JSAxisHistoryDelete(void *ptr);
+
+
+#endif	/* AXISHISTORY_H */
@@ -8,6 +8,9 @@
 
 #include "../include/jsw.h"
 
+#include "device.h"
+#include "private.h"
+
 
 int JSIsAxisAllocated(js_data_struct *jsd, int n);
 double JSGetAxisCoeff(js_data_struct *jsd, int n);
@@ -374,7 +377,7 @@ void JSResetAllAxisTolorance(js_data_struct *jsd)
 		    axis_ptr->tolorance : 0;
 	    }
 
-	    if(ioctl(jsd->fd, JSIOCSCORR, corr))
+	    if(JSDeviceIoctl(jsd->fd, JS_PRIVATE(jsd)->device, JSIOCSCORR, corr))
 		fprintf(
 		    stderr,
 "Failed to set joystick %s correction values: %s\n",
@@ -0,0 +1,306 @@
+/*
+ *	Calibration Parsing Benchmark
+ *
+ *	Times JSLoadCalibrationUNIX(), JSLoadDeviceNamesUNIX() and
+ *	JSGetAttributesList() against the calibration files generated
+ *	by gencalib and reports the time and the number of allocations
+ *	per call.
+ *
+ *	Usage: benchcalib <calibration_file> [calibration_file...]
+ *
+ *	Allocations are counted by interposing malloc(), calloc(),
+ *	realloc() and free() in this program, this relies on the GNU C
+ *	library's __libc_*() entry points.
+ *
+ *	The first call on each calibration file is reported separately
+ *	since it also builds the file's calibration index.
+ *
+ *	Exits with status 1 if a device's calibration was not applied.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../include/jsw.h"
+
+
+/*
+ *	Allocation Counters:
+ */
+typedef struct {
+
+	unsigned long	allocs,		/* Calls to malloc(), calloc()
+					 * and realloc() */
+			frees;
+	unsigned long	bytes;		/* Bytes requested */
+
+} bench_alloc_stats_struct;
+static bench_alloc_stats_struct	bench_alloc_stats;
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+
+/*
+ *	Benchmark Case:
+ */
+typedef struct {
+
+	const char	*name,		/* Function being benchmarked */
+			*device_name;	/* Device to load or NULL */
+	char		device_name_buf[80];
+	const char	*expect_name;	/* Name that the loaded
+					 * calibration must set or NULL */
+
+} bench_case_struct;
+
+/*
+ *	Benchmark Result:
+ */
+typedef struct {
+
+	double		first_us,	/* Time of the first call */
+			mean_us;	/* Mean time of the calls after
+					 * the first */
+	unsigned long	iterations;
+	double		allocs_per_op,
+			bytes_per_op;
+	int		failed;		/* Calibration not applied */
+
+} bench_result_struct;
+
+
+static double BenchNow(void);
+static int BenchCountBlocks(const char *calibration);
+static int BenchRunOnce(
+	const bench_case_struct *c, const char *calibration
+);
+static void BenchRun(
+	const bench_case_struct *c, const char *calibration,
+	bench_result_struct *r
+);
+
+
+/* Minimum time in seconds to run each benchmark case for */
+#define BENCH_MIN_TIME		0.25
+/* Minimum number of calls after the first call */
+#define BENCH_MIN_ITERATIONS	3
+
+
+void *malloc(size_t size)
+{
+	bench_alloc_stats.allocs++;
+	bench_alloc_stats.bytes += size;
+	return(__libc_malloc(size));
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	bench_alloc_stats.allocs++;
+	bench_alloc_stats.bytes += nmemb * size;
+	return(__libc_calloc(nmemb, size));
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	bench_alloc_stats.allocs++;
+	bench_alloc_stats.bytes += size;
+	return(__libc_realloc(ptr, size));
+}
+
+void free(void *ptr)
+{
+	if(ptr != NULL)
+	    bench_alloc_stats.frees++;
+	__libc_free(ptr);
+}
+
+
+/*
+ *	Returns the monotonic time in seconds.
+ */
+static double BenchNow(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((double)ts.tv_sec + ((double)ts.tv_nsec / 1000000000.0));
+}
+
+/*
+ *	Returns the number of device names listed in the calibration
+ *	file.
+ */
+static int BenchCountBlocks(const char *calibration)
+{
+	int i, total = 0;
+	char **names = JSLoadDeviceNamesUNIX(&total, calibration);
+	for(i = 0; i < total; i++)
+	    free(names[i]);
+	free(names);
+	return(total);
+}
+
+/*
+ *	Calls the benchmarked function once, returns non-zero if the
+ *	calibration was not applied.
+ */
+static int BenchRunOnce(
+	const bench_case_struct *c, const char *calibration
+)
+{
+	int status = 0;
+
+	if(!strcmp(c->name, "JSLoadCalibrationUNIX"))
+	{
+	    js_data_struct jsd;
+	    memset(&jsd, 0x00, sizeof(js_data_struct));
+	    jsd.fd = -1;
+	    jsd.device_name = strdup(c->device_name);
+	    jsd.calibration_file = strdup(calibration);
+	    if(JSLoadCalibrationUNIX(&jsd) && (c->expect_name != NULL))
+		status = -1;
+	    else if((c->expect_name != NULL) &&
+		    ((jsd.name == NULL) || strcmp(jsd.name, c->expect_name))
+	    )
+		status = -1;
+	    JSClose(&jsd);
+	}
+	else if(!strcmp(c->name, "JSLoadDeviceNamesUNIX"))
+	{
+	    int i, total = 0;
+	    char **names = JSLoadDeviceNamesUNIX(&total, calibration);
+	    for(i = 0; i < total; i++)
+		free(names[i]);
+	    free(names);
+	}
+	else if(!strcmp(c->name, "JSGetAttributesList"))
+	{
+	    int total = 0;
+	    js_attribute_struct *list = JSGetAttributesList(
+		&total, calibration
+	    );
+	    JSFreeAttributesList(list, total);
+	}
+
+	return(status);
+}
+
+/*
+ *	Runs the benchmark case c against the calibration file.
+ */
+static void BenchRun(
+	const bench_case_struct *c, const char *calibration,
+	bench_result_struct *r
+)
+{
+	double t_start, t;
+	bench_alloc_stats_struct a_start;
+
+	memset(r, 0x00, sizeof(bench_result_struct));
+
+	t_start = BenchNow();
+	if(BenchRunOnce(c, calibration))
+	    r->failed = 1;
+	r->first_us = (BenchNow() - t_start) * 1000000.0;
+
+	a_start = bench_alloc_stats;
+	t_start = BenchNow();
+	do
+	{
+	    BenchRunOnce(c, calibration);
+	    r->iterations++;
+	    t = BenchNow() - t_start;
+	} while((t < BENCH_MIN_TIME) ||
+		(r->iterations < BENCH_MIN_ITERATIONS)
+	);
+
+	r->mean_us = t * 1000000.0 / (double)r->iterations;
+	r->allocs_per_op = (double)(bench_alloc_stats.allocs - a_start.allocs) /
+	    (double)r->iterations;
+	r->bytes_per_op = (double)(bench_alloc_stats.bytes - a_start.bytes) /
+	    (double)r->iterations;
+}
+
+
+int main(int argc, char *argv[])
+{
+	int i, j, total_blocks, status = 0;
+	const char *calibration;
+	bench_case_struct cases[6], *c;
+	bench_result_struct r;
+
+	if(argc < 2)
+	{
+	    fprintf(
+		stderr,
+		"Usage: %s <calibration_file> [calibration_file...]\n",
+		argv[0]
+	    );
+	    return(2);
+	}
+
+	printf(
+	    "%-24s %7s %-22s %-14s %10s %10s %8s %10s %12s\n",
+	    "corpus", "devices", "function", "device",
+	    "first_us", "mean_us", "iters", "allocs/op", "bytes/op"
+	);
+
+	for(i = 1; i < argc; i++)
+	{
+	    calibration = argv[i];
+	    total_blocks = BenchCountBlocks(calibration);
+
+	    /* Load the first, last and a missing device and the
+	     * unterminated block, which is the last device listed
+	     */
+	    memset(cases, 0x00, sizeof(cases));
+	    cases[0].name = "JSLoadCalibrationUNIX";
+	    cases[0].device_name = "/dev/js0";
+	    cases[1].name = "JSLoadCalibrationUNIX";
+	    sprintf(
+		cases[1].device_name_buf, "/dev/js%i",
+		(total_blocks > 2) ? (total_blocks - 2) : 0
+	    );
+	    cases[1].device_name = cases[1].device_name_buf;
+	    cases[2].name = "JSLoadCalibrationUNIX";
+	    cases[2].device_name = "/dev/missing";
+	    cases[3].name = "JSLoadCalibrationUNIX";
+	    sprintf(
+		cases[3].device_name_buf, "/dev/js%i",
+		(total_blocks > 1) ? (total_blocks - 1) : 0
+	    );
+	    cases[3].device_name = cases[3].device_name_buf;
+	    cases[3].expect_name = "Unterminated";
+	    cases[4].name = "JSLoadDeviceNamesUNIX";
+	    cases[5].name = "JSGetAttributesList";
+
+	    for(j = 0; j < (int)(sizeof(cases) / sizeof(bench_case_struct)); j++)
+	    {
+		c = &cases[j];
+		BenchRun(c, calibration, &r);
+		printf(
+		    "%-24s %7i %-22s %-14s %10.1f %10.1f %8lu %10.1f %12.1f\n",
+		    calibration, total_blocks, c->name,
+		    (c->device_name != NULL) ? c->device_name : "-",
+		    r.first_us, r.mean_us, r.iterations,
+		    r.allocs_per_op, r.bytes_per_op
+		);
+		fflush(stdout);
+
+		if(r.failed)
+		{
+		    fprintf(
+			stderr,
+			"%s: Calibration for %s was not applied\n",
+			calibration, c->device_name
+		    );
+		    status = 1;
+		}
+	    }
+	}
+
+	return(status);
+}
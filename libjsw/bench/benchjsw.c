@@ -0,0 +1,400 @@
+/*
+ *	Hot Path Benchmarks
+ *
+ *	Times JSUpdate() decoding events from a synthetic joystick,
+ *	JSGetAxisCoeff() and JSGetAxisCoeffNZ() at each correction
+ *	level, JSGetButtonState() (both the library's and the inline
+ *	version) and JSLoadCalibrationUNIX() against the calibration
+ *	files generated by gencalib.
+ *
+ *	Usage: benchjsw [calibration_file...]
+ *
+ *	The results are written to standard output as JSON, each with
+ *	the number of operations, nanoseconds and cycles per operation
+ *	and operations per second. Cycles are read from the time stamp
+ *	counter on x86 and are null elsewhere.
+ *
+ *	The synthetic joystick's generator runs on its own thread, so
+ *	the JSUpdate() results are the decoding throughput as long as
+ *	the generator keeps ahead of it, which it does on a machine
+ *	with more than one core.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__i386__) || defined(__x86_64__)
+# include <x86intrin.h>
+#endif
+#define JSW_INLINE_ACCESSORS
+#include "../../include/jsw.h"
+
+
+/*
+ *	Benchmark Result:
+ */
+typedef struct {
+
+	unsigned long	ops;
+	double		seconds;
+	double		cycles;		/* Negative if not available */
+
+} bench_result_struct;
+
+/*
+ *	Benchmark Function:
+ *
+ *	Performs about iterations operations and returns the number
+ *	of operations performed.
+ */
+typedef unsigned long (*bench_func)(void *data, unsigned long iterations);
+
+
+static double BenchNow(void);
+static double BenchCycles(void);
+static void BenchRun(
+	bench_func func, void *data, bench_result_struct *r
+);
+static void BenchPrint(
+	const char *name, const bench_result_struct *r
+);
+
+static unsigned long BenchAxisCoeff(void *data, unsigned long iterations);
+static unsigned long BenchAxisCoeffNZ(void *data, unsigned long iterations);
+static unsigned long BenchButtonState(void *data, unsigned long iterations);
+static unsigned long BenchButtonStateInline(
+	void *data, unsigned long iterations
+);
+static unsigned long BenchUpdate(void *data, unsigned long iterations);
+static unsigned long BenchLoadCalibration(
+	void *data, unsigned long iterations
+);
+
+
+/* Minimum time in seconds to run each benchmark for */
+#define BENCH_MIN_TIME		0.25
+
+/* Axises and buttons on the joystick used by the accessors */
+#define BENCH_AXES		8
+#define BENCH_BUTTONS		16
+
+/* Accumulates results so that the calls are not optimized out */
+static volatile double	bench_sink;
+static int		bench_first_result = 1;
+
+
+/*
+ *	Returns the monotonic time in seconds.
+ */
+static double BenchNow(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((double)ts.tv_sec + ((double)ts.tv_nsec / 1000000000.0));
+}
+
+/*
+ *	Returns the time stamp counter or a negative value if it is not
+ *	available.
+ */
+static double BenchCycles(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+	return((double)__rdtsc());
+#else
+	return(-1.0);
+#endif
+}
+
+/*
+ *	Calls func with increasing iterations until it has run for at
+ *	least BENCH_MIN_TIME, the result is the last run.
+ */
+static void BenchRun(
+	bench_func func, void *data, bench_result_struct *r
+)
+{
+	unsigned long iterations = 1000;
+	double t, c;
+
+	/* Warm up */
+	func(data, iterations);
+
+	for(;;)
+	{
+	    c = BenchCycles();
+	    t = BenchNow();
+	    r->ops = func(data, iterations);
+	    r->seconds = BenchNow() - t;
+	    r->cycles = (c < 0.0) ? -1.0 : (BenchCycles() - c);
+
+	    if((r->seconds >= BENCH_MIN_TIME) || (r->ops == 0))
+		break;
+
+	    /* Aim for the minimum time on the next run */
+	    if(r->seconds > 0.0)
+		iterations = (unsigned long)(
+		    (double)iterations * BENCH_MIN_TIME * 1.2 / r->seconds
+		) + 1;
+	    else
+		iterations *= 10;
+	}
+}
+
+/*
+ *	Prints the result as a JSON object.
+ */
+static void BenchPrint(
+	const char *name, const bench_result_struct *r
+)
+{
+	const double ops = (r->ops > 0) ? (double)r->ops : 1.0;
+
+	printf("%s\n    {\"name\": \"%s\", \"ops\": %lu, \"seconds\": %.6f, ",
+	    bench_first_result ? "" : ",", name, r->ops, r->seconds
+	);
+	printf("\"ns_per_op\": %.3f, ", r->seconds * 1e9 / ops);
+	if(r->cycles < 0.0)
+	    printf("\"cycles_per_op\": null, ");
+	else
+	    printf("\"cycles_per_op\": %.3f, ", r->cycles / ops);
+	printf("\"ops_per_sec\": %.1f}",
+	    (r->seconds > 0.0) ? ((double)r->ops / r->seconds) : 0.0
+	);
+	fflush(stdout);
+
+	bench_first_result = 0;
+}
+
+
+/*
+ *	Axis and button accessors, the axis positions cycle through
+ *	the dead zone and both sides of the range.
+ */
+static unsigned long BenchAxisCoeff(void *data, unsigned long iterations)
+{
+	js_data_struct *jsd = (js_data_struct *)data;
+	unsigned long i;
+	double sum = 0.0;
+
+	for(i = 0; i < iterations; i++)
+	{
+	    jsd->axis[i % BENCH_AXES]->cur = (int)((i * 2731) % 65535) - 32767;
+	    sum += JSGetAxisCoeff(jsd, (int)(i % BENCH_AXES));
+	}
+	bench_sink = sum;
+
+	return(iterations);
+}
+
+static unsigned long BenchAxisCoeffNZ(void *data, unsigned long iterations)
+{
+	js_data_struct *jsd = (js_data_struct *)data;
+	unsigned long i;
+	double sum = 0.0;
+
+	for(i = 0; i < iterations; i++)
+	{
+	    jsd->axis[i % BENCH_AXES]->cur = (int)((i * 2731) % 65535) - 32767;
+	    sum += JSGetAxisCoeffNZ(jsd, (int)(i % BENCH_AXES));
+	}
+	bench_sink = sum;
+
+	return(iterations);
+}
+
+static unsigned long BenchButtonState(void *data, unsigned long iterations)
+{
+	js_data_struct *jsd = (js_data_struct *)data;
+	unsigned long i;
+	int sum = 0;
+
+	/* The parentheses call the library's function instead of
+	 * the inline version
+	 */
+	for(i = 0; i < iterations; i++)
+	    sum += (JSGetButtonState)(jsd, (int)(i % BENCH_BUTTONS));
+	bench_sink = (double)sum;
+
+	return(iterations);
+}
+
+static unsigned long BenchButtonStateInline(
+	void *data, unsigned long iterations
+)
+{
+	js_data_struct *jsd = (js_data_struct *)data;
+	unsigned long i;
+	int sum = 0;
+
+	for(i = 0; i < iterations; i++)
+	    sum += JSGetButtonState(jsd, (int)(i % BENCH_BUTTONS));
+	bench_sink = (double)sum;
+
+	return(iterations);
+}
+
+/*
+ *	Opens a synthetic joystick with the parameters data that
+ *	generates iterations events and calls JSUpdate() until they
+ *	have all been decoded, returns the number of events.
+ */
+static unsigned long BenchUpdate(void *data, unsigned long iterations)
+{
+	const char *parms = (const char *)data;
+	char device[256];
+	unsigned int flags = 0;
+	unsigned long total;
+	js_data_struct jsd;
+	js_stats_struct stats;
+
+	if(!strncmp(parms, "coalesce,", 9))
+	{
+	    flags |= JSFlagCoalesce;
+	    parms += 9;
+	}
+
+	snprintf(
+	    device, sizeof(device),
+	    "%saxes=%i,buttons=%i,rate=0,count=%lu,%s",
+	    JSSyntheticDevicePrefix, BENCH_AXES, BENCH_BUTTONS,
+	    iterations, parms
+	);
+	if(JSInit(&jsd, device, "/dev/null", flags) != JSSuccess)
+	    return(0);
+
+	/* The init events are sent first */
+	total = iterations + BENCH_AXES + BENCH_BUTTONS;
+	do
+	{
+	    JSUpdate(&jsd);
+	    JSGetStats(&jsd, &stats);
+	} while(stats.events < total);
+
+	JSClose(&jsd);
+
+	return(total);
+}
+
+/*
+ *	Loads the calibration file data for the first device listed
+ *	in it iterations times.
+ */
+static unsigned long BenchLoadCalibration(
+	void *data, unsigned long iterations
+)
+{
+	const char *calibration = (const char *)data;
+	unsigned long i;
+	js_data_struct jsd;
+
+	/* Each load allocates and frees the device's axises and
+	 * buttons, so it is much slower than the accessors
+	 */
+	iterations = (iterations / 100) + 1;
+	for(i = 0; i < iterations; i++)
+	{
+	    memset(&jsd, 0x00, sizeof(js_data_struct));
+	    jsd.fd = -1;
+	    jsd.device_name = strdup("/dev/js0");
+	    jsd.calibration_file = strdup(calibration);
+	    JSLoadCalibrationUNIX(&jsd);
+	    JSClose(&jsd);
+	}
+
+	return(iterations);
+}
+
+
+int main(int argc, char *argv[])
+{
+	int i, level;
+	char name[256];
+	const char *base;
+	js_data_struct jsd;
+	js_axis_struct *axis;
+	bench_result_struct r;
+	static const char *update_parms[] = {
+	    "pattern=sweep",
+	    "pattern=buttons",
+	    "pattern=mixed",
+	    "coalesce,pattern=sweep",
+	    "coalesce,pattern=burst,burst=64",
+	    NULL
+	};
+
+	printf(
+	    "{\n  \"library\": \"libjsw\",\n  \"version\": \"%i.%i.%i\",\n",
+	    JSWVersionMajor, JSWVersionMinor, JSWVersionRelease
+	);
+	printf("  \"cycles\": \"%s\",\n  \"results\": [",
+	    (BenchCycles() < 0.0) ? "none" : "tsc"
+	);
+
+	/* Accessors on an idle synthetic joystick */
+	snprintf(
+	    name, sizeof(name), "%saxes=%i,buttons=%i,pattern=idle",
+	    JSSyntheticDevicePrefix, BENCH_AXES, BENCH_BUTTONS
+	);
+	if(JSInit(&jsd, name, "/dev/null", 0) != JSSuccess)
+	{
+	    fprintf(stderr, "Unable to open the synthetic joystick\n");
+	    return(1);
+	}
+	for(i = 0; i < BENCH_AXES; i++)
+	{
+	    axis = jsd.axis[i];
+	    axis->min = -32000;
+	    axis->max = 32000;
+	    axis->cen = 100;
+	    axis->nz = 2000;
+	    axis->dz_min = -1000;
+	    axis->dz_max = 1200;
+	    axis->corr_coeff_min1 = 0.1;
+	    axis->corr_coeff_max1 = 0.1;
+	    axis->corr_coeff_min2 = 0.2;
+	    axis->corr_coeff_max2 = 0.2;
+	    axis->flags = (i & 1) ? JSAxisFlagFlipped : 0;
+	}
+	for(level = 0; level <= 2; level++)
+	{
+	    for(i = 0; i < BENCH_AXES; i++)
+		jsd.axis[i]->correction_level = level;
+
+	    BenchRun(BenchAxisCoeff, &jsd, &r);
+	    snprintf(name, sizeof(name), "JSGetAxisCoeff/level%i", level);
+	    BenchPrint(name, &r);
+
+	    BenchRun(BenchAxisCoeffNZ, &jsd, &r);
+	    snprintf(name, sizeof(name), "JSGetAxisCoeffNZ/level%i", level);
+	    BenchPrint(name, &r);
+	}
+	BenchRun(BenchButtonState, &jsd, &r);
+	BenchPrint("JSGetButtonState", &r);
+	BenchRun(BenchButtonStateInline, &jsd, &r);
+	BenchPrint("JSGetButtonState/inline", &r);
+	JSClose(&jsd);
+
+	/* Event decoding */
+	for(i = 0; update_parms[i] != NULL; i++)
+	{
+	    BenchRun(BenchUpdate, (void *)update_parms[i], &r);
+	    snprintf(name, sizeof(name), "JSUpdate/%s", update_parms[i]);
+	    BenchPrint(name, &r);
+	}
+
+	/* Calibration parsing */
+	for(i = 1; i < argc; i++)
+	{
+	    base = strrchr(argv[i], '/');
+	    base = (base != NULL) ? (base + 1) : argv[i];
+	    BenchRun(BenchLoadCalibration, argv[i], &r);
+	    snprintf(name, sizeof(name), "JSLoadCalibrationUNIX/%s", base);
+	    BenchPrint(name, &r);
+	}
+
+	printf("\n  ]\n}\n");
+
+	return(0);
+}
@@ -0,0 +1,193 @@
+/*
+ *	Synthetic Calibration File Generator
+ *
+ *	Writes a reproducible joystick calibration file with the
+ *	specified number of device blocks for use by the calibration
+ *	benchmarks.
+ *
+ *	Usage: gencalib <blocks> <output>
+ *
+ *	Besides well formed device blocks the generated file contains
+ *	comments, blank lines, alias blocks (the same device listed
+ *	under its /dev/input/js# path with the same identity and
+ *	repeated blocks for a device path that was already listed) and
+ *	malformed lines (unknown parameters, missing values, values
+ *	outside of any block and a block with no EndJoystick), so
+ *	that the parser's handling of all of these is measured.
+ *
+ *	The output depends only on the number of blocks.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+static unsigned long GenRand(unsigned long *seed);
+static void GenWriteAxis(FILE *fp, int axis_num, unsigned long *seed);
+static void GenWriteBlock(
+	FILE *fp, const char *device_name, int dev_num,
+	unsigned long *seed
+);
+
+
+#define ATOI(s)		(((s) != NULL) ? atoi(s) : 0)
+
+
+/*
+ *	Returns the next value of a fixed linear congruential sequence,
+ *	the standard library's rand() is not used so that the output
+ *	is the same on all platforms.
+ */
+static unsigned long GenRand(unsigned long *seed)
+{
+	*seed = (*seed * 1103515245UL + 12345UL) & 0x7fffffffUL;
+	return(*seed >> 8);
+}
+
+/*
+ *	Writes an axis calibration block.
+ */
+static void GenWriteAxis(FILE *fp, int axis_num, unsigned long *seed)
+{
+	const int	min = -32767 + (int)(GenRand(seed) % 2000),
+			max = 32767 - (int)(GenRand(seed) % 2000),
+			cen = (int)(GenRand(seed) % 200) - 100;
+
+	fprintf(fp, "    BeginAxis = %i\n", axis_num);
+	fprintf(fp, "        Minimum = %i\n", min);
+	fprintf(fp, "        Center = %i\n", cen);
+	fprintf(fp, "        Maximum = %i\n", max);
+	fprintf(fp, "        NullZone = %i\n", (int)(GenRand(seed) % 4000));
+	fprintf(fp, "        Tolorance = %i\n", (int)(GenRand(seed) % 100));
+	if((GenRand(seed) % 4) == 0)
+	    fprintf(fp, "        Flip\n");
+	if((GenRand(seed) % 8) == 0)
+	    fprintf(fp, "        IsHat\n");
+	fprintf(fp, "        CorrectionLevel = %i\n", (int)(GenRand(seed) % 3));
+	fprintf(fp, "        DeadZoneMinimum = %i\n", cen - 500);
+	fprintf(fp, "        DeadZoneMaximum = %i\n", cen + 500);
+	fprintf(fp, "        CorrectionalCoefficientMinimum1 = %f\n", 0.5);
+	fprintf(fp, "        CorrectionalCoefficientMaximum1 = %f\n", 0.5);
+	fprintf(fp, "        CorrectionalCoefficientMinimum2 = %f\n", 0.25);
+	fprintf(fp, "        CorrectionalCoefficientMaximum2 = %f\n", 0.25);
+	fprintf(fp, "    EndAxis\n");
+}
+
+/*
+ *	Writes a joystick calibration block for the device numbered
+ *	dev_num, the identity is derived from dev_num so that alias
+ *	blocks for the same device share it.
+ */
+static void GenWriteBlock(
+	FILE *fp, const char *device_name, int dev_num,
+	unsigned long *seed
+)
+{
+	int i;
+	const int total_axises = 2 + (int)(GenRand(seed) % 7);
+
+	fprintf(fp, "BeginJoystick = %s\n", device_name);
+	fprintf(fp, "    Name = Synthetic Joystick %i\n", dev_num);
+	fprintf(fp, "    IdentityName = Synthetic Joystick %i\n", dev_num);
+	fprintf(fp, "    IdentityVendor = %.4x\n", 0x1000 + (dev_num % 0x1000));
+	fprintf(fp, "    IdentityProduct = %.4x\n", dev_num & 0xffff);
+	fprintf(fp, "    IdentityPhys = usb-0000:00:%.2x.0-%i/input0\n",
+	    dev_num % 0x20, dev_num
+	);
+	fprintf(fp, "    LastCalibrated = %ld\n", 1000000000L + (long)dev_num);
+
+	/* Every seventh block has a malformed line inside it */
+	switch(dev_num % 7)
+	{
+	  case 3:
+	    fprintf(fp, "    UnknownParameter = %i\n", dev_num);
+	    break;
+	  case 5:
+	    fprintf(fp, "    Name =\n");
+	    fprintf(fp, "    Name = Synthetic Joystick %i\n", dev_num);
+	    break;
+	  case 6:
+	    fprintf(fp, "    # Comment inside a block\n");
+	    fprintf(fp, "    ===\n");
+	    break;
+	}
+
+	for(i = 0; i < total_axises; i++)
+	    GenWriteAxis(fp, i, seed);
+
+	fprintf(fp, "EndJoystick\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+	int i, total_blocks;
+	unsigned long seed = 1;
+	char device_name[80];
+	FILE *fp;
+
+	if(argc < 3)
+	{
+	    fprintf(stderr, "Usage: %s <blocks> <output>\n", argv[0]);
+	    return(2);
+	}
+
+	total_blocks = ATOI(argv[1]);
+	if(total_blocks < 1)
+	    total_blocks = 1;
+
+	fp = fopen(argv[2], "wb");
+	if(fp == NULL)
+	{
+	    perror(argv[2]);
+	    return(1);
+	}
+
+	fprintf(
+	    fp,
+"# Joystick calibration file.\n\
+# Generated by gencalib for %i device blocks.\n\
+#\n\
+\n\
+# Malformed lines outside of any block\n\
+Name = Orphan\n\
+EndAxis\n\
+\n",
+	    total_blocks
+	);
+
+	for(i = 0; i < total_blocks; i++)
+	{
+	    /* Every tenth block after the first is an alias, either the
+	     * previous device under its /dev/input path or a repeat of
+	     * a device path that was already listed
+	     */
+	    if((i > 0) && ((i % 10) == 0))
+	    {
+		if((i % 20) == 0)
+		    sprintf(device_name, "/dev/input/js%i", i - 1);
+		else
+		    sprintf(device_name, "/dev/js%i", i / 2);
+		GenWriteBlock(fp, device_name, i - 1, &seed);
+	    }
+	    else
+	    {
+		sprintf(device_name, "/dev/js%i", i);
+		GenWriteBlock(fp, device_name, i, &seed);
+	    }
+
+	    if((i % 50) == 25)
+		fprintf(fp, "\n# Block %i\n\n", i);
+	}
+
+	/* A final block that is never closed */
+	fprintf(
+	    fp,
+	    "BeginJoystick = /dev/js%i\n    Name = Unterminated\n",
+	    total_blocks
+	);
+
+	fclose(fp);
+
+	return(0);
+}
@@ -0,0 +1,308 @@
+/*
+ *	Synthetic Recording Generator
+ *
+ *	Writes a reproducible event recording in the format read by the
+ *	replay: device for use as the profile guided optimization
+ *	training corpus.
+ *
+ *	Usage: genreplay <pattern> <output>
+ *
+ *	The pattern is one of:
+ *
+ *	flight		Four axes moving smoothly with an occasional
+ *			button press.
+ *	racing		A wheel, throttle and brake reported at a high
+ *			rate in bursts, several events for the same
+ *			axis are often in one read.
+ *	buttons		Fast button taps, a press and its release are
+ *			often in one read.
+ *
+ *	The output depends only on the pattern.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../record.h"
+
+
+/*
+ *	Generator State:
+ */
+typedef struct {
+
+	FILE		*fp;
+	unsigned long	seed;
+	uint64_t	time;		/* Current time (in us) */
+
+	/* State after the last event added */
+	int16_t		axis_value[JS_RECORD_MAX_AXES];
+	uint8_t		button_state[JS_RECORD_MAX_BUTTONS];
+
+	/* Current block */
+	union {
+	    js_record_block_struct	header;
+	    char			buf[JS_RECORD_BLOCK_SIZE];
+	} block;
+
+} gen_struct;
+
+
+static unsigned long GenRand(unsigned long *seed);
+static int GenAxisValue(unsigned long i, int axis_num, int period);
+static void GenFlushBlock(gen_struct *g);
+static void GenAddEvent(gen_struct *g, int type, int number, int value);
+static void GenFlight(gen_struct *g);
+static void GenRacing(gen_struct *g);
+static void GenButtons(gen_struct *g);
+
+
+/* Number of polling periods in each recording */
+#define GEN_TICKS		20000
+
+/* Axises and buttons on the recorded joystick */
+#define GEN_AXES		8
+#define GEN_BUTTONS		16
+
+#ifndef JS_EVENT_BUTTON
+# define JS_EVENT_BUTTON	0x01
+#endif
+#ifndef JS_EVENT_AXIS
+# define JS_EVENT_AXIS		0x02
+#endif
+
+
+/*
+ *	Returns the next value of a fixed linear congruential sequence,
+ *	the standard library's rand() is not used so that the output
+ *	is the same on all platforms.
+ */
+static unsigned long GenRand(unsigned long *seed)
+{
+	*seed = (*seed * 1103515245UL + 12345UL) & 0x7fffffffUL;
+	return(*seed >> 8);
+}
+
+/*
+ *	Returns a triangle wave from -32767 to 32767 with the
+ *	specified period in ticks, each axis has a different phase.
+ */
+static int GenAxisValue(unsigned long i, int axis_num, int period)
+{
+	const long p = (long)((i + (unsigned long)axis_num * 97) % period);
+	const long half = period / 2;
+
+	if(p < half)
+	    return((int)(-32767 + (p * 65534 / half)));
+	else
+	    return((int)(32767 - ((p - half) * 65534 / half)));
+}
+
+/*
+ *	Writes the current block, if it has any events, and starts
+ *	the next one.
+ */
+static void GenFlushBlock(gen_struct *g)
+{
+	if(g->block.header.total_events == 0)
+	    return;
+
+	fwrite(g->block.buf, JS_RECORD_BLOCK_SIZE, 1, g->fp);
+	memset(g->block.buf, 0x00, JS_RECORD_BLOCK_SIZE);
+}
+
+/*
+ *	Adds an event at the current time.
+ */
+static void GenAddEvent(gen_struct *g, int type, int number, int value)
+{
+	js_record_block_struct *b = &g->block.header;
+	js_record_event_struct *rec;
+
+	if(b->total_events >= JS_RECORD_BLOCK_EVENTS)
+	    GenFlushBlock(g);
+
+	if(b->total_events == 0)
+	{
+	    b->magic = JS_RECORD_BLOCK_MAGIC;
+	    b->time = g->time;
+	    memcpy(b->axis_value, g->axis_value, sizeof(b->axis_value));
+	    memcpy(b->button_state, g->button_state, sizeof(b->button_state));
+	}
+
+	rec = &JS_RECORD_BLOCK_EVENT_LIST(b)[b->total_events];
+	rec->time = g->time;
+	rec->event_time = (uint32_t)(g->time / 1000);
+	rec->type = (uint8_t)type;
+	rec->number = (uint8_t)number;
+	rec->value = (int16_t)value;
+	b->total_events++;
+
+	if(type == JS_EVENT_AXIS)
+	    g->axis_value[number] = (int16_t)value;
+	else if(type == JS_EVENT_BUTTON)
+	    g->button_state[number] = (uint8_t)value;
+}
+
+/*
+ *	Four axes polled every 4 ms with a button pressed every
+ *	second or so.
+ */
+static void GenFlight(gen_struct *g)
+{
+	unsigned long i;
+	int n, pressed = -1;
+
+	for(i = 0; i < GEN_TICKS; i++)
+	{
+	    for(n = 0; n < 4; n++)
+		GenAddEvent(g, JS_EVENT_AXIS, n, GenAxisValue(i, n, 2000));
+
+	    if(pressed > -1)
+	    {
+		GenAddEvent(g, JS_EVENT_BUTTON, pressed, 0);
+		pressed = -1;
+	    }
+	    else if((GenRand(&g->seed) % 250) == 0)
+	    {
+		pressed = (int)(GenRand(&g->seed) % GEN_BUTTONS);
+		GenAddEvent(g, JS_EVENT_BUTTON, pressed, 1);
+	    }
+
+	    g->time += 4000;
+	}
+}
+
+/*
+ *	A wheel, throttle and brake with 1 to 8 events each read every
+ *	millisecond.
+ */
+static void GenRacing(gen_struct *g)
+{
+	unsigned long i;
+	int j, n, total;
+
+	for(i = 0; i < GEN_TICKS; i++)
+	{
+	    total = 1 + (int)(GenRand(&g->seed) % 8);
+	    for(j = 0; j < total; j++)
+	    {
+		n = (int)(GenRand(&g->seed) % 3);
+		GenAddEvent(
+		    g, JS_EVENT_AXIS, n,
+		    GenAxisValue((i * 8) + j, n, 4000 + (n * 1000))
+		);
+	    }
+
+	    /* Gear shifts */
+	    if((GenRand(&g->seed) % 500) == 0)
+	    {
+		n = 4 + (int)(GenRand(&g->seed) % 2);
+		GenAddEvent(g, JS_EVENT_BUTTON, n, 1);
+		GenAddEvent(g, JS_EVENT_BUTTON, n, 0);
+	    }
+
+	    g->time += 1000;
+	}
+}
+
+/*
+ *	Buttons tapped every 8 ms, half of the taps are released
+ *	before the next read.
+ */
+static void GenButtons(gen_struct *g)
+{
+	unsigned long i;
+	int n, held = -1;
+
+	for(i = 0; i < GEN_TICKS; i++)
+	{
+	    if(held > -1)
+	    {
+		GenAddEvent(g, JS_EVENT_BUTTON, held, 0);
+		held = -1;
+	    }
+
+	    n = (int)(GenRand(&g->seed) % GEN_BUTTONS);
+	    GenAddEvent(g, JS_EVENT_BUTTON, n, 1);
+	    if(GenRand(&g->seed) & 1)
+		GenAddEvent(g, JS_EVENT_BUTTON, n, 0);
+	    else
+		held = n;
+
+	    g->time += 8000;
+	}
+}
+
+
+int main(int argc, char *argv[])
+{
+	const char *pattern, *output;
+	gen_struct g;
+	union {
+	    js_record_header_struct	header;
+	    char			buf[JS_RECORD_BLOCK_SIZE];
+	} header;
+	js_record_header_struct *h = &header.header;
+
+	if(argc < 3)
+	{
+	    fprintf(
+		stderr,
+		"Usage: %s <flight|racing|buttons> <output>\n",
+		argv[0]
+	    );
+	    return(1);
+	}
+	pattern = argv[1];
+	output = argv[2];
+
+	memset(&g, 0x00, sizeof(gen_struct));
+	g.seed = 1;
+
+	g.fp = fopen(output, "wb");
+	if(g.fp == NULL)
+	{
+	    perror(output);
+	    return(1);
+	}
+
+	/* Header, the joystick starts centered with no buttons
+	 * pressed
+	 */
+	memset(&header, 0x00, sizeof(header));
+	memcpy(h->magic, JS_RECORD_MAGIC, sizeof(h->magic));
+	h->version = JS_RECORD_VERSION;
+	h->block_size = JS_RECORD_BLOCK_SIZE;
+	h->record_size = sizeof(js_record_event_struct);
+	h->driver_version = 0x020100;
+	h->axes = GEN_AXES;
+	h->buttons = GEN_BUTTONS;
+	snprintf(h->name, sizeof(h->name), "Generated %s recording", pattern);
+	strcpy(h->device_name, "/dev/js0");
+	fwrite(header.buf, JS_RECORD_BLOCK_SIZE, 1, g.fp);
+
+	if(!strcmp(pattern, "flight"))
+	    GenFlight(&g);
+	else if(!strcmp(pattern, "racing"))
+	    GenRacing(&g);
+	else if(!strcmp(pattern, "buttons"))
+	    GenButtons(&g);
+	else
+	{
+	    fprintf(stderr, "%s: Unknown pattern\n", pattern);
+	    fclose(g.fp);
+	    remove(output);
+	    return(1);
+	}
+	GenFlushBlock(&g);
+
+	if(fclose(g.fp))
+	{
+	    perror(output);
+	    return(1);
+	}
+
+	return(0);
+}
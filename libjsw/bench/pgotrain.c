@@ -0,0 +1,148 @@
+/*
+ *	Profile Guided Optimization Training
+ *
+ *	Replays each recording given on the command line as fast as
+ *	possible, with and without JSFlagCoalesce, and reads all of
+ *	the axises and buttons after each JSUpdate() as a game would
+ *	each frame.
+ *
+ *	Usage: pgotrain <recording...>
+ *
+ *	The recordings are generated by genreplay, any recording made
+ *	by JSRecordStart() may be used.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../record.h"
+
+
+static unsigned long TrainCountEvents(const char *path);
+static int TrainReplay(const char *path, unsigned int flags);
+
+
+/* Accumulates results so that the calls are not optimized out */
+static volatile double	train_sink;
+
+
+/*
+ *	Returns the number of events the replay: device will send for
+ *	the recording, including the init events for the joystick's
+ *	starting state. Returns 0 on error.
+ */
+static unsigned long TrainCountEvents(const char *path)
+{
+	unsigned long total;
+	FILE *fp = fopen(path, "rb");
+	union {
+	    js_record_header_struct	header;
+	    js_record_block_struct	block;
+	    char			buf[JS_RECORD_BLOCK_SIZE];
+	} buf;
+
+	if(fp == NULL)
+	    return(0);
+
+	if(fread(buf.buf, JS_RECORD_BLOCK_SIZE, 1, fp) != 1)
+	{
+	    fclose(fp);
+	    return(0);
+	}
+	total = buf.header.axes + buf.header.buttons;
+
+	while(fread(buf.buf, JS_RECORD_BLOCK_SIZE, 1, fp) == 1)
+	{
+	    if(buf.block.magic != JS_RECORD_BLOCK_MAGIC)
+		break;
+	    total += buf.block.total_events;
+	}
+
+	fclose(fp);
+
+	return(total);
+}
+
+/*
+ *	Replays the recording, returns non-zero on error.
+ */
+static int TrainReplay(const char *path, unsigned int flags)
+{
+	int i;
+	char device[1024];
+	double sum = 0.0;
+	unsigned long total = TrainCountEvents(path);
+	js_data_struct jsd;
+	js_stats_struct stats;
+
+	if(total == 0)
+	{
+	    fprintf(stderr, "%s: Not a recording\n", path);
+	    return(-1);
+	}
+
+	snprintf(
+	    device, sizeof(device), "%sspeed=0,file=%s",
+	    JSReplayDevicePrefix, path
+	);
+	if(JSInit(&jsd, device, "/dev/null", flags) != JSSuccess)
+	{
+	    fprintf(stderr, "%s: Unable to replay\n", path);
+	    return(-1);
+	}
+
+	/* Use every correction level */
+	for(i = 0; i < jsd.total_axises; i++)
+	{
+	    js_axis_struct *axis = jsd.axis[i];
+	    if(axis == NULL)
+		continue;
+
+	    axis->correction_level = i % 3;
+	    axis->nz = 1000;
+	    axis->dz_min = -2000;
+	    axis->dz_max = 2000;
+	    axis->corr_coeff_min1 = 0.1;
+	    axis->corr_coeff_max1 = 0.1;
+	}
+
+	do
+	{
+	    if(JSUpdate(&jsd) == JSGotEvent)
+	    {
+		for(i = 0; i < jsd.total_axises; i++)
+		    sum += JSGetAxisCoeff(&jsd, i) + JSGetAxisCoeffNZ(&jsd, i);
+		for(i = 0; i < jsd.total_buttons; i++)
+		    sum += (double)JSGetButtonState(&jsd, i);
+	    }
+	    JSGetStats(&jsd, &stats);
+	} while(stats.events < total);
+	train_sink = sum;
+
+	JSClose(&jsd);
+
+	return(0);
+}
+
+
+int main(int argc, char *argv[])
+{
+	int i;
+
+	if(argc < 2)
+	{
+	    fprintf(stderr, "Usage: %s <recording...>\n", argv[0]);
+	    return(1);
+	}
+
+	for(i = 1; i < argc; i++)
+	{
+	    if(TrainReplay(argv[i], 0) ||
+	       TrainReplay(argv[i], JSFlagCoalesce)
+	    )
+		return(1);
+	}
+
+	return(0);
+}
@@ -8,6 +8,9 @@
 
 int JSIsButtonAllocated(js_data_struct *jsd, int n);
 int JSGetButtonState(js_data_struct *jsd, int n);
+unsigned int JSGetButtonPresses(js_data_struct *jsd, int n);
+unsigned int JSGetButtonReleases(js_data_struct *jsd, int n);
+void JSBeginFrame(js_data_struct *jsd);
 
 
 #define ATOI(s)         (((s) != NULL) ? atoi(s) : 0)
@@ -47,3 +50,50 @@ int JSGetButtonState(js_data_struct *jsd, int n)
 	else
 	    return(JSButtonStateOff);
 }
+
+/*
+ *	Gets the number of times button n was pressed since the last
+ *	call to JSBeginFrame().
+ */
+unsigned int JSGetButtonPresses(js_data_struct *jsd, int n)
+{
+	if(JSIsButtonAllocated(jsd, n))
+	    return(jsd->button[n]->presses);
+	else
+	    return(0);
+}
+
+/*
+ *	Gets the number of times button n was released since the last
+ *	call to JSBeginFrame().
+ */
+unsigned int JSGetButtonReleases(js_data_struct *jsd, int n)
+{
+	if(JSIsButtonAllocated(jsd, n))
+	    return(jsd->button[n]->releases);
+	else
+	    return(0);
+}
+
+/*
+ *	Resets the number of presses and releases counted on each
+ *	button.
+ */
+void JSBeginFrame(js_data_struct *jsd)
+{
+	int i;
+	js_button_struct *button;
+
+	if(jsd == NULL)
+	    return;
+
+	for(i = 0; i < jsd->total_buttons; i++)
+	{
+	    button = jsd->button[i];
+	    if(button == NULL)
+		continue;
+
+	    button->presses = 0;
+	    button->releases = 0;
+	}
+}
@@ -0,0 +1,619 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "../include/cfgfmt.h"
+#include "../include/string.h"
+#include "../include/fio.h"
+
+#include "../include/jsw.h"
+
+#include "identity.h"
+#include "calibindex.h"
+
+
+/*
+ *	Calibration File Block:
+ *
+ *	Records the position of a joystick calibration block in the
+ *	calibration file.
+ */
+typedef struct {
+
+	long		offset;		/* Position of the BeginJoystick
+					 * line in the calibration file */
+	char		*identity;	/* Identity key of the block, can
+					 * be NULL if the block has none */
+
+} js_calib_index_block_struct;
+
+/*
+ *	Calibration File Index Entry:
+ *
+ *	Records the joystick calibration blocks that have the same
+ *	device name or identity key, in the order that they appear in
+ *	the calibration file.
+ */
+typedef struct _js_calib_index_entry_struct js_calib_index_entry_struct;
+struct _js_calib_index_entry_struct {
+
+	char		*key;		/* Device name or identity key */
+	unsigned int	hash;
+	js_calib_index_block_struct	*block;
+	int		total_blocks;
+
+	js_calib_index_entry_struct	*next;
+
+};
+
+/*
+ *	Calibration File Index Hash Table:
+ */
+typedef struct {
+
+	js_calib_index_entry_struct	**bucket;
+	int		total_buckets,	/* Always a power of 2 */
+			total_entries;
+
+} js_calib_hash_struct;
+
+/*
+ *	Calibration File Index:
+ */
+typedef struct {
+
+	char		*path;		/* Calibration file */
+
+	/* Calibration file's statistics when the index was made, if
+	 * they change then the index is out of date */
+	dev_t		dev;
+	ino_t		ino;
+	off_t		size;
+	time_t		mtime;
+	long		mtime_nsec;
+
+	js_calib_hash_struct	by_device,	/* Keyed by device name */
+				by_identity;	/* Keyed by identity key */
+
+} js_calib_index_struct;
+
+
+static unsigned int JSCalibIndexHash(const char *s);
+static js_calib_index_entry_struct *JSCalibHashGet(
+	js_calib_hash_struct *h, const char *key
+);
+static void JSCalibHashAdd(
+	js_calib_hash_struct *h, const char *key,
+	long offset, const char *identity
+);
+static void JSCalibHashClear(js_calib_hash_struct *h);
+static void JSCalibIndexAddBlock(
+	js_calib_index_struct *idx, const char *block_device,
+	long block_offset, const js_identity_struct *block_id
+);
+static js_calib_index_struct *JSCalibIndexNew(
+	const char *path, const struct stat *stat_buf
+);
+static void JSCalibIndexDelete(js_calib_index_struct *idx);
+static js_calib_index_struct *JSCalibIndexGet(const char *calibration);
+long *JSCalibIndexFind(
+	const char *calibration,
+	const char *device_name,
+	const js_identity_struct *id,
+	int *total
+);
+
+
+#define ATOI(s)         (((s) != NULL) ? atoi(s) : 0)
+#define STRDUP(s)       (((s) != NULL) ? strdup(s) : NULL)
+
+#define MAX(a,b)        (((a) > (b)) ? (a) : (b))
+#define MIN(a,b)        (((a) < (b)) ? (a) : (b))
+#define STRLEN(s)       (((s) != NULL) ? strlen(s) : 0)
+#define STRISEMPTY(s)   (((s) != NULL) ? (*(s) == '\0') : 1)
+
+
+#if defined(__linux__)
+# define JS_STAT_MTIME_NSEC(s)	((long)(s)->st_mtim.tv_nsec)
+#else
+# define JS_STAT_MTIME_NSEC(s)	0l
+#endif
+
+
+/*
+ *	Maximum number of calibration file indices to keep:
+ */
+#define JS_CALIB_INDEX_CACHE_MAX	4
+
+/*
+ *	Initial number of buckets in each hash table:
+ */
+#define JS_CALIB_HASH_BUCKETS_MIN	16
+
+
+/*
+ *	Calibration file indices, most recently used first.
+ */
+static js_calib_index_struct	*js_calib_index_cache[JS_CALIB_INDEX_CACHE_MAX];
+
+
+/*
+ *	Returns the FNV-1a hash of the string s.
+ */
+static unsigned int JSCalibIndexHash(const char *s)
+{
+	unsigned int h = 2166136261u;
+
+	while(*s != '\0')
+	{
+	    h ^= (unsigned char)*s++;
+	    h *= 16777619u;
+	}
+
+	return(h);
+}
+
+/*
+ *	Returns the entry for key in the hash table or NULL if it is
+ *	not in the hash table.
+ */
+static js_calib_index_entry_struct *JSCalibHashGet(
+	js_calib_hash_struct *h, const char *key
+)
+{
+	unsigned int hash;
+	js_calib_index_entry_struct *e;
+
+	if((h->bucket == NULL) || (key == NULL))
+	    return(NULL);
+
+	hash = JSCalibIndexHash(key);
+	for(e = h->bucket[hash & (h->total_buckets - 1)];
+	    e != NULL;
+	    e = e->next
+	)
+	{
+	    if((e->hash == hash) && !strcmp(e->key, key))
+		return(e);
+	}
+
+	return(NULL);
+}
+
+/*
+ *	Adds the block at offset to the entry for key in the hash
+ *	table, the entry is created as needed.
+ *
+ *	The hash table will be grown as needed.
+ */
+static void JSCalibHashAdd(
+	js_calib_hash_struct *h, const char *key,
+	long offset, const char *identity
+)
+{
+	unsigned int hash;
+	js_calib_index_block_struct *block;
+	js_calib_index_entry_struct *e, **b;
+
+	if(STRISEMPTY(key))
+	    return;
+
+	/* Add to the existing entry */
+	e = JSCalibHashGet(h, key);
+	if(e != NULL)
+	{
+	    block = (js_calib_index_block_struct *)realloc(
+		e->block,
+		(e->total_blocks + 1) * sizeof(js_calib_index_block_struct)
+	    );
+	    if(block == NULL)
+		return;
+	    e->block = block;
+	    block = &e->block[e->total_blocks];
+	    block->offset = offset;
+	    block->identity = STRDUP(identity);
+	    e->total_blocks++;
+	    return;
+	}
+
+	/* Grow the hash table when it becomes 3/4 full */
+	if((h->total_entries + 1) > (h->total_buckets * 3 / 4))
+	{
+	    int i;
+	    const int n = MAX(h->total_buckets * 2, JS_CALIB_HASH_BUCKETS_MIN);
+	    js_calib_index_entry_struct *next, **bucket =
+		(js_calib_index_entry_struct **)calloc(
+		    n, sizeof(js_calib_index_entry_struct *)
+		);
+	    if(bucket == NULL)
+		return;
+
+	    for(i = 0; i < h->total_buckets; i++)
+	    {
+		for(e = h->bucket[i]; e != NULL; e = next)
+		{
+		    next = e->next;
+		    b = &bucket[e->hash & (n - 1)];
+		    e->next = *b;
+		    *b = e;
+		}
+	    }
+	    free(h->bucket);
+	    h->bucket = bucket;
+	    h->total_buckets = n;
+	}
+
+	e = (js_calib_index_entry_struct *)calloc(
+	    1, sizeof(js_calib_index_entry_struct)
+	);
+	if(e == NULL)
+	    return;
+
+	e->block = (js_calib_index_block_struct *)malloc(
+	    sizeof(js_calib_index_block_struct)
+	);
+	if(e->block == NULL)
+	{
+	    free(e);
+	    return;
+	}
+	e->block->offset = offset;
+	e->block->identity = STRDUP(identity);
+	e->total_blocks = 1;
+
+	hash = JSCalibIndexHash(key);
+	e->key = STRDUP(key);
+	e->hash = hash;
+
+	b = &h->bucket[hash & (h->total_buckets - 1)];
+	e->next = *b;
+	*b = e;
+	h->total_entries++;
+}
+
+/*
+ *	Deletes all the entries in the hash table.
+ */
+static void JSCalibHashClear(js_calib_hash_struct *h)
+{
+	int i, j;
+	js_calib_index_entry_struct *e, *next;
+
+	for(i = 0; i < h->total_buckets; i++)
+	{
+	    for(e = h->bucket[i]; e != NULL; e = next)
+	    {
+		next = e->next;
+		free(e->key);
+		for(j = 0; j < e->total_blocks; j++)
+		    free(e->block[j].identity);
+		free(e->block);
+		free(e);
+	    }
+	}
+	free(h->bucket);
+	h->bucket = NULL;
+	h->total_buckets = 0;
+	h->total_entries = 0;
+}
+
+/*
+ *	Records the position of the joystick calibration block that
+ *	starts at block_offset by its device name and, if it specifies
+ *	one, by its identity key.
+ */
+static void JSCalibIndexAddBlock(
+	js_calib_index_struct *idx, const char *block_device,
+	long block_offset, const js_identity_struct *block_id
+)
+{
+	char key[JS_IDENTITY_KEY_MAX];
+	const char *id_key = JSIdentityKey(block_id, key, sizeof(key));
+
+	JSCalibHashAdd(
+	    &idx->by_device, block_device,
+	    block_offset, id_key
+	);
+	if(id_key != NULL)
+	    JSCalibHashAdd(
+		&idx->by_identity, id_key,
+		block_offset, id_key
+	    );
+}
+
+/*
+ *	Creates a new index of the calibration file specified by path.
+ *
+ *	The position of each joystick calibration block is recorded by
+ *	the block's device name and, if the block specifies one, by its
+ *	identity key. If more than one block has the same device name
+ *	or identity key then all of them are recorded in the order
+ *	that they appear in the calibration file, since the calibration
+ *	file loader applies each of them in turn.
+ *
+ *	A block ends at its EndJoystick line, the next BeginJoystick
+ *	line or the end of the file, since the calibration file loader
+ *	accepts a block without an EndJoystick line.
+ */
+static js_calib_index_struct *JSCalibIndexNew(
+	const char *path, const struct stat *stat_buf
+)
+{
+	int lines_read = 0;
+	long offset, block_offset = -1;
+	char *line_buf;
+	char parm[CFG_PARAMETER_MAX];
+	char val[CFG_VALUE_MAX];
+	char block_device[CFG_VALUE_MAX];
+	js_identity_struct block_id;
+	FILE *fp;
+	js_calib_index_struct *idx;
+
+	fp = FOpen(path, "rb");
+	if(fp == NULL)
+	    return(NULL);
+
+	idx = (js_calib_index_struct *)calloc(
+	    1, sizeof(js_calib_index_struct)
+	);
+	if(idx == NULL)
+	{
+	    FClose(fp);
+	    return(NULL);
+	}
+
+	idx->path = STRDUP(path);
+	idx->dev = stat_buf->st_dev;
+	idx->ino = stat_buf->st_ino;
+	idx->size = stat_buf->st_size;
+	idx->mtime = stat_buf->st_mtime;
+	idx->mtime_nsec = JS_STAT_MTIME_NSEC(stat_buf);
+
+	memset(&block_id, 0x00, sizeof(js_identity_struct));
+	*block_device = '\0';
+
+	/* Begin reading the calibration file */
+	line_buf = NULL;
+	while(1)
+	{
+	    const char *s;
+
+	    /* Read next non-comment line */
+	    offset = ftell(fp);
+	    free(line_buf);
+	    line_buf = FReadNextLineAllocCount(
+		fp, UNIXCFG_COMMENT_CHAR, &lines_read
+	    );
+	    if(line_buf == NULL)
+		break;
+
+	    /* Fetch parameter */
+	    s = StringCfgParseParm(line_buf);
+	    if(s == NULL)
+		continue;
+	    strncpy(parm, s, sizeof(parm));
+	    parm[sizeof(parm) - 1] = '\0';
+
+	    /* Fetch value */
+	    s = StringCfgParseValue(line_buf);
+	    if(s == NULL)
+		s = "0";
+	    strncpy(val, s, sizeof(val));
+	    val[sizeof(val) - 1] = '\0';
+
+	    /* BeginJoystick */
+	    if(!strcasecmp(parm, "BeginJoystick"))
+	    {
+		/* Previous block has no EndJoystick? */
+		if(block_offset > -1)
+		    JSCalibIndexAddBlock(
+			idx, block_device, block_offset, &block_id
+		    );
+
+		block_offset = offset;
+		strncpy(block_device, val, sizeof(block_device));
+		block_device[sizeof(block_device) - 1] = '\0';
+		JSIdentityClear(&block_id);
+	    }
+	    /* Outside of a joystick block? */
+	    else if(block_offset < 0)
+	    {
+		/* Ignore */
+	    }
+	    /* IdentityName */
+	    else if(!strcasecmp(parm, "IdentityName"))
+	    {
+		free(block_id.name);
+		block_id.name = STRDUP(val);
+	    }
+	    /* IdentityVendor */
+	    else if(!strcasecmp(parm, "IdentityVendor"))
+	    {
+		block_id.vendor = (unsigned int)strtoul(val, NULL, 16);
+	    }
+	    /* IdentityProduct */
+	    else if(!strcasecmp(parm, "IdentityProduct"))
+	    {
+		block_id.product = (unsigned int)strtoul(val, NULL, 16);
+	    }
+	    /* IdentityPhys */
+	    else if(!strcasecmp(parm, "IdentityPhys"))
+	    {
+		free(block_id.phys);
+		block_id.phys = STRDUP(val);
+	    }
+	    /* EndJoystick */
+	    else if(!strcasecmp(parm, "EndJoystick"))
+	    {
+		JSCalibIndexAddBlock(
+		    idx, block_device, block_offset, &block_id
+		);
+
+		block_offset = -1;
+		*block_device = '\0';
+		JSIdentityClear(&block_id);
+	    }
+	}
+
+	free(line_buf);
+
+	/* Last block has no EndJoystick? */
+	if(block_offset > -1)
+	    JSCalibIndexAddBlock(idx, block_device, block_offset, &block_id);
+	JSIdentityClear(&block_id);
+
+	FClose(fp);
+
+	return(idx);
+}
+
+/*
+ *	Deletes the calibration file index.
+ */
+static void JSCalibIndexDelete(js_calib_index_struct *idx)
+{
+	if(idx == NULL)
+	    return;
+
+	JSCalibHashClear(&idx->by_device);
+	JSCalibHashClear(&idx->by_identity);
+	free(idx->path);
+	free(idx);
+}
+
+/*
+ *	Returns the index of the calibration file, the index is
+ *	created or recreated as needed if the calibration file has
+ *	changed since it was last indexed.
+ *
+ *	Returns NULL if the calibration file does not exist.
+ */
+static js_calib_index_struct *JSCalibIndexGet(const char *calibration)
+{
+	int i;
+	js_calib_index_struct *idx;
+	struct stat stat_buf;
+
+	if(stat(calibration, &stat_buf))
+	    return(NULL);
+
+	/* Look for an existing index */
+	for(i = 0; i < JS_CALIB_INDEX_CACHE_MAX; i++)
+	{
+	    idx = js_calib_index_cache[i];
+	    if(idx == NULL)
+		continue;
+
+	    if(strcmp(idx->path, calibration))
+		continue;
+
+	    /* Calibration file changed since it was indexed? */
+	    if((idx->dev != stat_buf.st_dev) ||
+	       (idx->ino != stat_buf.st_ino) ||
+	       (idx->size != stat_buf.st_size) ||
+	       (idx->mtime != stat_buf.st_mtime) ||
+	       (idx->mtime_nsec != JS_STAT_MTIME_NSEC(&stat_buf))
+	    )
+	    {
+		JSCalibIndexDelete(idx);
+		idx = JSCalibIndexNew(calibration, &stat_buf);
+	    }
+
+	    /* Move to the front of the list */
+	    for(; i > 0; i--)
+		js_calib_index_cache[i] = js_calib_index_cache[i - 1];
+	    js_calib_index_cache[0] = idx;
+
+	    return(idx);
+	}
+
+	/* Index the calibration file and put it at the front of the
+	 * list, the least recently used index is deleted
+	 */
+	idx = JSCalibIndexNew(calibration, &stat_buf);
+	if(idx == NULL)
+	    return(NULL);
+
+	JSCalibIndexDelete(js_calib_index_cache[JS_CALIB_INDEX_CACHE_MAX - 1]);
+	for(i = JS_CALIB_INDEX_CACHE_MAX - 1; i > 0; i--)
+	    js_calib_index_cache[i] = js_calib_index_cache[i - 1];
+	js_calib_index_cache[0] = idx;
+
+	return(idx);
+}
+
+/*
+ *	Finds the positions of the joystick calibration blocks in the
+ *	calibration file for the device specified by device_name and
+ *	identity id.
+ *
+ *	The blocks with a matching identity are used first, even if
+ *	they were saved for a different device name. Otherwise the
+ *	blocks for device_name are used, except for the ones that
+ *	specify an identity that does not match id (meaning that they
+ *	were saved for a different device connected as device_name).
+ *
+ *	Returns the positions of the blocks' BeginJoystick lines in
+ *	the order that they appear in the calibration file, or NULL if
+ *	there is no block for the device. The returned list must be
+ *	deleted by the calling function.
+ */
+long *JSCalibIndexFind(
+	const char *calibration,
+	const char *device_name,
+	const js_identity_struct *id,
+	int *total
+)
+{
+	int i;
+	char key[JS_IDENTITY_KEY_MAX];
+	const char *id_key;
+	long *list;
+	js_calib_index_block_struct *block;
+	js_calib_index_entry_struct *e;
+	js_calib_index_struct *idx;
+
+	if(total != NULL)
+	    *total = 0;
+
+	if(STRISEMPTY(calibration) || (total == NULL))
+	    return(NULL);
+
+	idx = JSCalibIndexGet(calibration);
+	if(idx == NULL)
+	    return(NULL);
+
+	/* Look up by identity and then by device name */
+	id_key = JSIdentityKey(id, key, sizeof(key));
+	e = (id_key != NULL) ?
+	    JSCalibHashGet(&idx->by_identity, id_key) : NULL;
+	if(e == NULL)
+	    e = JSCalibHashGet(&idx->by_device, device_name);
+	if(e == NULL)
+	    return(NULL);
+
+	list = (long *)malloc(e->total_blocks * sizeof(long));
+	if(list == NULL)
+	    return(NULL);
+
+	for(i = 0; i < e->total_blocks; i++)
+	{
+	    block = &e->block[i];
+	    if((id_key != NULL) && (block->identity != NULL) &&
+	       strcmp(id_key, block->identity)
+	    )
+		continue;
+
+	    list[*total] = block->offset;
+	    *total = *total + 1;
+	}
+	if(*total == 0)
+	{
+	    free(list);
+	    return(NULL);
+	}
+
+	return(list);
+}
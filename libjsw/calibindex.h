@@ -0,0 +1,16 @@
+#ifndef CALIBINDEX_H
+#define CALIBINDEX_H
+
+#include <sys/types.h>
+#include "../include/jsw.h"
+
+
+extern long *JSCalibIndexFind(
+	const char *calibration,
+	const char *device_name,
+	const js_identity_struct *id,
+	int *total
+);
+
+
+#endif	/* CALIBINDEX_H */
@@ -0,0 +1,325 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "../include/jsw.h"
+
+#include "identity.h"
+#include "arena.h"
+#include "calibloader.h"
+#include "private.h"
+
+
+/*
+ *	Calibration Loader:
+ *
+ *	Loads the calibration for an opened joystick on a worker
+ *	thread. The calibration is loaded into a separate jsd which is
+ *	not seen by the calling thread until the load is complete, the
+ *	values are then applied to the opened joystick's jsd by
+ *	JSCalibLoaderPoll() on the calling thread.
+ */
+typedef struct {
+
+	pthread_t	thread;
+	pthread_mutex_t	mutex;
+	int		done,		/* Worker finished loading */
+			joined;		/* Worker thread joined */
+
+	int		fd;		/* Opened joystick's descriptor */
+	void		*device;	/* Opened joystick's device
+					 * backend */
+	js_data_struct	jsd;		/* Loaded calibration */
+
+} js_calib_loader_struct;
+
+
+static void *JSCalibLoaderThread(void *data);
+static void JSCalibLoaderApply(
+	js_calib_loader_struct *cl, js_data_struct *jsd
+);
+void *JSCalibLoaderNew(js_data_struct *jsd);
+int JSCalibLoaderPoll(void *ptr, js_data_struct *jsd, int block);
+void JSCalibLoaderDelete(void *ptr);
+
+
+#define STRDUP(s)       (((s) != NULL) ? strdup(s) : NULL)
+
+
+/*
+ *	Worker thread, loads the calibration and sets the low-level
+ *	joystick driver's tolorance.
+ */
+static void *JSCalibLoaderThread(void *data)
+{
+	js_calib_loader_struct *cl = (js_calib_loader_struct *)data;
+	js_data_struct *jsd = &cl->jsd;
+	js_private_struct *priv;
+
+	JSLoadCalibrationUNIX(jsd);
+
+	/* Set axis tolorance for error correction, the jsd is
+	 * marked as initialized on the opened joystick's descriptor
+	 * only for this call
+	 */
+	priv = JSPrivateGet(jsd);
+	if(priv != NULL)
+	{
+	    jsd->fd = cl->fd;
+	    priv->device = cl->device;
+	    jsd->flags |= JSFlagIsInit;
+	    JSResetAllAxisTolorance(jsd);
+	    jsd->fd = -1;
+	    priv->device = NULL;
+	    jsd->flags &= ~JSFlagIsInit;
+	}
+
+	pthread_mutex_lock(&cl->mutex);
+	cl->done = 1;
+	pthread_mutex_unlock(&cl->mutex);
+
+	return(NULL);
+}
+
+/*
+ *	Applies the loaded calibration to the opened joystick's jsd.
+ *
+ *	The axis and button values on the opened joystick's jsd are
+ *	kept, additional axises and buttons are allocated as needed.
+ */
+static void JSCalibLoaderApply(
+	js_calib_loader_struct *cl, js_data_struct *jsd
+)
+{
+	int i;
+	js_axis_struct *src, *tar;
+	js_data_struct *cal = &cl->jsd;
+
+	/* Allocate additional axises */
+	if(cal->total_axises > jsd->total_axises)
+	{
+	    js_axis_struct **axis = (js_axis_struct **)realloc(
+		jsd->axis,
+		cal->total_axises * sizeof(js_axis_struct *)
+	    );
+	    if(axis != NULL)
+	    {
+		for(i = jsd->total_axises; i < cal->total_axises; i++)
+		    axis[i] = NULL;
+		jsd->axis = axis;
+		jsd->total_axises = cal->total_axises;
+	    }
+	}
+	for(i = 0; i < cal->total_axises; i++)
+	{
+	    src = cal->axis[i];
+	    if((src == NULL) || (i >= jsd->total_axises))
+		continue;
+
+	    tar = jsd->axis[i];
+	    if(tar == NULL)
+	    {
+		/* New axis, the loaded axis belongs to the loaded
+		 * calibration's arena so copy it
+		 */
+		jsd->axis[i] = tar = (js_axis_struct *)JSPrivateAlloc(
+		    jsd, sizeof(js_axis_struct)
+		);
+		if(tar != NULL)
+		    memcpy(tar, src, sizeof(js_axis_struct));
+		continue;
+	    }
+
+	    tar->min = src->min;
+	    tar->cen = src->cen;
+	    tar->max = src->max;
+	    tar->nz = src->nz;
+	    tar->tolorance = src->tolorance;
+	    tar->flags = src->flags;
+	    tar->correction_level = src->correction_level;
+	    tar->dz_min = src->dz_min;
+	    tar->dz_max = src->dz_max;
+	    tar->corr_coeff_min1 = src->corr_coeff_min1;
+	    tar->corr_coeff_max1 = src->corr_coeff_max1;
+	    tar->corr_coeff_min2 = src->corr_coeff_min2;
+	    tar->corr_coeff_max2 = src->corr_coeff_max2;
+	}
+
+	/* Allocate additional buttons */
+	if(cal->total_buttons > jsd->total_buttons)
+	{
+	    js_button_struct **button = (js_button_struct **)realloc(
+		jsd->button,
+		cal->total_buttons * sizeof(js_button_struct *)
+	    );
+	    if(button != NULL)
+	    {
+		for(i = jsd->total_buttons; i < cal->total_buttons; i++)
+		{
+		    if(cal->button[i] == NULL)
+		    {
+			button[i] = NULL;
+			continue;
+		    }
+		    button[i] = (js_button_struct *)JSPrivateAlloc(
+			jsd, sizeof(js_button_struct)
+		    );
+		    if(button[i] != NULL)
+			memcpy(
+			    button[i], cal->button[i],
+			    sizeof(js_button_struct)
+			);
+		}
+		jsd->button = button;
+		jsd->total_buttons = cal->total_buttons;
+	    }
+	}
+
+	/* Descriptive name */
+	if(cal->name != NULL)
+	{
+	    free(jsd->name);
+	    jsd->name = cal->name;
+	    cal->name = NULL;
+	}
+
+	jsd->last_calibrated = cal->last_calibrated;
+}
+
+/*
+ *	Starts loading the calibration for the opened joystick
+ *	specified by jsd on a worker thread.
+ *
+ *	The returned loader must be passed to JSCalibLoaderPoll() to
+ *	apply the calibration once it has been loaded and deleted
+ *	with JSCalibLoaderDelete().
+ *
+ *	Returns NULL on error, in which case the calibration should be
+ *	loaded by the calling function.
+ */
+void *JSCalibLoaderNew(js_data_struct *jsd)
+{
+	int i;
+	js_axis_struct *axis;
+	js_data_struct *cal;
+	js_calib_loader_struct *cl;
+
+	if(jsd == NULL)
+	    return(NULL);
+
+	cl = (js_calib_loader_struct *)calloc(
+	    1, sizeof(js_calib_loader_struct)
+	);
+	if(cl == NULL)
+	    return(NULL);
+
+	cl->fd = jsd->fd;
+	cl->device = JS_PRIVATE(jsd)->device;
+
+	/* Set up the jsd that the calibration will be loaded into
+	 * with the same axises and buttons as the opened joystick
+	 */
+	cal = &cl->jsd;
+	cal->fd = -1;
+	cal->device_name = STRDUP(jsd->device_name);
+	cal->calibration_file = STRDUP(jsd->calibration_file);
+	JSIdentityCopy(&cal->identity, &jsd->identity);
+
+	if(jsd->total_axises > 0)
+	{
+	    cal->axis = (js_axis_struct **)calloc(
+		jsd->total_axises, sizeof(js_axis_struct *)
+	    );
+	    if(cal->axis != NULL)
+		cal->total_axises = jsd->total_axises;
+	}
+	for(i = 0; i < cal->total_axises; i++)
+	{
+	    if(jsd->axis[i] == NULL)
+		continue;
+
+	    cal->axis[i] = axis = (js_axis_struct *)JSPrivateAlloc(
+		cal, sizeof(js_axis_struct)
+	    );
+	    if(axis != NULL)
+		memcpy(axis, jsd->axis[i], sizeof(js_axis_struct));
+	}
+	if(jsd->total_buttons > 0)
+	{
+	    cal->button = (js_button_struct **)calloc(
+		jsd->total_buttons, sizeof(js_button_struct *)
+	    );
+	    if(cal->button != NULL)
+		cal->total_buttons = jsd->total_buttons;
+	}
+
+	if(pthread_mutex_init(&cl->mutex, NULL))
+	{
+	    JSClose(cal);
+	    free(cl);
+	    return(NULL);
+	}
+
+	if(pthread_create(&cl->thread, NULL, JSCalibLoaderThread, cl))
+	{
+	    pthread_mutex_destroy(&cl->mutex);
+	    JSClose(cal);
+	    free(cl);
+	    return(NULL);
+	}
+
+	return(cl);
+}
+
+/*
+ *	Checks if the calibration has been loaded and if it has then
+ *	applies it to the opened joystick specified by jsd.
+ *
+ *	If block is true then this function waits for the calibration
+ *	to be loaded.
+ *
+ *	Returns 1 if the calibration was applied, in which case the
+ *	loader should be deleted, or 0 if it is still being loaded.
+ */
+int JSCalibLoaderPoll(void *ptr, js_data_struct *jsd, int block)
+{
+	int done;
+	js_calib_loader_struct *cl = (js_calib_loader_struct *)ptr;
+	if((cl == NULL) || (jsd == NULL))
+	    return(0);
+
+	if(!block)
+	{
+	    pthread_mutex_lock(&cl->mutex);
+	    done = cl->done;
+	    pthread_mutex_unlock(&cl->mutex);
+	    if(!done)
+		return(0);
+	}
+
+	pthread_join(cl->thread, NULL);
+	cl->joined = 1;
+
+	JSCalibLoaderApply(cl, jsd);
+
+	return(1);
+}
+
+/*
+ *	Deletes the calibration loader, waiting for the worker thread
+ *	to finish if the calibration is still being loaded.
+ */
+void JSCalibLoaderDelete(void *ptr)
+{
+	js_calib_loader_struct *cl = (js_calib_loader_struct *)ptr;
+	if(cl == NULL)
+	    return;
+
+	if(!cl->joined)
+	    pthread_join(cl->thread, NULL);
+
+	pthread_mutex_destroy(&cl->mutex);
+	JSClose(&cl->jsd);
+	free(cl);
+}
@@ -0,0 +1,13 @@
+#ifndef CALIBLOADER_H
+#define CALIBLOADER_H
+
+#include <sys/types.h>
+#include "../include/jsw.h"
+
+
+extern void *JSCalibLoaderNew(js_data_struct *jsd);
+extern int JSCalibLoaderPoll(void *ptr, js_data_struct *jsd, int block);
+extern void JSCalibLoaderDelete(void *ptr);
+
+
+#endif	/* CALIBLOADER_H */
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include <pthread.h>
 
 #include "../include/cfgfmt.h"
 #include "../include/string.h"
@@ -10,9 +11,21 @@
 
 #include "../include/jsw.h"
 
+#include "identity.h"
+#include "calibindex.h"
+#include "arena.h"
+#include "calibrationfio.h"
+#include "probes.h"
+#include "private.h"
+
 
 void JSResetAllAxisTolorance(js_data_struct *jsd);
+static int JSDoLoadCalibrationUNIX(js_data_struct *jsd, FILE *cal_fp);
 int JSLoadCalibrationUNIX(js_data_struct *jsd);
+int JSLoadCalibrationManyUNIX(js_data_struct **jsd, int total);
+static char **JSDoLoadDeviceNamesUNIX(
+	int *total, const char *calibration
+);
 char **JSLoadDeviceNamesUNIX(
 	int *total, const char *calibration
 );
@@ -30,6 +43,14 @@ char **JSLoadDeviceNamesUNIX(
 #define STRISEMPTY(s)   (((s) != NULL) ? (*(s) == '\0') : 1)
 
 
+/*
+ *	Calibration file parsing lock, the configuration string parsing
+ *	functions and the calibration file index are not reentrant and
+ *	calibration may be loaded on worker threads by JSInitAsync().
+ */
+static pthread_mutex_t	js_calibration_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
 /*
  *      Loads the calibration data from the calibration file specifeid
  *      on the given jsd structure. First an entry for the device
@@ -37,15 +58,26 @@ char **JSLoadDeviceNamesUNIX(
  *      file if (and only if) it is found then the axis and button
  *      values for that device will be loaded.
  *
+ *	The entry is looked up by the identity on the jsd first and
+ *	then by its device name, only the entry itself is read from
+ *	the calibration file. If there is more than one entry for the
+ *	device then each of them is read in the order that they appear
+ *	in the calibration file.
+ *
  *      Additional axises and buttons may be allocated on the given
  *      jsd structure by this function if they are found to be defined
  *      for the device in question in the calibration file.
+ *
+ *	If cal_fp is not NULL then it is the calibration file already
+ *	opened by the calling function, it will not be closed.
  */
-int JSLoadCalibrationUNIX(js_data_struct *jsd)
+static int JSDoLoadCalibrationUNIX(js_data_struct *jsd, FILE *cal_fp)
 {
 	char is_this_device = 0;
 	const char *this_device_name;
 	char *line_buf;
+	int total_offsets, offset_num;
+	long *offset;
   
 	FILE *fp;
   
@@ -70,10 +102,31 @@ int JSLoadCalibrationUNIX(js_data_struct *jsd)
 	if(STRISEMPTY(jsd->calibration_file))
 	    return(-1);
 
-	/* Open the calibration file */
-	fp = FOpen(jsd->calibration_file, "rb");
+	/* Find the entries for this device in the calibration file */
+	offset = JSCalibIndexFind(
+	    jsd->calibration_file,
+	    this_device_name,
+	    &jsd->identity,
+	    &total_offsets
+	);
+	if(offset == NULL)
+	    return(-1);
+
+	/* Open the calibration file and go to the first entry */
+	fp = (cal_fp != NULL) ? cal_fp : FOpen(jsd->calibration_file, "rb");
 	if(fp == NULL)
+	{
+	    free(offset);
+	    return(-1);
+	}
+	offset_num = 0;
+	if(fseek(fp, offset[offset_num], SEEK_SET))
+	{
+	    if(fp != cal_fp)
+		FClose(fp);
+	    free(offset);
 	    return(-1);
+	}
 
 /* Reads the next line from fp, first deleting line_buf and then
  * allocating the new line to line_buf, lines_read will be incremented
@@ -113,15 +166,12 @@ int JSLoadCalibrationUNIX(js_data_struct *jsd)
 	    /* Start of joystick device block? */
 	    if(!strcasecmp(parm, "BeginJoystick"))
 	    {
-		/* Joystick device name must match the value for
-		 * the BeginJoystick parameter, this is so that we
-		 * know that this is a configuration block for
-		 * this device (jsd->device_name)
+		/* The calibration file was positioned at the
+		 * configuration block for this device, which may have
+		 * been saved under a different device name if it was
+		 * found by the identity
 		 */
-		if(strcmp(val, this_device_name))
-		    is_this_device = 0;
-		else
-		    is_this_device = 1;
+		is_this_device = 1;
 
 		/* Enter loop to read and handle each line for this
 		 * configuration block
@@ -143,6 +193,17 @@ int JSLoadCalibrationUNIX(js_data_struct *jsd)
 			{
 			    axis_ptr = jsd->axis[axis_num];
 			}
+			else if((axis_num < jsd->total_axises) &&
+				(axis_num >= 0)
+			)
+			{
+			    /* Skipped by an earlier block for this
+			     * device
+			     */
+			    jsd->axis[axis_num] = axis_ptr = (js_axis_struct *)JSPrivateAlloc(
+				jsd, sizeof(js_axis_struct)
+			    );
+			}
 			else if((axis_num >= jsd->total_axises) &&
 				(axis_num >= 0)
 			)
@@ -164,8 +225,8 @@ int JSLoadCalibrationUNIX(js_data_struct *jsd)
 			    {
 				for(i = p; i < jsd->total_axises; i++)
 				    jsd->axis[i] = NULL;
-				jsd->axis[axis_num] = axis_ptr = (js_axis_struct *)calloc(
-				    1, sizeof(js_axis_struct)
+				jsd->axis[axis_num] = axis_ptr = (js_axis_struct *)JSPrivateAlloc(
+				    jsd, sizeof(js_axis_struct)
 				);
 			    }
 			}
@@ -310,6 +371,17 @@ int JSLoadCalibrationUNIX(js_data_struct *jsd)
 			{
 			    button_ptr = jsd->button[button_num];
 			}
+			else if((button_num < jsd->total_buttons) &&
+				(button_num >= 0)
+			)
+			{
+			    /* Skipped by an earlier block for this
+			     * device
+			     */
+			    jsd->button[button_num] = button_ptr = (js_button_struct *)JSPrivateAlloc(
+				jsd, sizeof(js_button_struct)
+			    );
+			}
 			else if((button_num >= jsd->total_buttons) &&
 				(button_num >= 0)
 			)
@@ -331,8 +403,8 @@ int JSLoadCalibrationUNIX(js_data_struct *jsd)
 			    {
 				for(i = p; i < jsd->total_buttons; i++)
 				    jsd->button[i] = NULL;
-				jsd->button[button_num] = button_ptr = (js_button_struct *)calloc(
-				    1, sizeof(js_button_struct)
+				jsd->button[button_num] = button_ptr = (js_button_struct *)JSPrivateAlloc(
+				    jsd, sizeof(js_button_struct)
 				);
 			    }
 			}
@@ -373,10 +445,44 @@ int JSLoadCalibrationUNIX(js_data_struct *jsd)
 		    {
 			jsd->last_calibrated = MAX(ATOL(val), 0l);
 		    }
+		    /* Identity, used only if the jsd does not have an
+		     * identity (ie the device is not opened)
+		     */
+		    else if(!strcasecmp(parm, "IdentityName") &&
+			    is_this_device
+		    )
+		    {
+			if(jsd->identity.name == NULL)
+			    jsd->identity.name = STRDUP(val);
+		    }
+		    else if(!strcasecmp(parm, "IdentityVendor") &&
+			    is_this_device
+		    )
+		    {
+			if(jsd->identity.vendor == 0)
+			    jsd->identity.vendor = (unsigned int)strtoul(
+				val, NULL, 16
+			    );
+		    }
+		    else if(!strcasecmp(parm, "IdentityProduct") &&
+			    is_this_device
+		    )
+		    {
+			if(jsd->identity.product == 0)
+			    jsd->identity.product = (unsigned int)strtoul(
+				val, NULL, 16
+			    );
+		    }
+		    else if(!strcasecmp(parm, "IdentityPhys") &&
+			    is_this_device
+		    )
+		    {
+			if(jsd->identity.phys == NULL)
+			    jsd->identity.phys = STRDUP(val);
+		    }
 		    /* EndJoystick */
 		    else if(!strcasecmp(parm, "EndJoystick"))
 		    {
-			is_this_device = 0;
 			break;
 		    }
 		    /* Other parameter? */
@@ -385,6 +491,15 @@ int JSLoadCalibrationUNIX(js_data_struct *jsd)
 			/* Other parameter, ignore */
 		    }
 		}	/* Read device block loop */
+
+		/* Done reading the block for this device, go to the
+		 * next block for this device
+		 */
+		offset_num++;
+		if((offset_num >= total_offsets) ||
+		   fseek(fp, offset[offset_num], SEEK_SET)
+		)
+		    break;
 	    }
 	    /* Other parameter? */
 	    else
@@ -397,13 +512,89 @@ int JSLoadCalibrationUNIX(js_data_struct *jsd)
 
 	/* Delete line buffer */
 	free(line_buf);
+	free(offset);
 
 	/* Close calibration file */
-	FClose(fp);
+	if(fp != cal_fp)
+	    FClose(fp);
 
 	return(0);
 }
 
+/*
+ *	Locks calibration file parsing and loads the calibration, see
+ *	JSDoLoadCalibrationUNIX().
+ */
+int JSLoadCalibrationUNIX(js_data_struct *jsd)
+{
+	int status;
+
+	JS_PROBE2(
+	    calibration_start, jsd,
+	    (jsd != NULL) ? jsd->calibration_file : NULL
+	);
+	pthread_mutex_lock(&js_calibration_mutex);
+	status = JSDoLoadCalibrationUNIX(jsd, NULL);
+	pthread_mutex_unlock(&js_calibration_mutex);
+	JS_PROBE2(calibration_done, jsd, status);
+
+	return(status);
+}
+
+/*
+ *	Loads the calibration for each jsd in the list, the NULL
+ *	entries are skipped.
+ *
+ *	The calibration file is indexed and opened only once for all
+ *	the jsds that have the same calibration file as the first jsd,
+ *	the others are loaded as with JSLoadCalibrationUNIX().
+ *
+ *	Returns the number of jsds that had an entry in the
+ *	calibration file.
+ */
+int JSLoadCalibrationManyUNIX(js_data_struct **jsd, int total)
+{
+	int i, status, loaded = 0;
+	const char *calibration = NULL;
+	FILE *fp = NULL;
+	js_data_struct *jsd_ptr;
+
+	if((jsd == NULL) || (total <= 0))
+	    return(0);
+
+	pthread_mutex_lock(&js_calibration_mutex);
+
+	for(i = 0; i < total; i++)
+	{
+	    jsd_ptr = jsd[i];
+	    if((jsd_ptr == NULL) || STRISEMPTY(jsd_ptr->calibration_file))
+		continue;
+
+	    /* Open the calibration file of the first jsd */
+	    if(calibration == NULL)
+	    {
+		calibration = jsd_ptr->calibration_file;
+		fp = FOpen(calibration, "rb");
+	    }
+
+	    JS_PROBE2(calibration_start, jsd_ptr, jsd_ptr->calibration_file);
+	    status = JSDoLoadCalibrationUNIX(
+		jsd_ptr,
+		!strcmp(jsd_ptr->calibration_file, calibration) ? fp : NULL
+	    );
+	    JS_PROBE2(calibration_done, jsd_ptr, status);
+	    if(!status)
+		loaded++;
+	}
+
+	if(fp != NULL)
+	    FClose(fp);
+
+	pthread_mutex_unlock(&js_calibration_mutex);
+
+	return(loaded);
+}
+
 /*
  *	Gets a list of calibrated devices found in the specified
  *	calibration file.
@@ -411,7 +602,7 @@ int JSLoadCalibrationUNIX(js_data_struct *jsd)
  *	The returned list of strings and the pointer array must be
  *	deallocated by the calling function.
  */
-char **JSLoadDeviceNamesUNIX(
+static char **JSDoLoadDeviceNamesUNIX(
 	int *total, const char *calibration
 )
 {
@@ -520,3 +711,20 @@ char **JSLoadDeviceNamesUNIX(
 
 	return(strv);
 }
+
+/*
+ *	Locks calibration file parsing and gets the list of calibrated
+ *	devices, see JSDoLoadDeviceNamesUNIX().
+ */
+char **JSLoadDeviceNamesUNIX(
+	int *total, const char *calibration
+)
+{
+	char **strv;
+
+	pthread_mutex_lock(&js_calibration_mutex);
+	strv = JSDoLoadDeviceNamesUNIX(total, calibration);
+	pthread_mutex_unlock(&js_calibration_mutex);
+
+	return(strv);
+}
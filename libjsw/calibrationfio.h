@@ -0,0 +1,11 @@
+#ifndef CALIBRATIONFIO_H
+#define CALIBRATIONFIO_H
+
+#include <sys/types.h>
+#include "../include/jsw.h"
+
+
+extern int JSLoadCalibrationManyUNIX(js_data_struct **jsd, int total);
+
+
+#endif	/* CALIBRATIONFIO_H */
@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+
+#include "../include/jsw.h"
+
+#include "synthetic.h"
+#include "record.h"
+#include "device.h"
+
+
+/*
+ *	Device Backend:
+ *
+ *	A device name that starts with the backend's prefix is opened
+ *	by the backend instead of as a device node. The backend returns
+ *	a descriptor that JSUpdate() reads struct js_event from and
+ *	answers the driver's ioctl() requests itself.
+ */
+typedef struct {
+
+	const char	*prefix;
+	void		*(*open_func)(const char *args, int *fd);
+	int		(*ioctl_func)(void *ptr, unsigned long request, void *arg);
+	void		(*close_func)(void *ptr);
+
+} js_device_backend_struct;
+
+static const js_device_backend_struct js_device_backend[] = {
+#if defined(__linux__)
+	{	JSSyntheticDevicePrefix,
+		JSSyntheticNew,
+		JSSyntheticIoctl,
+		JSSyntheticDelete
+	},
+	{	JSReplayDevicePrefix,
+		JSReplayNew,
+		JSReplayIoctl,
+		JSReplayDelete
+	},
+#endif
+	{	NULL, NULL, NULL, NULL	}
+};
+
+/*
+ *	Opened Device:
+ */
+typedef struct {
+
+	const js_device_backend_struct	*backend;
+	void		*data;
+
+} js_device_struct;
+#define JS_DEVICE(p)		((js_device_struct *)(p))
+
+
+int JSDeviceIsBackend(const char *device_name);
+int JSDeviceOpen(const char *device_name, void **device);
+int JSDeviceIoctl(
+	int fd, void *device,
+	unsigned long request, void *arg
+);
+void JSDeviceClose(int fd, void *device);
+
+
+/*
+ *	Checks if the device is opened by a backend instead of being a
+ *	device node.
+ */
+int JSDeviceIsBackend(const char *device_name)
+{
+	const js_device_backend_struct *b;
+
+	if(device_name == NULL)
+	    return(0);
+
+	for(b = js_device_backend; b->prefix != NULL; b++)
+	{
+	    if(!strncmp(device_name, b->prefix, strlen(b->prefix)))
+		return(1);
+	}
+
+	return(0);
+}
+
+/*
+ *	Opens the device read-only, returns the descriptor or -1 on
+ *	error.
+ *
+ *	If the device is opened by a backend then *device is set to the
+ *	opened device, which must be passed to JSDeviceIoctl() and
+ *	JSDeviceClose(), otherwise it is set to NULL.
+ */
+int JSDeviceOpen(const char *device_name, void **device)
+{
+	int fd;
+	const js_device_backend_struct *b;
+	js_device_struct *d;
+
+	*device = NULL;
+	if(device_name == NULL)
+	    return(-1);
+
+	for(b = js_device_backend; b->prefix != NULL; b++)
+	{
+	    if(strncmp(device_name, b->prefix, strlen(b->prefix)))
+		continue;
+
+	    d = (js_device_struct *)malloc(sizeof(js_device_struct));
+	    if(d == NULL)
+		return(-1);
+
+	    d->backend = b;
+	    d->data = b->open_func(device_name + strlen(b->prefix), &fd);
+	    if(d->data == NULL)
+	    {
+		free(d);
+		return(-1);
+	    }
+
+	    *device = d;
+	    return(fd);
+	}
+
+	return(open(device_name, O_RDONLY));
+}
+
+/*
+ *	Same as ioctl() on the device's descriptor.
+ */
+int JSDeviceIoctl(
+	int fd, void *device,
+	unsigned long request, void *arg
+)
+{
+	js_device_struct *d = JS_DEVICE(device);
+	if(d != NULL)
+	    return(d->backend->ioctl_func(d->data, request, arg));
+	else
+	    return(ioctl(fd, request, arg));
+}
+
+/*
+ *	Closes the device's descriptor and the device.
+ */
+void JSDeviceClose(int fd, void *device)
+{
+	js_device_struct *d = JS_DEVICE(device);
+
+	/* Close the descriptor first so that the backend sees the
+	 * device as closed
+	 */
+	if(fd > -1)
+	    close(fd);
+
+	if(d != NULL)
+	{
+	    d->backend->close_func(d->data);
+	    free(d);
+	}
+}
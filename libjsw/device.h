@@ -0,0 +1,17 @@
+#ifndef DEVICE_H
+#define DEVICE_H
+
+#include <sys/types.h>
+#include "../include/jsw.h"
+
+
+extern int JSDeviceIsBackend(const char *device_name);
+extern int JSDeviceOpen(const char *device_name, void **device);
+extern int JSDeviceIoctl(
+	int fd, void *device,
+	unsigned long request, void *arg
+);
+extern void JSDeviceClose(int fd, void *device);
+
+
+#endif	/* DEVICE_H */
@@ -0,0 +1,374 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "../include/jsw.h"
+
+#include "eventcallback.h"
+#include "private.h"
+
+
+/*
+ *	Number of entries in each dispatch table, this covers every
+ *	axis and button number that the driver can report.
+ */
+#define JS_EVENT_CALLBACK_NUMBERS	256
+
+
+/*
+ *	Event Callback:
+ */
+typedef struct {
+
+	js_event_func	func;		/* NULL if removed */
+	void		*data;
+	unsigned int	event_mask;	/* Any of JSEvent* */
+	int		number;		/* Axis or button number or -1
+					 * for all of them */
+
+} js_event_callback_struct;
+
+/*
+ *	Event Callbacks:
+ *
+ *	Allocated on a jsd when its first callback is added.
+ *
+ *	The dispatch tables are indexed by the axis or button number,
+ *	each entry is a NULL terminated list of the callbacks for that
+ *	number or NULL if there are none. The tables are rebuilt when
+ *	callbacks are added or removed so that dispatching an event is
+ *	a single lookup.
+ */
+typedef struct {
+
+	js_event_callback_struct	**callback;
+	int		total_callbacks;
+
+	js_event_callback_struct	**axis[JS_EVENT_CALLBACK_NUMBERS],
+					**button[JS_EVENT_CALLBACK_NUMBERS];
+	js_event_callback_struct	**table;	/* Storage for the
+							 * lists */
+
+	int		dispatching,	/* Callbacks are being called */
+			changed;	/* Tables need to be rebuilt */
+
+} js_event_callbacks_struct;
+
+
+static int JSEventCallbackMatches(
+	const js_event_callback_struct *cb,
+	unsigned int type_mask, int number
+);
+static int JSEventCallbackRebuild(js_event_callbacks_struct *ec);
+
+void JSEventCallbackDispatch(
+	js_data_struct *jsd, int event, int number
+);
+void JSEventCallbackDelete(void *ptr);
+
+int JSAddEventCallback(
+	js_data_struct *jsd,
+	unsigned int event_mask, int number,
+	js_event_func func, void *data
+);
+void JSRemoveEventCallback(
+	js_data_struct *jsd,
+	js_event_func func, void *data
+);
+
+
+/*
+ *	Checks if the callback is for the axis or button number for any
+ *	of the event types in type_mask.
+ */
+static int JSEventCallbackMatches(
+	const js_event_callback_struct *cb,
+	unsigned int type_mask, int number
+)
+{
+	if(cb->func == NULL)
+	    return(0);
+
+	if(!(cb->event_mask & type_mask))
+	    return(0);
+
+	return((cb->number < 0) || (cb->number == number));
+}
+
+/*
+ *	Deletes the removed callbacks and rebuilds the dispatch tables.
+ *
+ *	Returns non-zero on error, in which case the tables are left
+ *	empty.
+ */
+static int JSEventCallbackRebuild(js_event_callbacks_struct *ec)
+{
+	int i, n, total_entries;
+	int total_axis[JS_EVENT_CALLBACK_NUMBERS],
+	    total_button[JS_EVENT_CALLBACK_NUMBERS];
+	js_event_callback_struct *cb, ***list, **entry;
+
+	ec->changed = 0;
+
+	/* Delete the removed callbacks */
+	for(i = 0, n = 0; i < ec->total_callbacks; i++)
+	{
+	    cb = ec->callback[i];
+	    if(cb->func == NULL)
+		free(cb);
+	    else
+		ec->callback[n++] = cb;
+	}
+	ec->total_callbacks = n;
+
+	free(ec->table);
+	ec->table = NULL;
+	memset(ec->axis, 0x00, sizeof(ec->axis));
+	memset(ec->button, 0x00, sizeof(ec->button));
+
+	/* Count the callbacks for each number */
+	total_entries = 0;
+	for(n = 0; n < JS_EVENT_CALLBACK_NUMBERS; n++)
+	{
+	    total_axis[n] = total_button[n] = 0;
+	    for(i = 0; i < ec->total_callbacks; i++)
+	    {
+		cb = ec->callback[i];
+		if(JSEventCallbackMatches(cb, JSEventAxis, n))
+		    total_axis[n]++;
+		if(JSEventCallbackMatches(cb, JSEventButton, n))
+		    total_button[n]++;
+	    }
+	    if(total_axis[n] > 0)
+		total_entries += total_axis[n] + 1;
+	    if(total_button[n] > 0)
+		total_entries += total_button[n] + 1;
+	}
+	if(total_entries == 0)
+	    return(0);
+
+	ec->table = (js_event_callback_struct **)malloc(
+	    total_entries * sizeof(js_event_callback_struct *)
+	);
+	if(ec->table == NULL)
+	    return(-1);
+
+	/* Set up each number's list in the storage and fill it in
+	 * the order that the callbacks were added
+	 */
+	entry = ec->table;
+	for(n = 0; n < JS_EVENT_CALLBACK_NUMBERS; n++)
+	{
+	    if(total_axis[n] > 0)
+	    {
+		list = &ec->axis[n];
+		*list = entry;
+		for(i = 0; i < ec->total_callbacks; i++)
+		{
+		    cb = ec->callback[i];
+		    if(JSEventCallbackMatches(cb, JSEventAxis, n))
+			*entry++ = cb;
+		}
+		*entry++ = NULL;
+	    }
+	    if(total_button[n] > 0)
+	    {
+		list = &ec->button[n];
+		*list = entry;
+		for(i = 0; i < ec->total_callbacks; i++)
+		{
+		    cb = ec->callback[i];
+		    if(JSEventCallbackMatches(cb, JSEventButton, n))
+			*entry++ = cb;
+		}
+		*entry++ = NULL;
+	    }
+	}
+
+	return(0);
+}
+
+
+/*
+ *	Called by JSUpdate() when the axis or button number on the jsd
+ *	has changed, the event is one of JSEvent*.
+ *
+ *	Calls the callbacks for the axis or button number that want
+ *	the event.
+ */
+void JSEventCallbackDispatch(
+	js_data_struct *jsd, int event, int number
+)
+{
+	js_event_callbacks_struct *ec = (js_event_callbacks_struct *)(
+	    (jsd != NULL) ? JS_PRIVATE(jsd)->event_callback : NULL
+	);
+	js_event_callback_struct *cb, **list;
+
+	if((ec == NULL) || (number < 0) ||
+	   (number >= JS_EVENT_CALLBACK_NUMBERS)
+	)
+	    return;
+
+	list = (event & JSEventAxis) ? ec->axis[number] :
+	    ec->button[number];
+	if(list == NULL)
+	    return;
+
+	/* Callbacks added or removed by the callbacks take effect
+	 * after all of them have been called, stop early if one of
+	 * them closed the joystick
+	 */
+	ec->dispatching++;
+	for(; *list != NULL; list++)
+	{
+	    if(JS_PRIVATE(jsd)->close_pending)
+		break;
+
+	    cb = *list;
+	    if((cb->func != NULL) && (cb->event_mask & event))
+		cb->func(jsd, event, number, cb->data);
+	}
+	ec->dispatching--;
+
+	if((ec->dispatching == 0) && ec->changed)
+	    JSEventCallbackRebuild(ec);
+}
+
+/*
+ *	Deletes the Event Callbacks.
+ */
+void JSEventCallbackDelete(void *ptr)
+{
+	int i;
+	js_event_callbacks_struct *ec = (js_event_callbacks_struct *)ptr;
+
+	if(ec == NULL)
+	    return;
+
+	for(i = 0; i < ec->total_callbacks; i++)
+	    free(ec->callback[i]);
+	free(ec->callback);
+	free(ec->table);
+	free(ec);
+}
+
+
+/*
+ *	Adds a callback to be called by JSUpdate() when an axis or
+ *	button on the jsd changes.
+ *
+ *	The event_mask specifies which events to call the callback for,
+ *	any of JSEvent*. The number specifies the axis or button number
+ *	or -1 for all axises and buttons.
+ */
+int JSAddEventCallback(
+	js_data_struct *jsd,
+	unsigned int event_mask, int number,
+	js_event_func func, void *data
+)
+{
+	js_event_callbacks_struct *ec;
+	js_event_callback_struct *cb, **callback;
+	js_private_struct *priv;
+
+	if((jsd == NULL) || (func == NULL) ||
+	   !(event_mask & JSEventAll) ||
+	   (number < -1) || (number >= JS_EVENT_CALLBACK_NUMBERS)
+	)
+	    return(JSBadValue);
+
+	priv = JSPrivateGet(jsd);
+	if(priv == NULL)
+	    return(JSNoBuffers);
+
+	ec = (js_event_callbacks_struct *)priv->event_callback;
+	if(ec == NULL)
+	{
+	    priv->event_callback = ec = (js_event_callbacks_struct *)calloc(
+		1, sizeof(js_event_callbacks_struct)
+	    );
+	    if(ec == NULL)
+		return(JSNoBuffers);
+	}
+
+	cb = (js_event_callback_struct *)malloc(
+	    sizeof(js_event_callback_struct)
+	);
+	if(cb == NULL)
+	    return(JSNoBuffers);
+	cb->func = func;
+	cb->data = data;
+	cb->event_mask = event_mask & JSEventAll;
+	cb->number = number;
+
+	callback = (js_event_callback_struct **)realloc(
+	    ec->callback,
+	    (ec->total_callbacks + 1) * sizeof(js_event_callback_struct *)
+	);
+	if(callback == NULL)
+	{
+	    free(cb);
+	    return(JSNoBuffers);
+	}
+	ec->callback = callback;
+	ec->callback[ec->total_callbacks] = cb;
+	ec->total_callbacks++;
+
+	/* Rebuild the tables now unless the callbacks are being
+	 * called
+	 */
+	ec->changed = 1;
+	if(ec->dispatching == 0)
+	{
+	    if(JSEventCallbackRebuild(ec))
+	    {
+		/* Remove the callback that was just added and try to
+		 * restore the tables for the rest
+		 */
+		cb->func = NULL;
+		JSEventCallbackRebuild(ec);
+		return(JSNoBuffers);
+	    }
+	}
+
+	return(JSSuccess);
+}
+
+/*
+ *	Removes all the callbacks with the same func and data added by
+ *	JSAddEventCallback().
+ */
+void JSRemoveEventCallback(
+	js_data_struct *jsd,
+	js_event_func func, void *data
+)
+{
+	int i;
+	js_event_callbacks_struct *ec;
+	js_event_callback_struct *cb;
+
+	if(jsd == NULL)
+	    return;
+
+	ec = (js_event_callbacks_struct *)JS_PRIVATE(jsd)->event_callback;
+	if(ec == NULL)
+	    return;
+
+	/* Mark the callbacks as removed, they are deleted when the
+	 * tables are rebuilt
+	 */
+	for(i = 0; i < ec->total_callbacks; i++)
+	{
+	    cb = ec->callback[i];
+	    if((cb->func == func) && (cb->data == data))
+	    {
+		cb->func = NULL;
+		ec->changed = 1;
+	    }
+	}
+
+	if((ec->dispatching == 0) && ec->changed)
+	    JSEventCallbackRebuild(ec);
+}
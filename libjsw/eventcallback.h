@@ -0,0 +1,14 @@
+#ifndef EVENTCALLBACK_H
+#define EVENTCALLBACK_H
+
+#include <sys/types.h>
+#include "../include/jsw.h"
+
+
+extern void JSEventCallbackDispatch(
+	js_data_struct *jsd, int event, int number
+);
+extern void JSEventCallbackDelete(void *ptr);
+
+
+#endif	/* EVENTCALLBACK_H */
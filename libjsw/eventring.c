@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "../include/jsw.h"
+
+#include "eventring.h"
+#include "private.h"
+
+
+/*
+ *	Number of events in each event ring, must be a power of 2:
+ */
+#define JS_EVENT_RING_SIZE	256
+
+
+/*
+ *	Event Ring Slot:
+ *
+ *	The sequence is the ring position of the event plus 1 or 0
+ *	while the slot is being written, a reader that sees a different
+ *	sequence before and after copying the event has been overrun.
+ */
+typedef struct {
+
+	unsigned long	sequence;
+	int		type,
+			number,
+			value;
+	time_t		time;
+
+} js_event_ring_slot_struct;
+
+/*
+ *	Event Ring:
+ *
+ *	Allocated on a jsd by the first call to JSEventReaderInit(),
+ *	JSUpdate() is the only writer.
+ */
+typedef struct {
+
+	unsigned long	head;		/* Position of the next event */
+	js_event_ring_slot_struct	slot[JS_EVENT_RING_SIZE];
+
+} js_event_ring_struct;
+
+
+void JSEventRingPush(void *ptr, const js_event_struct *event);
+void JSEventRingDelete(void *ptr);
+
+int JSEventReaderInit(
+	js_data_struct *jsd, js_event_reader_struct *reader
+);
+int JSEventReaderRead(
+	js_event_reader_struct *reader,
+	js_event_struct *event, int total
+);
+
+
+#define JS_LOAD(p,o)		__atomic_load_n((p), (o))
+#define JS_STORE(p,v,o)		__atomic_store_n((p), (v), (o))
+
+
+/*
+ *	Called by JSUpdate() to add the event to the event ring,
+ *	overwriting the oldest event.
+ */
+void JSEventRingPush(void *ptr, const js_event_struct *event)
+{
+	unsigned long head;
+	js_event_ring_slot_struct *slot;
+	js_event_ring_struct *ring = (js_event_ring_struct *)ptr;
+	if(ring == NULL)
+	    return;
+
+	head = ring->head;
+	slot = &ring->slot[head & (JS_EVENT_RING_SIZE - 1)];
+
+	/* Mark the slot as being written before changing it */
+	JS_STORE(&slot->sequence, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	JS_STORE(&slot->type, event->type, __ATOMIC_RELAXED);
+	JS_STORE(&slot->number, event->number, __ATOMIC_RELAXED);
+	JS_STORE(&slot->value, event->value, __ATOMIC_RELAXED);
+	JS_STORE(&slot->time, event->time, __ATOMIC_RELAXED);
+
+	JS_STORE(&slot->sequence, head + 1, __ATOMIC_RELEASE);
+	JS_STORE(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ *	Deletes the event ring.
+ */
+void JSEventRingDelete(void *ptr)
+{
+	free(ptr);
+}
+
+
+/*
+ *	Sets up the reader to read the events added to the jsd's event
+ *	ring from now on, the event ring is allocated on the first
+ *	call.
+ *
+ *	This must be called from the thread that calls JSUpdate(),
+ *	the reader can then be read from any thread until the jsd is
+ *	closed.
+ */
+int JSEventReaderInit(
+	js_data_struct *jsd, js_event_reader_struct *reader
+)
+{
+	js_event_ring_struct *ring;
+	js_private_struct *priv;
+
+	if((jsd == NULL) || (reader == NULL))
+	    return(JSBadValue);
+
+	priv = JSPrivateGet(jsd);
+	if(priv == NULL)
+	    return(JSNoBuffers);
+
+	ring = (js_event_ring_struct *)priv->event_ring;
+	if(ring == NULL)
+	{
+	    priv->event_ring = ring = (js_event_ring_struct *)calloc(
+		1, sizeof(js_event_ring_struct)
+	    );
+	    if(ring == NULL)
+		return(JSNoBuffers);
+	}
+
+	reader->ring = ring;
+	reader->position = JS_LOAD(&ring->head, __ATOMIC_ACQUIRE);
+	reader->overruns = 0;
+
+	return(JSSuccess);
+}
+
+/*
+ *	Reads up to total events from the reader's position into the
+ *	array event.
+ *
+ *	If events were overwritten before they were read then the
+ *	number of lost events is added to the reader's overruns and
+ *	reading continues from the oldest event.
+ *
+ *	Returns the number of events read.
+ */
+int JSEventReaderRead(
+	js_event_reader_struct *reader,
+	js_event_struct *event, int total
+)
+{
+	int n = 0;
+	unsigned long head, sequence;
+	js_event_ring_slot_struct *slot;
+	js_event_struct *ev;
+	js_event_ring_struct *ring;
+
+	if((reader == NULL) || (event == NULL))
+	    return(0);
+
+	ring = (js_event_ring_struct *)reader->ring;
+	if(ring == NULL)
+	    return(0);
+
+	head = JS_LOAD(&ring->head, __ATOMIC_ACQUIRE);
+	while(n < total)
+	{
+	    /* Overrun? Skip to the oldest event still in the ring */
+	    if((head - reader->position) > JS_EVENT_RING_SIZE)
+	    {
+		reader->overruns += head - JS_EVENT_RING_SIZE -
+		    reader->position;
+		reader->position = head - JS_EVENT_RING_SIZE;
+	    }
+
+	    /* No more events? */
+	    if(reader->position == head)
+		break;
+
+	    slot = &ring->slot[reader->position & (JS_EVENT_RING_SIZE - 1)];
+	    ev = &event[n];
+
+	    sequence = JS_LOAD(&slot->sequence, __ATOMIC_ACQUIRE);
+	    ev->type = JS_LOAD(&slot->type, __ATOMIC_RELAXED);
+	    ev->number = JS_LOAD(&slot->number, __ATOMIC_RELAXED);
+	    ev->value = JS_LOAD(&slot->value, __ATOMIC_RELAXED);
+	    ev->time = JS_LOAD(&slot->time, __ATOMIC_RELAXED);
+	    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	    /* The slot was overwritten while it was being read? Then
+	     * the writer is a whole ring ahead and this event is lost
+	     */
+	    if((sequence != (reader->position + 1)) ||
+	       (JS_LOAD(&slot->sequence, __ATOMIC_RELAXED) != sequence)
+	    )
+	    {
+		reader->overruns++;
+		reader->position++;
+		head = JS_LOAD(&ring->head, __ATOMIC_ACQUIRE);
+		continue;
+	    }
+
+	    reader->position++;
+	    n++;
+	}
+
+	return(n);
+}
@@ -0,0 +1,12 @@
+#ifndef EVENTRING_H
+#define EVENTRING_H
+
+#include <sys/types.h>
+#include "../include/jsw.h"
+
+
+extern void JSEventRingPush(void *ptr, const js_event_struct *event);
+extern void JSEventRingDelete(void *ptr);
+
+
+#endif	/* EVENTRING_H */
@@ -0,0 +1,1028 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#if defined(__linux__)
+# include <sys/inotify.h>
+#endif
+
+#include "../include/jsw.h"
+
+#include "identity.h"
+#include "hotplug.h"
+#include "utils.h"
+
+
+/*
+ *	Hotplug Callback:
+ */
+typedef struct {
+
+	js_hotplug_func	func;
+	void		*data;
+
+} js_hotplug_callback_struct;
+
+/*
+ *	Known Joystick Device:
+ *
+ *	Records the identity of each joystick device node seen by the
+ *	hotplug monitor so that it can be reported when the device
+ *	node is removed.
+ */
+typedef struct {
+
+	char		*device_name;
+	js_identity_struct	identity;
+
+} js_hotplug_device_struct;
+
+/*
+ *	Device Node Watch:
+ *
+ *	Watches the device directories with inotify.
+ */
+typedef struct {
+
+	int		fd;		/* inotify descriptor or -1 */
+	int		dev_wd,		/* Watch on "/dev" */
+			input_wd;	/* Watch on "/dev/input" */
+
+} js_hotplug_watch_struct;
+
+/*
+ *	Hotplug Monitor:
+ *
+ *	There is one hotplug monitor per process, it watches the
+ *	device directories while there are callbacks registered.
+ */
+typedef struct {
+
+	pthread_mutex_t	mutex;
+
+	js_hotplug_watch_struct	watch;
+
+	js_hotplug_callback_struct	*callback;
+	int		total_callbacks;
+
+	js_hotplug_device_struct	*device;
+	int		total_devices;
+
+	/* Incremented each time a joystick device node is added or
+	 * changed, used to retry disconnected joysticks right away */
+	unsigned long	generation;
+
+} js_hotplug_struct;
+
+/*
+ *	Reconnect State:
+ *
+ *	Allocated on a jsd while it is disconnected and
+ *	JSFlagReconnect is set.
+ */
+typedef struct {
+
+	unsigned long	last_attempt_ms,	/* Time of the last attempt */
+			generation;	/* Hotplug generation at the
+					 * last attempt */
+
+} js_hotplug_reconnect_struct;
+
+/*
+ *	Opened Device Nodes:
+ *
+ *	The device nodes opened by the jsds in this process, a device
+ *	node is listed once for each jsd that has it opened.
+ */
+typedef struct {
+
+	pthread_mutex_t	mutex;
+
+	char		**device_name;
+	int		total_device_names;
+
+} js_hotplug_opened_struct;
+
+
+#if defined(__linux__)
+static int JSHotplugIsJoystickName(const char *name);
+static int JSHotplugWatchOpen(js_hotplug_watch_struct *w);
+static void JSHotplugWatchClose(js_hotplug_watch_struct *w);
+static const char *JSHotplugWatchEventDir(
+	js_hotplug_watch_struct *w, const struct inotify_event *ev
+);
+static void JSHotplugDeviceAdd(
+	js_hotplug_struct *hp,
+	const char *device_name, js_identity_struct *id
+);
+static int JSHotplugDeviceRemove(
+	js_hotplug_struct *hp,
+	const char *device_name, js_identity_struct *id
+);
+static void JSHotplugDeviceClear(js_hotplug_struct *hp);
+static int JSHotplugHasCallback(
+	js_hotplug_struct *hp, const js_hotplug_callback_struct *cb
+);
+static void JSHotplugDispatch(
+	js_hotplug_struct *hp, int event,
+	const char *device_name, const js_identity_struct *id
+);
+static int JSHotplugStart(js_hotplug_struct *hp);
+static void JSHotplugStop(js_hotplug_struct *hp);
+#endif
+int JSHotplugAddCallback(js_hotplug_func func, void *data);
+void JSHotplugRemoveCallback(js_hotplug_func func, void *data);
+int JSHotplugGetFD(void);
+int JSHotplugUpdate(void);
+
+void *JSHotplugWatchNew(void);
+int JSHotplugWatchPoll(void *ptr);
+void JSHotplugWatchDelete(void *ptr);
+
+void *JSHotplugReconnectNew(void);
+int JSHotplugReconnectCheck(void *ptr);
+int JSHotplugReconnectWaitMS(void *ptr);
+void JSHotplugReconnectDelete(void *ptr);
+void JSHotplugDeviceOpened(const char *device_name);
+void JSHotplugDeviceClosed(const char *device_name);
+static int JSHotplugDeviceIsOpened(const char *device_name);
+char *JSHotplugFindDevice(
+	const js_identity_struct *id, const char *device_name
+);
+
+
+#define STRDUP(s)       (((s) != NULL) ? strdup(s) : NULL)
+
+#define MAX(a,b)        (((a) > (b)) ? (a) : (b))
+#define STRISEMPTY(s)   (((s) != NULL) ? (*(s) == '\0') : 1)
+
+
+/*
+ *	Minimum time in milliseconds between attempts to reconnect a
+ *	disconnected joystick when no joystick device node has been
+ *	added in the mean time.
+ */
+#define JS_HOTPLUG_RECONNECT_INTERVAL	1000
+
+
+/*
+ *	Events watched on the device directories:
+ */
+#define JS_HOTPLUG_WATCH_MASK	(IN_CREATE | IN_DELETE | IN_ATTRIB | \
+				 IN_MOVED_FROM | IN_MOVED_TO)
+
+
+static js_hotplug_struct js_hotplug = {
+	PTHREAD_MUTEX_INITIALIZER,
+	{ -1, -1, -1 },
+	NULL, 0,
+	NULL, 0,
+	0
+};
+
+static js_hotplug_opened_struct js_hotplug_opened = {
+	PTHREAD_MUTEX_INITIALIZER,
+	NULL, 0
+};
+
+
+#if defined(__linux__)
+/*
+ *	Checks if name is the name of a joystick device node, "js#".
+ */
+static int JSHotplugIsJoystickName(const char *name)
+{
+	if((name == NULL) || strncmp(name, "js", 2))
+	    return(0);
+
+	name += 2;
+	if(*name == '\0')
+	    return(0);
+	while(*name != '\0')
+	{
+	    if((*name < '0') || (*name > '9'))
+		return(0);
+	    name++;
+	}
+	return(1);
+}
+
+/*
+ *	Starts watching the device directories, "/dev/input" may not
+ *	exist until the first input device is connected so its
+ *	creation is watched for on "/dev".
+ *
+ *	Returns 0 on success or -1 on error.
+ */
+static int JSHotplugWatchOpen(js_hotplug_watch_struct *w)
+{
+	w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(w->fd < 0)
+	    return(-1);
+
+	w->dev_wd = inotify_add_watch(w->fd, "/dev", JS_HOTPLUG_WATCH_MASK);
+	w->input_wd = inotify_add_watch(
+	    w->fd, "/dev/input", JS_HOTPLUG_WATCH_MASK
+	);
+	if((w->dev_wd < 0) && (w->input_wd < 0))
+	{
+	    JSHotplugWatchClose(w);
+	    return(-1);
+	}
+
+	return(0);
+}
+
+/*
+ *	Stops watching the device directories.
+ */
+static void JSHotplugWatchClose(js_hotplug_watch_struct *w)
+{
+	if(w->fd > -1)
+	{
+	    close(w->fd);
+	    w->fd = -1;
+	}
+	w->dev_wd = -1;
+	w->input_wd = -1;
+}
+
+/*
+ *	Returns the directory of the joystick device node that the
+ *	event is for or NULL if the event is not for a joystick
+ *	device node.
+ *
+ *	If the event is for the creation of "/dev/input" then it is
+ *	watched from now on.
+ */
+static const char *JSHotplugWatchEventDir(
+	js_hotplug_watch_struct *w, const struct inotify_event *ev
+)
+{
+	if(ev->len == 0)
+	    return(NULL);
+
+	/* "/dev/input" was created? */
+	if((ev->wd == w->dev_wd) && (ev->mask & IN_ISDIR) &&
+	   (ev->mask & (IN_CREATE | IN_MOVED_TO)) &&
+	   !strcmp(ev->name, "input")
+	)
+	{
+	    w->input_wd = inotify_add_watch(
+		w->fd, "/dev/input", JS_HOTPLUG_WATCH_MASK
+	    );
+	    return(NULL);
+	}
+
+	if(!JSHotplugIsJoystickName(ev->name))
+	    return(NULL);
+
+	if(ev->wd == w->dev_wd)
+	    return("/dev");
+	else if(ev->wd == w->input_wd)
+	    return("/dev/input");
+	else
+	    return(NULL);
+}
+
+/*
+ *	Adds the device to the hotplug monitor's known devices list,
+ *	the identity is transfered.
+ */
+static void JSHotplugDeviceAdd(
+	js_hotplug_struct *hp,
+	const char *device_name, js_identity_struct *id
+)
+{
+	js_hotplug_device_struct *d;
+
+	d = (js_hotplug_device_struct *)realloc(
+	    hp->device,
+	    (hp->total_devices + 1) * sizeof(js_hotplug_device_struct)
+	);
+	if(d == NULL)
+	{
+	    JSIdentityClear(id);
+	    return;
+	}
+	hp->device = d;
+
+	d = &hp->device[hp->total_devices];
+	d->device_name = STRDUP(device_name);
+	d->identity = *id;
+	memset(id, 0x00, sizeof(js_identity_struct));
+	hp->total_devices++;
+}
+
+/*
+ *	Removes the device from the hotplug monitor's known devices
+ *	list, the identity is transfered to id.
+ *
+ *	Returns true if the device was in the list.
+ */
+static int JSHotplugDeviceRemove(
+	js_hotplug_struct *hp,
+	const char *device_name, js_identity_struct *id
+)
+{
+	int i;
+	js_hotplug_device_struct *d;
+
+	for(i = 0; i < hp->total_devices; i++)
+	{
+	    d = &hp->device[i];
+	    if((d->device_name == NULL) || strcmp(d->device_name, device_name))
+		continue;
+
+	    free(d->device_name);
+	    *id = d->identity;
+	    hp->total_devices--;
+	    if(i < hp->total_devices)
+		*d = hp->device[hp->total_devices];
+	    return(1);
+	}
+
+	return(0);
+}
+
+/*
+ *	Deletes the hotplug monitor's known devices list.
+ */
+static void JSHotplugDeviceClear(js_hotplug_struct *hp)
+{
+	int i;
+	js_hotplug_device_struct *d;
+
+	for(i = 0; i < hp->total_devices; i++)
+	{
+	    d = &hp->device[i];
+	    free(d->device_name);
+	    JSIdentityClear(&d->identity);
+	}
+	free(hp->device);
+	hp->device = NULL;
+	hp->total_devices = 0;
+}
+
+/*
+ *	Checks if the callback is still registered, hp must be locked.
+ */
+static int JSHotplugHasCallback(
+	js_hotplug_struct *hp, const js_hotplug_callback_struct *cb
+)
+{
+	int i;
+
+	for(i = 0; i < hp->total_callbacks; i++)
+	{
+	    if((hp->callback[i].func == cb->func) &&
+	       (hp->callback[i].data == cb->data)
+	    )
+		return(1);
+	}
+
+	return(0);
+}
+
+/*
+ *	Calls the callbacks for the event on the device, hp must be
+ *	locked and is unlocked during each call.
+ *
+ *	The callbacks are copied so that they can add or remove
+ *	callbacks, a callback removed by an earlier one is not called
+ *	since its data may already be deleted.
+ */
+static void JSHotplugDispatch(
+	js_hotplug_struct *hp, int event,
+	const char *device_name, const js_identity_struct *id
+)
+{
+	int i;
+	const int total_callbacks = hp->total_callbacks;
+	js_hotplug_callback_struct *callback;
+
+	if(total_callbacks <= 0)
+	    return;
+
+	callback = (js_hotplug_callback_struct *)malloc(
+	    total_callbacks * sizeof(js_hotplug_callback_struct)
+	);
+	if(callback == NULL)
+	    return;
+	memcpy(
+	    callback, hp->callback,
+	    total_callbacks * sizeof(js_hotplug_callback_struct)
+	);
+
+	for(i = 0; i < total_callbacks; i++)
+	{
+	    if(!JSHotplugHasCallback(hp, &callback[i]))
+		continue;
+
+	    pthread_mutex_unlock(&hp->mutex);
+	    callback[i].func(event, device_name, id, callback[i].data);
+	    pthread_mutex_lock(&hp->mutex);
+	}
+
+	free(callback);
+}
+
+/*
+ *	Starts watching the device directories and records the
+ *	joystick devices that are already present.
+ *
+ *	Returns 0 on success or -1 on error.
+ */
+static int JSHotplugStart(js_hotplug_struct *hp)
+{
+	int i, total;
+	js_attribute_struct *list;
+	js_identity_struct id;
+
+	if(hp->watch.fd > -1)
+	    return(0);
+
+	if(JSHotplugWatchOpen(&hp->watch))
+	    return(-1);
+
+	/* Record the joystick devices that are already present */
+	list = JSGetAttributesList(&total, NULL);
+	for(i = 0; i < total; i++)
+	{
+	    if(list[i].not_accessable)
+		continue;
+	    JSIdentityCopy(&id, &list[i].identity);
+	    JSHotplugDeviceAdd(hp, list[i].device_name, &id);
+	}
+	JSFreeAttributesList(list, total);
+
+	return(0);
+}
+
+/*
+ *	Stops watching the device directories.
+ */
+static void JSHotplugStop(js_hotplug_struct *hp)
+{
+	JSHotplugWatchClose(&hp->watch);
+	JSHotplugDeviceClear(hp);
+}
+#endif	/* __linux__ */
+
+
+/*
+ *	Adds a callback to be called when a joystick device is
+ *	connected or disconnected.
+ *
+ *	The hotplug monitor is started when the first callback is
+ *	added, callbacks are only called from JSHotplugUpdate().
+ */
+int JSHotplugAddCallback(js_hotplug_func func, void *data)
+{
+#if defined(__linux__)
+	int status = JSSuccess;
+	js_hotplug_struct *hp = &js_hotplug;
+	js_hotplug_callback_struct *cb;
+
+	if(func == NULL)
+	    return(JSBadValue);
+
+	pthread_mutex_lock(&hp->mutex);
+
+	if(JSHotplugStart(hp))
+	{
+	    status = JSNoAccess;
+	}
+	else
+	{
+	    cb = (js_hotplug_callback_struct *)realloc(
+		hp->callback,
+		(hp->total_callbacks + 1) * sizeof(js_hotplug_callback_struct)
+	    );
+	    if(cb != NULL)
+	    {
+		hp->callback = cb;
+		cb = &hp->callback[hp->total_callbacks];
+		cb->func = func;
+		cb->data = data;
+		hp->total_callbacks++;
+	    }
+	    else
+	    {
+		status = JSNoBuffers;
+	    }
+
+	    if(hp->total_callbacks == 0)
+		JSHotplugStop(hp);
+	}
+
+	pthread_mutex_unlock(&hp->mutex);
+
+	return(status);
+#else
+	return(JSNoAccess);
+#endif
+}
+
+/*
+ *	Removes the callback added by JSHotplugAddCallback() with the
+ *	same func and data.
+ *
+ *	The hotplug monitor is stopped when the last callback is
+ *	removed.
+ */
+void JSHotplugRemoveCallback(js_hotplug_func func, void *data)
+{
+#if defined(__linux__)
+	int i;
+	js_hotplug_struct *hp = &js_hotplug;
+	js_hotplug_callback_struct *cb;
+
+	pthread_mutex_lock(&hp->mutex);
+
+	for(i = 0; i < hp->total_callbacks; i++)
+	{
+	    cb = &hp->callback[i];
+	    if((cb->func != func) || (cb->data != data))
+		continue;
+
+	    hp->total_callbacks--;
+	    if(i < hp->total_callbacks)
+		memmove(
+		    cb, cb + 1,
+		    (hp->total_callbacks - i) *
+			sizeof(js_hotplug_callback_struct)
+		);
+	    break;
+	}
+
+	if(hp->total_callbacks <= 0)
+	{
+	    free(hp->callback);
+	    hp->callback = NULL;
+	    hp->total_callbacks = 0;
+	    JSHotplugStop(hp);
+	}
+
+	pthread_mutex_unlock(&hp->mutex);
+#endif
+}
+
+/*
+ *	Returns the hotplug monitor's descriptor, which becomes
+ *	readable when JSHotplugUpdate() has events to handle, or -1
+ *	if the hotplug monitor is not started.
+ */
+int JSHotplugGetFD(void)
+{
+	int fd;
+	js_hotplug_struct *hp = &js_hotplug;
+
+	pthread_mutex_lock(&hp->mutex);
+	fd = hp->watch.fd;
+	pthread_mutex_unlock(&hp->mutex);
+
+	return(fd);
+}
+
+/*
+ *	Handles the pending hotplug events and calls the callbacks for
+ *	each joystick device that was connected or disconnected.
+ *
+ *	Returns JSGotEvent if any callbacks were called or JSNoEvent.
+ */
+int JSHotplugUpdate(void)
+{
+#if defined(__linux__)
+	int i, status = JSNoEvent;
+	ssize_t bytes_read;
+	char	buf[4096]
+		__attribute__ ((aligned(__alignof__(struct inotify_event)))),
+		device_name[NAME_MAX + 16];
+	const char *dir;
+	const struct inotify_event *ev;
+	js_hotplug_struct *hp = &js_hotplug;
+	js_identity_struct id;
+
+	pthread_mutex_lock(&hp->mutex);
+
+	if(hp->watch.fd < 0)
+	{
+	    pthread_mutex_unlock(&hp->mutex);
+	    return(status);
+	}
+
+	while(1)
+	{
+	    bytes_read = read(hp->watch.fd, buf, sizeof(buf));
+	    if(bytes_read <= 0)
+		break;
+
+	    for(i = 0; i < bytes_read;
+		i += sizeof(struct inotify_event) + ev->len
+	    )
+	    {
+		ev = (const struct inotify_event *)(buf + i);
+
+		dir = JSHotplugWatchEventDir(&hp->watch, ev);
+		if(dir == NULL)
+		    continue;
+
+		snprintf(
+		    device_name, sizeof(device_name),
+		    "%s/%s", dir, ev->name
+		);
+		memset(&id, 0x00, sizeof(js_identity_struct));
+
+		if(ev->mask & (IN_DELETE | IN_MOVED_FROM))
+		{
+		    if(!JSHotplugDeviceRemove(hp, device_name, &id))
+			continue;
+
+		    JSHotplugDispatch(hp, JSHotplugRemoved, device_name, &id);
+		    status = JSGotEvent;
+		}
+		else
+		{
+		    /* The device node's permissions are usually set
+		     * after it is created, so a change may make a
+		     * disconnected joystick accessable
+		     */
+		    hp->generation++;
+
+		    if(ev->mask & IN_ATTRIB)
+			continue;
+
+		    /* Already known? */
+		    if(JSHotplugDeviceRemove(hp, device_name, &id))
+		    {
+			JSHotplugDeviceAdd(hp, device_name, &id);
+			continue;
+		    }
+
+		    JSIdentityLoad(&id, device_name, NULL);
+
+		    JSHotplugDispatch(hp, JSHotplugAdded, device_name, &id);
+		    status = JSGotEvent;
+
+		    /* The hotplug monitor may have been stopped by a
+		     * callback
+		     */
+		    if(hp->watch.fd < 0)
+		    {
+			JSIdentityClear(&id);
+			break;
+		    }
+		    JSHotplugDeviceAdd(hp, device_name, &id);
+		}
+		JSIdentityClear(&id);
+
+		if(hp->watch.fd < 0)
+		    break;
+	    }
+
+	    if(hp->watch.fd < 0)
+		break;
+	}
+
+	pthread_mutex_unlock(&hp->mutex);
+
+	return(status);
+#else
+	return(JSNoEvent);
+#endif
+}
+
+
+/*
+ *	Starts watching the device directories for changes to joystick
+ *	device nodes, the changes are checked with
+ *	JSHotplugWatchPoll().
+ *
+ *	Returns NULL if the device directories can not be watched.
+ */
+void *JSHotplugWatchNew(void)
+{
+#if defined(__linux__)
+	js_hotplug_watch_struct *w = (js_hotplug_watch_struct *)malloc(
+	    sizeof(js_hotplug_watch_struct)
+	);
+	if(w == NULL)
+	    return(NULL);
+
+	if(JSHotplugWatchOpen(w))
+	{
+	    free(w);
+	    return(NULL);
+	}
+
+	return(w);
+#else
+	return(NULL);
+#endif
+}
+
+/*
+ *	Checks if any joystick device node was added, removed or
+ *	changed since the last call, does not block.
+ *
+ *	Returns true if there were any changes or ptr is NULL.
+ */
+int JSHotplugWatchPoll(void *ptr)
+{
+#if defined(__linux__)
+	int i, changed = 0;
+	ssize_t bytes_read;
+	char	buf[4096]
+		__attribute__ ((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *ev;
+	js_hotplug_watch_struct *w = (js_hotplug_watch_struct *)ptr;
+	if(w == NULL)
+	    return(1);
+
+	while(1)
+	{
+	    bytes_read = read(w->fd, buf, sizeof(buf));
+	    if(bytes_read <= 0)
+		break;
+
+	    for(i = 0; i < bytes_read;
+		i += sizeof(struct inotify_event) + ev->len
+	    )
+	    {
+		ev = (const struct inotify_event *)(buf + i);
+		if(JSHotplugWatchEventDir(w, ev) != NULL)
+		    changed = 1;
+	    }
+	}
+
+	return(changed);
+#else
+	return(1);
+#endif
+}
+
+/*
+ *	Stops watching the device directories.
+ */
+void JSHotplugWatchDelete(void *ptr)
+{
+#if defined(__linux__)
+	js_hotplug_watch_struct *w = (js_hotplug_watch_struct *)ptr;
+	if(w == NULL)
+	    return;
+
+	JSHotplugWatchClose(w);
+	free(w);
+#endif
+}
+
+/*
+ *	Allocates the reconnect state for a disconnected jsd.
+ */
+void *JSHotplugReconnectNew(void)
+{
+	js_hotplug_reconnect_struct *rc = (js_hotplug_reconnect_struct *)
+	    calloc(1, sizeof(js_hotplug_reconnect_struct));
+	if(rc == NULL)
+	    return(NULL);
+
+	rc->last_attempt_ms = JSCurrentNS() / 1000000;
+	pthread_mutex_lock(&js_hotplug.mutex);
+	rc->generation = js_hotplug.generation;
+	pthread_mutex_unlock(&js_hotplug.mutex);
+
+	return(rc);
+}
+
+/*
+ *	Checks if an attempt to reconnect should be made now, which is
+ *	when a joystick device node has been added since the last
+ *	attempt or JS_HOTPLUG_RECONNECT_INTERVAL has passed.
+ *
+ *	Returns true if an attempt should be made, the attempt is
+ *	recorded.
+ */
+int JSHotplugReconnectCheck(void *ptr)
+{
+	unsigned long t, generation;
+	js_hotplug_reconnect_struct *rc = (js_hotplug_reconnect_struct *)ptr;
+	if(rc == NULL)
+	    return(1);
+
+	t = JSCurrentNS() / 1000000;
+	pthread_mutex_lock(&js_hotplug.mutex);
+	generation = js_hotplug.generation;
+	pthread_mutex_unlock(&js_hotplug.mutex);
+
+	if((generation == rc->generation) &&
+	   ((t - rc->last_attempt_ms) < JS_HOTPLUG_RECONNECT_INTERVAL)
+	)
+	    return(0);
+
+	rc->last_attempt_ms = t;
+	rc->generation = generation;
+
+	return(1);
+}
+
+/*
+ *	Returns the time in milliseconds until JSHotplugReconnectCheck()
+ *	would allow an attempt without a joystick device node being
+ *	added, 0 if an attempt can be made now.
+ */
+int JSHotplugReconnectWaitMS(void *ptr)
+{
+	unsigned long dt;
+	js_hotplug_reconnect_struct *rc = (js_hotplug_reconnect_struct *)ptr;
+	if(rc == NULL)
+	    return(0);
+
+	dt = (JSCurrentNS() / 1000000) - rc->last_attempt_ms;
+	if(dt >= JS_HOTPLUG_RECONNECT_INTERVAL)
+	    return(0);
+
+	return((int)(JS_HOTPLUG_RECONNECT_INTERVAL - dt));
+}
+
+/*
+ *	Deletes the reconnect state.
+ */
+void JSHotplugReconnectDelete(void *ptr)
+{
+	free(ptr);
+}
+
+/*
+ *	Records that a jsd has opened the device node.
+ */
+void JSHotplugDeviceOpened(const char *device_name)
+{
+	char **list;
+	js_hotplug_opened_struct *op = &js_hotplug_opened;
+
+	if(STRISEMPTY(device_name))
+	    return;
+
+	pthread_mutex_lock(&op->mutex);
+	list = (char **)realloc(
+	    op->device_name,
+	    (op->total_device_names + 1) * sizeof(char *)
+	);
+	if(list != NULL)
+	{
+	    op->device_name = list;
+	    list[op->total_device_names] = STRDUP(device_name);
+	    if(list[op->total_device_names] != NULL)
+		op->total_device_names++;
+	}
+	pthread_mutex_unlock(&op->mutex);
+}
+
+/*
+ *	Records that a jsd has closed the device node.
+ */
+void JSHotplugDeviceClosed(const char *device_name)
+{
+	int i;
+	js_hotplug_opened_struct *op = &js_hotplug_opened;
+
+	if(STRISEMPTY(device_name))
+	    return;
+
+	pthread_mutex_lock(&op->mutex);
+	for(i = 0; i < op->total_device_names; i++)
+	{
+	    if(strcmp(op->device_name[i], device_name))
+		continue;
+
+	    free(op->device_name[i]);
+	    op->total_device_names--;
+	    op->device_name[i] = op->device_name[op->total_device_names];
+	    break;
+	}
+	if(op->total_device_names == 0)
+	{
+	    free(op->device_name);
+	    op->device_name = NULL;
+	}
+	pthread_mutex_unlock(&op->mutex);
+}
+
+/*
+ *	Checks if a jsd has the device node opened.
+ */
+static int JSHotplugDeviceIsOpened(const char *device_name)
+{
+	int i, opened = 0;
+	js_hotplug_opened_struct *op = &js_hotplug_opened;
+
+	pthread_mutex_lock(&op->mutex);
+	for(i = 0; i < op->total_device_names; i++)
+	{
+	    if(!strcmp(op->device_name[i], device_name))
+	    {
+		opened = 1;
+		break;
+	    }
+	}
+	pthread_mutex_unlock(&op->mutex);
+
+	return(opened);
+}
+
+/*
+ *	Finds the device node of the joystick with the identity id,
+ *	the joystick devices are obtained without opening them.
+ *
+ *	If the identity is not set then the device node device_name is
+ *	returned if it exists.
+ *
+ *	If both identities have a physical location then they must be
+ *	at the same physical location. Otherwise any joystick with the
+ *	same vendor, product and name matches unless its device node
+ *	is opened by another jsd, so that one of two identical
+ *	joysticks is not found in place of the other.
+ *
+ *	Returns the device node or NULL if the joystick is not
+ *	connected. The returned string must be deleted by the calling
+ *	function.
+ */
+char *JSHotplugFindDevice(
+	const js_identity_struct *id, const char *device_name
+)
+{
+	int i, total, match, best_match = 0;
+	char *best = NULL;
+	const js_identity_struct *cid;
+	js_attribute_struct *list, *a;
+
+	list = JSGetAttributesList(&total, NULL);
+	for(i = 0; i < total; i++)
+	{
+	    a = &list[i];
+	    if(a->not_accessable || STRISEMPTY(a->device_name))
+		continue;
+
+	    cid = &a->identity;
+	    if(JSIdentityIsSet(id))
+	    {
+		if((cid->vendor != id->vendor) ||
+		   (cid->product != id->product) ||
+		   strcmp(
+			(cid->name != NULL) ? cid->name : "",
+			(id->name != NULL) ? id->name : ""
+		   )
+		)
+		    continue;
+
+		/* Same physical location and same device node name
+		 * are the best matches
+		 */
+		if(!STRISEMPTY(cid->phys) && !STRISEMPTY(id->phys))
+		{
+		    if(strcmp(cid->phys, id->phys))
+			continue;
+		    match = 3;
+		}
+		else
+		{
+		    if(JSHotplugDeviceIsOpened(a->device_name))
+			continue;
+		    match = 1;
+		}
+		if((device_name != NULL) && !strcmp(a->device_name, device_name))
+		    match++;
+	    }
+	    else
+	    {
+		if((device_name == NULL) || strcmp(a->device_name, device_name))
+		    continue;
+		match = 1;
+	    }
+
+	    if(match > best_match)
+	    {
+		free(best);
+		best = STRDUP(a->device_name);
+		best_match = match;
+	    }
+	}
+	JSFreeAttributesList(list, total);
+
+	/* sysfs may not be available, so check the device node itself
+	 * if it was not listed
+	 */
+	if((best == NULL) && !JSIdentityIsSet(id) &&
+	   !STRISEMPTY(device_name) && !access(device_name, F_OK)
+	)
+	    best = STRDUP(device_name);
+
+	return(best);
+}
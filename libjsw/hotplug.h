@@ -0,0 +1,23 @@
+#ifndef HOTPLUG_H
+#define HOTPLUG_H
+
+#include <sys/types.h>
+#include "../include/jsw.h"
+
+
+extern void *JSHotplugWatchNew(void);
+extern int JSHotplugWatchPoll(void *ptr);
+extern void JSHotplugWatchDelete(void *ptr);
+
+extern void *JSHotplugReconnectNew(void);
+extern int JSHotplugReconnectCheck(void *ptr);
+extern int JSHotplugReconnectWaitMS(void *ptr);
+extern void JSHotplugReconnectDelete(void *ptr);
+extern void JSHotplugDeviceOpened(const char *device_name);
+extern void JSHotplugDeviceClosed(const char *device_name);
+extern char *JSHotplugFindDevice(
+	const js_identity_struct *id, const char *device_name
+);
+
+
+#endif	/* HOTPLUG_H */
@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <limits.h>
+#if defined(__linux__)
+# include <sys/sysmacros.h>
+#endif
+
+#include "../include/jsw.h"
+
+#include "identity.h"
+
+
+int JSIdentityIsSet(const js_identity_struct *id);
+char *JSIdentityReadSysFS(const char *path);
+void JSIdentityLoadSysFS(js_identity_struct *id, const char *sysfs_path);
+void JSIdentityLoad(
+	js_identity_struct *id,
+	const char *device_name,
+	const char *driver_name
+);
+void JSIdentityCopy(
+	js_identity_struct *tar, const js_identity_struct *src
+);
+char *JSIdentityKey(
+	const js_identity_struct *id,
+	char *buf, int buf_len
+);
+void JSIdentityClear(js_identity_struct *id);
+
+
+#define STRDUP(s)       (((s) != NULL) ? strdup(s) : NULL)
+#define STRISEMPTY(s)   (((s) != NULL) ? (*(s) == '\0') : 1)
+
+
+/*
+ *	Checks if the identity has enough information to tell apart
+ *	devices of the same kind.
+ *
+ *	The name alone is not enough since identical devices have the
+ *	same name.
+ */
+int JSIdentityIsSet(const js_identity_struct *id)
+{
+	if(id == NULL)
+	    return(0);
+	else if((id->vendor != 0) || (id->product != 0) ||
+		!STRISEMPTY(id->phys)
+	)
+	    return(1);
+	else
+	    return(0);
+}
+
+/*
+ *	Returns the contents of the sysfs attribute specified by path
+ *	with the trailing newline removed or NULL on error.
+ *
+ *	The returned string must be deallocated by the calling function.
+ */
+char *JSIdentityReadSysFS(const char *path)
+{
+	int len;
+	char buf[256];
+	FILE *fp = fopen(path, "rb");
+	if(fp == NULL)
+	    return(NULL);
+
+	if(fgets(buf, sizeof(buf), fp) == NULL)
+	{
+	    fclose(fp);
+	    return(NULL);
+	}
+	fclose(fp);
+
+	len = strlen(buf);
+	while((len > 0) &&
+	      ((buf[len - 1] == '\n') || (buf[len - 1] == '\r'))
+	)
+	    buf[--len] = '\0';
+
+	return(STRDUP(buf));
+}
+
+/*
+ *	Gets the identity from the sysfs input device directory
+ *	specified by sysfs_path, any values that are not available
+ *	are left as is.
+ */
+void JSIdentityLoadSysFS(js_identity_struct *id, const char *sysfs_path)
+{
+	char *s, path[PATH_MAX];
+
+	if((id == NULL) || STRISEMPTY(sysfs_path))
+	    return;
+
+#define SYSFS_DEVICE_PATH(_attr_)	{		\
+ snprintf(						\
+  path, sizeof(path), "%s/%s",				\
+  sysfs_path, (_attr_)					\
+ );							\
+}
+	SYSFS_DEVICE_PATH("name")
+	s = JSIdentityReadSysFS(path);
+	if(s != NULL)
+	{
+	    free(id->name);
+	    id->name = s;
+	}
+
+	SYSFS_DEVICE_PATH("phys")
+	s = JSIdentityReadSysFS(path);
+	if(s != NULL)
+	{
+	    free(id->phys);
+	    id->phys = s;
+	}
+
+	SYSFS_DEVICE_PATH("id/vendor")
+	s = JSIdentityReadSysFS(path);
+	if(s != NULL)
+	{
+	    id->vendor = (unsigned int)strtoul(s, NULL, 16);
+	    free(s);
+	}
+
+	SYSFS_DEVICE_PATH("id/product")
+	s = JSIdentityReadSysFS(path);
+	if(s != NULL)
+	{
+	    id->product = (unsigned int)strtoul(s, NULL, 16);
+	    free(s);
+	}
+#undef SYSFS_DEVICE_PATH
+}
+
+/*
+ *	Gets the identity of the joystick device specified by
+ *	device_name.
+ *
+ *	The identity is obtained from the input device that the
+ *	joystick device node belongs to in sysfs, so symbolic links
+ *	to the device node are resolved.
+ *
+ *	The driver_name is the name reported by the joystick driver, it
+ *	is used as the identity's name if sysfs is not available.
+ */
+void JSIdentityLoad(
+	js_identity_struct *id,
+	const char *device_name,
+	const char *driver_name
+)
+{
+#if defined(__linux__)
+	struct stat stat_buf;
+#endif
+
+	if(id == NULL)
+	    return;
+
+	JSIdentityClear(id);
+
+#if defined(__linux__)
+	if(!STRISEMPTY(device_name) && !stat(device_name, &stat_buf) &&
+	   S_ISCHR(stat_buf.st_mode)
+	)
+	{
+	    char path[80];
+
+	    sprintf(
+		path, "/sys/dev/char/%u:%u/device",
+		major(stat_buf.st_rdev), minor(stat_buf.st_rdev)
+	    );
+	    JSIdentityLoadSysFS(id, path);
+	}
+#endif	/* __linux__ */
+
+	if(id->name == NULL)
+	    id->name = STRDUP(driver_name);
+}
+
+/*
+ *	Coppies the identity src to tar, any existing values on tar
+ *	will be deallocated first.
+ */
+void JSIdentityCopy(
+	js_identity_struct *tar, const js_identity_struct *src
+)
+{
+	if((tar == NULL) || (src == NULL) || (tar == src))
+	    return;
+
+	JSIdentityClear(tar);
+	tar->name = STRDUP(src->name);
+	tar->vendor = src->vendor;
+	tar->product = src->product;
+	tar->phys = STRDUP(src->phys);
+}
+
+/*
+ *	Formats the identity's key string, which is used to look up
+ *	the identity's calibration.
+ *
+ *	Returns buf or NULL if the identity is not set.
+ */
+char *JSIdentityKey(
+	const js_identity_struct *id,
+	char *buf, int buf_len
+)
+{
+	if((buf == NULL) || (buf_len <= 0))
+	    return(NULL);
+
+	if(!JSIdentityIsSet(id))
+	    return(NULL);
+
+	snprintf(
+	    buf, buf_len,
+	    "%.4x:%.4x:%s:%s",
+	    id->vendor, id->product,
+	    (id->name != NULL) ? id->name : "",
+	    (id->phys != NULL) ? id->phys : ""
+	);
+
+	return(buf);
+}
+
+/*
+ *	Deallocates all the values on the identity and resets it.
+ *
+ *	The identity structure itself is not deallocated.
+ */
+void JSIdentityClear(js_identity_struct *id)
+{
+	if(id == NULL)
+	    return;
+
+	free(id->name);
+	id->name = NULL;
+	id->vendor = 0;
+	id->product = 0;
+	free(id->phys);
+	id->phys = NULL;
+}
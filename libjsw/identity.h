@@ -0,0 +1,34 @@
+#ifndef IDENTITY_H
+#define IDENTITY_H
+
+#include <sys/types.h>
+#include "../include/jsw.h"
+
+
+/*
+ *	Maximum length of an identity key string:
+ */
+#define JS_IDENTITY_KEY_MAX		512
+
+
+extern int JSIdentityIsSet(const js_identity_struct *id);
+extern char *JSIdentityReadSysFS(const char *path);
+extern void JSIdentityLoadSysFS(
+	js_identity_struct *id, const char *sysfs_path
+);
+extern void JSIdentityLoad(
+	js_identity_struct *id,
+	const char *device_name,
+	const char *driver_name
+);
+extern void JSIdentityCopy(
+	js_identity_struct *tar, const js_identity_struct *src
+);
+extern char *JSIdentityKey(
+	const js_identity_struct *id,
+	char *buf, int buf_len
+);
+extern void JSIdentityClear(js_identity_struct *id);
+
+
+#endif	/* IDENTITY_H */
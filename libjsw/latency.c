@@ -0,0 +1,342 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "../include/jsw.h"
+
+#include "latency.h"
+#include "utils.h"
+#include "private.h"
+
+
+/*
+ *	Histogram Buckets:
+ *
+ *	Values below 2 * JS_LATENCY_SUB_BUCKETS microseconds each have
+ *	their own bucket, larger values are counted in buckets that
+ *	are JS_LATENCY_SUB_BUCKETS per power of two wide so that each
+ *	value is recorded to within about 3%.
+ */
+#define JS_LATENCY_SUB_BITS	5
+#define JS_LATENCY_SUB_BUCKETS	(1 << JS_LATENCY_SUB_BITS)
+#define JS_LATENCY_BUCKETS	((32 - JS_LATENCY_SUB_BITS + 1) * JS_LATENCY_SUB_BUCKETS)
+
+/*
+ *	Number of applied events that JSMarkConsumed() can measure:
+ */
+#define JS_LATENCY_PENDING	256
+
+
+/*
+ *	Histogram:
+ */
+typedef struct {
+
+	unsigned long	count,
+			sum,		/* Sum of all values (in us) */
+			min,
+			max;
+	unsigned long	bucket[JS_LATENCY_BUCKETS];
+
+} js_latency_histogram_struct;
+
+/*
+ *	Latency:
+ */
+typedef struct {
+
+	js_latency_histogram_struct	histogram[2];	/* Indexed by
+							 * JSLatency* */
+
+	/* Offset from the driver's time stamps to CLOCK_MONOTONIC in
+	 * microseconds, the smallest difference seen so far
+	 */
+	long		offset;
+	int		has_offset;
+
+	/* Time stamps of the events applied since the last call to
+	 * JSMarkConsumed()
+	 */
+	unsigned int	pending[JS_LATENCY_PENDING];
+	int		pending_start,
+			total_pending;
+
+} js_latency_data_struct;
+#define JS_LATENCY_DATA(p)	((js_latency_data_struct *)(p))
+
+
+static long JSLatencyDelta(unsigned long now, unsigned int event_time);
+static int JSLatencyBucket(unsigned long value);
+static unsigned long JSLatencyBucketMax(int i);
+static void JSLatencyRecord(js_latency_histogram_struct *h, long value);
+
+void *JSLatencyNew(void);
+void JSLatencyApplied(void *ptr, unsigned int event_time);
+void JSLatencyConsumed(void *ptr);
+void JSLatencyDelete(void *ptr);
+
+void JSMarkConsumed(js_data_struct *jsd);
+int JSGetLatency(
+	js_data_struct *jsd, int which,
+	js_latency_struct *latency
+);
+void JSResetLatency(js_data_struct *jsd);
+
+
+#define JS_LOAD(p)		__atomic_load_n((p), __ATOMIC_RELAXED)
+#define JS_STORE(p,v)		__atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define JS_ADD(p,v)		__atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+
+
+/*
+ *	Returns the time in microseconds from the driver's time stamp
+ *	event_time (in ms, wraps around) to now, plus the unknown
+ *	offset between the two clocks.
+ */
+static long JSLatencyDelta(unsigned long now, unsigned int event_time)
+{
+	const int ms = (int)((unsigned int)(now / 1000) - event_time);
+	return(((long)ms * 1000) + (long)(now % 1000));
+}
+
+/*
+ *	Returns the histogram bucket for the value.
+ */
+static int JSLatencyBucket(unsigned long value)
+{
+	int shift;
+
+	if(value > 0xffffffffUL)
+	    value = 0xffffffffUL;
+
+	if(value < (2 * JS_LATENCY_SUB_BUCKETS))
+	    return((int)value);
+
+	/* Shift that leaves JS_LATENCY_SUB_BITS + 1 significant bits */
+	shift = 63 - __builtin_clzl(value) - JS_LATENCY_SUB_BITS;
+	return((shift * JS_LATENCY_SUB_BUCKETS) + (int)(value >> shift));
+}
+
+/*
+ *	Returns the largest value counted in histogram bucket i.
+ */
+static unsigned long JSLatencyBucketMax(int i)
+{
+	int shift;
+
+	if(i < (2 * JS_LATENCY_SUB_BUCKETS))
+	    return((unsigned long)i);
+
+	shift = (i / JS_LATENCY_SUB_BUCKETS) - 1;
+	return(
+	    ((unsigned long)(i - (shift * JS_LATENCY_SUB_BUCKETS) + 1) << shift)
+	    - 1
+	);
+}
+
+/*
+ *	Records the value (in us) in the histogram.
+ */
+static void JSLatencyRecord(js_latency_histogram_struct *h, long value)
+{
+	unsigned long v = (value > 0) ? (unsigned long)value : 0;
+
+	/* Only the thread that calls JSUpdate() records values so the
+	 * minimum and maximum need not be compared and swapped
+	 */
+	if((JS_LOAD(&h->count) == 0) || (v < JS_LOAD(&h->min)))
+	    JS_STORE(&h->min, v);
+	if(v > JS_LOAD(&h->max))
+	    JS_STORE(&h->max, v);
+	JS_ADD(&h->sum, v);
+	JS_ADD(&h->bucket[JSLatencyBucket(v)], 1);
+	JS_ADD(&h->count, 1);
+}
+
+
+/*
+ *	Allocates new Latency.
+ */
+void *JSLatencyNew(void)
+{
+	return(calloc(1, sizeof(js_latency_data_struct)));
+}
+
+/*
+ *	Called by JSUpdate() when it applies an event with the driver's
+ *	time stamp event_time.
+ *
+ *	The driver's time stamps are in milliseconds on a clock that
+ *	is not CLOCK_MONOTONIC, so the offset between the two clocks is
+ *	taken to be the smallest difference seen. The latencies are
+ *	therefore measured from the fastest event delivery seen and
+ *	to within the driver's clock resolution.
+ */
+void JSLatencyApplied(void *ptr, unsigned int event_time)
+{
+	js_latency_data_struct *l = JS_LATENCY_DATA(ptr);
+	long delta;
+	if(l == NULL)
+	    return;
+
+	delta = JSLatencyDelta(JSCurrentNS() / 1000, event_time);
+	if(!l->has_offset || (delta < l->offset))
+	{
+	    l->offset = delta;
+	    l->has_offset = 1;
+	}
+	JSLatencyRecord(&l->histogram[JSLatencyApply], delta - l->offset);
+
+	/* Keep the time stamp for JSMarkConsumed(), replacing the
+	 * oldest one when there is no room
+	 */
+	if(l->total_pending < JS_LATENCY_PENDING)
+	{
+	    l->pending[
+		(l->pending_start + l->total_pending) % JS_LATENCY_PENDING
+	    ] = event_time;
+	    l->total_pending++;
+	}
+	else
+	{
+	    l->pending[l->pending_start] = event_time;
+	    l->pending_start = (l->pending_start + 1) % JS_LATENCY_PENDING;
+	}
+}
+
+/*
+ *	Records the latency of all the events applied since the last
+ *	call.
+ */
+void JSLatencyConsumed(void *ptr)
+{
+	js_latency_data_struct *l = JS_LATENCY_DATA(ptr);
+	unsigned long now;
+	int i;
+	if((l == NULL) || (l->total_pending == 0))
+	    return;
+
+	now = JSCurrentNS() / 1000;
+	for(i = 0; i < l->total_pending; i++)
+	    JSLatencyRecord(
+		&l->histogram[JSLatencyConsume],
+		JSLatencyDelta(
+		    now,
+		    l->pending[(l->pending_start + i) % JS_LATENCY_PENDING]
+		) - l->offset
+	    );
+
+	l->pending_start = 0;
+	l->total_pending = 0;
+}
+
+/*
+ *	Deletes the Latency.
+ */
+void JSLatencyDelete(void *ptr)
+{
+	free(ptr);
+}
+
+
+/*
+ *	Marks all the events applied by JSUpdate() so far as consumed.
+ */
+void JSMarkConsumed(js_data_struct *jsd)
+{
+	if(jsd == NULL)
+	    return;
+
+	JSLatencyConsumed(JS_PRIVATE(jsd)->latency);
+}
+
+/*
+ *	Gets the latency histogram's summary.
+ */
+int JSGetLatency(
+	js_data_struct *jsd, int which,
+	js_latency_struct *latency
+)
+{
+	int i, p;
+	unsigned long n, count, rank[4];
+	unsigned long *value[4];
+	js_latency_histogram_struct *h;
+	js_latency_data_struct *l;
+
+	if((jsd == NULL) || (latency == NULL) ||
+	   ((which != JSLatencyApply) && (which != JSLatencyConsume))
+	)
+	    return(JSBadValue);
+
+	memset(latency, 0x00, sizeof(js_latency_struct));
+
+	l = JS_LATENCY_DATA(JS_PRIVATE(jsd)->latency);
+	if(l == NULL)
+	    return(JSError);
+
+	h = &l->histogram[which];
+	count = JS_LOAD(&h->count);
+	if(count == 0)
+	    return(JSSuccess);
+
+	latency->count = count;
+	latency->min = JS_LOAD(&h->min);
+	latency->max = JS_LOAD(&h->max);
+	latency->mean = JS_LOAD(&h->sum) / count;
+
+	/* Find the bucket of each percentile's rank, the bucket
+	 * counts may be ahead of count if JSUpdate() is recording
+	 */
+	rank[0] = (count * 500 + 999) / 1000;
+	rank[1] = (count * 900 + 999) / 1000;
+	rank[2] = (count * 990 + 999) / 1000;
+	rank[3] = (count * 999 + 999) / 1000;
+	value[0] = &latency->p50;
+	value[1] = &latency->p90;
+	value[2] = &latency->p99;
+	value[3] = &latency->p999;
+	for(i = 0, p = 0, n = 0; (i < JS_LATENCY_BUCKETS) && (p < 4); i++)
+	{
+	    n += JS_LOAD(&h->bucket[i]);
+	    while((p < 4) && (n >= rank[p]))
+	    {
+		*value[p] = JSLatencyBucketMax(i);
+		if(*value[p] > latency->max)
+		    *value[p] = latency->max;
+		p++;
+	    }
+	}
+
+	return(JSSuccess);
+}
+
+/*
+ *	Resets the latency histograms.
+ */
+void JSResetLatency(js_data_struct *jsd)
+{
+	int i, j;
+	js_latency_histogram_struct *h;
+	js_latency_data_struct *l;
+
+	if(jsd == NULL)
+	    return;
+
+	l = JS_LATENCY_DATA(JS_PRIVATE(jsd)->latency);
+	if(l == NULL)
+	    return;
+
+	for(i = 0; i < 2; i++)
+	{
+	    h = &l->histogram[i];
+	    JS_STORE(&h->count, 0);
+	    JS_STORE(&h->sum, 0);
+	    JS_STORE(&h->min, 0);
+	    JS_STORE(&h->max, 0);
+	    for(j = 0; j < JS_LATENCY_BUCKETS; j++)
+		JS_STORE(&h->bucket[j], 0);
+	}
+}
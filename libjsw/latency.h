@@ -0,0 +1,14 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <sys/types.h>
+#include "../include/jsw.h"
+
+
+extern void *JSLatencyNew(void);
+extern void JSLatencyApplied(void *ptr, unsigned int event_time);
+extern void JSLatencyConsumed(void *ptr);
+extern void JSLatencyDelete(void *ptr);
+
+
+#endif	/* LATENCY_H */
@@ -6,11 +6,28 @@
 #include <errno.h>
 #include <sys/ioctl.h>
 #include <fcntl.h>
+#include <pthread.h>
 #if defined(__FreeBSD__)
 # include <sys/joystick.h>
 #endif
 
 #include "forcefeedback.h"
+#include "identity.h"
+#include "calibloader.h"
+#include "arena.h"
+#include "hotplug.h"
+#include "calibrationfio.h"
+#include "eventcallback.h"
+#include "pollfd.h"
+#include "eventring.h"
+#include "stats.h"
+#include "latency.h"
+#include "device.h"
+#include "record.h"
+#include "pollpolicy.h"
+#include "axishistory.h"
+#include "private.h"
+#include "probes.h"
 
 #include "../include/string.h"
 #include "../include/disk.h"
@@ -19,14 +36,60 @@
 #include "../include/jsw.h"
 
 
+/*
+ *	JSInitMany() Open Request:
+ */
+typedef struct {
+
+	pthread_t	thread;
+	js_data_struct	*jsd;
+	const char	*device,
+			*calibration;
+	unsigned int	flags;
+	int		started,	/* Thread was started */
+			status;		/* Result of JSInitOpen() */
+
+} js_init_many_struct;
+
+
+static int JSInitOpen(
+	js_data_struct *jsd,
+	const char *device,
+	const char *calibration,
+	unsigned int flags
+);
 int JSInit(
 	js_data_struct *jsd,
 	const char *device,
 	const char *calibration,
 	unsigned int flags
 );
+int JSInitAsync(
+	js_data_struct *jsd,
+	const char *device,
+	const char *calibration,
+	unsigned int flags
+);
+int JSInitWait(js_data_struct *jsd);
+static void *JSInitManyThread(void *data);
+int JSInitMany(
+	js_data_struct *jsd,
+	const char **device,
+	int total,
+	const char *calibration,
+	unsigned int flags,
+	int *status
+);
+static void JSDisconnect(js_data_struct *jsd);
+static int JSReconnect(js_data_struct *jsd);
 static void SetAxisValue(js_axis_struct *axis, int value, time_t t);
 static void SetButtonValue(js_button_struct *button, int value, time_t t);
+static void JSEventChanged(
+	js_data_struct *jsd, int event, int number, int value, time_t t
+);
+static void JSUpdateAxis(js_data_struct *jsd, int n, int value, time_t t);
+static void JSUpdateButton(js_data_struct *jsd, int n, int value, time_t t);
+static int JSDoUpdate(js_data_struct *jsd);
 int JSUpdate(js_data_struct *jsd);
 void JSClose(js_data_struct *jsd);
 
@@ -44,24 +107,18 @@ void JSClose(js_data_struct *jsd);
 
 
 /*
- *      Initializes the joystick and stores the new initialized values
- *      into the jsd structure.
- *
- *      If the device is not specified (set to NULL), then it will
- *      be defauled to JSDefaultDevice.
- *
- *      If the calibration file is not specified (set to NULL), then
- *      it will be defaulted to JSDefaultCalibration. The HOME
- *      enviroment value will be used as the prefix to the path of
- *      JSDefaultCalibration. The calibration file does not have to
- *      exist.
- *
- *	Available flags are:
+ *	Maximum number of events read by JSUpdate() at once:
+ */
+#define JS_UPDATE_BATCH		16
+
+
+/*
+ *	Opens the joystick and sets up the jsd structure with default
+ *	calibration values, called by JSInit() and JSInitAsync().
  *
- *	JSFlagNonBlocking		Open in non-blocking mode.
- *	JSFlagForceFeedback		Open in read/write mode.
+ *	The calibration is not loaded.
  */
-int JSInit(
+static int JSInitOpen(
 	js_data_struct *jsd,
 	const char *device,
 	const char *calibration,
@@ -69,8 +126,9 @@ int JSInit(
 )
 {
 	int i;
-	js_axis_struct *axis;
-	js_button_struct *button;
+	js_private_struct *priv;
+	js_axis_struct *axis = NULL;
+	js_button_struct *button = NULL;
 
 #if defined(__linux__) || defined(__FreeBSD__)
 	unsigned char axes = 2;
@@ -109,6 +167,12 @@ int JSInit(
 	jsd->driver_version = 0;
 	jsd->last_calibrated = 0;
 	jsd->force_feedback = NULL;
+	jsd->priv = NULL;
+	memset(&jsd->identity, 0x00, sizeof(js_identity_struct));
+
+	priv = JSPrivateGet(jsd);
+	if(priv == NULL)
+	    return(JSNoBuffers);
 
 
 	/* Set default device name as needed */
@@ -136,30 +200,37 @@ int JSInit(
 
 #if defined(__linux__) || defined(__FreeBSD__)
 	/* Open joystick */
-	jsd->fd = open(jsd->device_name, O_RDONLY);
+	jsd->fd = JSDeviceOpen(jsd->device_name, &priv->device);
+	JS_PROBE3(device_open, jsd, jsd->device_name, jsd->fd);
 	if(jsd->fd < 0)
 	{
 	    JSClose(jsd);
 	    return(JSNoAccess);
 	}
+	JSHotplugDeviceOpened(jsd->device_name);
 #endif
 
+	/* Allocate the statistics, which are always counted */
+	priv->stats = JSStatsNew();
+
 #if defined(__linux__)
 	/* Fetch device values */
 	/* Raw version string */
-	ioctl(jsd->fd, JSIOCGVERSION, &version);
+	JSDeviceIoctl(jsd->fd, priv->device, JSIOCGVERSION, &version);
 	jsd->driver_version = (unsigned int)version;
 
 	/* Total number of axises */
-	ioctl(jsd->fd, JSIOCGAXES, &axes);	/* Total axises */
+	JSDeviceIoctl(jsd->fd, priv->device, JSIOCGAXES, &axes);
 	jsd->total_axises = axes;
 
 	/* Total number of buttons */
-	ioctl(jsd->fd, JSIOCGBUTTONS, &buttons);	/* Total buttons */
+	JSDeviceIoctl(jsd->fd, priv->device, JSIOCGBUTTONS, &buttons);
 	jsd->total_buttons = buttons;
 
 	/* Device descriptive name */
-	ioctl(jsd->fd, JSIOCGNAME(LINUX_JS_NAME_MAX), name);
+	JSDeviceIoctl(
+	    jsd->fd, priv->device, JSIOCGNAME(LINUX_JS_NAME_MAX), name
+	);
 	jsd->name = STRDUP(name);
 #elif defined(__FreeBSD__)
 	jsd->driver_version = version = 1;
@@ -168,6 +239,11 @@ int JSInit(
 	strlcpy(name, "FreeBSD-Gameport", LINUX_JS_NAME_MAX);
 	jsd->name = STRDUP(name);
 #endif
+	/* Get the device's identity, the calibration is looked up by
+	 * it
+	 */
+	JSIdentityLoad(&jsd->identity, jsd->device_name, jsd->name);
+
 	/* Allocate axises */
 	if(jsd->total_axises > 0)
 	{
@@ -182,16 +258,22 @@ int JSInit(
 	        return(JSNoBuffers);
 	    }
 	}
-	for(i = 0; i < jsd->total_axises; i++)
+	if(jsd->total_axises > 0)
 	{
-	    jsd->axis[i] = axis = (js_axis_struct *)calloc(
-		1, sizeof(js_axis_struct)
+	    /* Allocate all the axises at once from the arena */
+	    axis = (js_axis_struct *)JSArenaAlloc(
+		&priv->arena,
+		jsd->total_axises * sizeof(js_axis_struct)
 	    );
 	    if(axis == NULL)
 	    {
 		JSClose(jsd);
 		return(JSNoBuffers);
 	    }
+	}
+	for(i = 0; i < jsd->total_axises; i++, axis++)
+	{
+	    jsd->axis[i] = axis;
 
 	    /* Reset axis values */
 	    axis->cur = JSDefaultCenter;
@@ -217,16 +299,22 @@ int JSInit(
 		return(JSNoBuffers);
 	    }
 	}
-	for(i = 0; i < jsd->total_buttons; i++)
+	if(jsd->total_buttons > 0)
 	{
-	    jsd->button[i] = button = (js_button_struct *)calloc(
-		1, sizeof(js_button_struct)
+	    /* Allocate all the buttons at once from the arena */
+	    button = (js_button_struct *)JSArenaAlloc(
+		&priv->arena,
+		jsd->total_buttons * sizeof(js_button_struct)
 	    );
 	    if(button == NULL)
 	    {
 		JSClose(jsd);
 		return(JSNoBuffers);
 	    }
+	}
+	for(i = 0; i < jsd->total_buttons; i++, button++)
+	{
+	    jsd->button[i] = button;
 
 	    /* Reset button values */
 	    button->state = JSButtonStateOff;
@@ -239,19 +327,489 @@ int JSInit(
 	    jsd->flags |= JSFlagNonBlocking;
  	}
 
+	/* Re-attach when reconnected? */
+	if(flags & JSFlagReconnect)
+	    jsd->flags |= JSFlagReconnect;
+
+	/* Coalesce axis events? */
+	if(flags & JSFlagCoalesce)
+	    jsd->flags |= JSFlagCoalesce;
+
+	/* Record the input latency? */
+	if(flags & JSFlagLatency)
+	{
+	    priv->latency = JSLatencyNew();
+	    if(priv->latency == NULL)
+	    {
+		JSClose(jsd);
+		return(JSNoBuffers);
+	    }
+	    jsd->flags |= JSFlagLatency;
+	}
+
 	/* Mark successful initialization */
 	jsd->flags |= JSFlagIsInit;
 
+	return(JSSuccess);
+}
+
+/*
+ *      Initializes the joystick and stores the new initialized values
+ *      into the jsd structure.
+ *
+ *      If the device is not specified (set to NULL), then it will
+ *      be defauled to JSDefaultDevice.
+ *
+ *	If the device starts with JSSyntheticDevicePrefix then a
+ *	synthetic joystick is opened instead of a device node, if it
+ *	starts with JSReplayDevicePrefix then a recording made by
+ *	JSRecordStart() is replayed.
+ *
+ *      If the calibration file is not specified (set to NULL), then
+ *      it will be defaulted to JSDefaultCalibration. The HOME
+ *      enviroment value will be used as the prefix to the path of
+ *      JSDefaultCalibration. The calibration file does not have to
+ *      exist.
+ *
+ *	Available flags are:
+ *
+ *	JSFlagNonBlocking		Open in non-blocking mode.
+ *	JSFlagForceFeedback		Open in read/write mode.
+ *	JSFlagReconnect			Re-attach to the same device
+ *					when it is reconnected.
+ *	JSFlagCoalesce			Apply only the last event for
+ *					each axis read by JSUpdate().
+ *	JSFlagLatency			Record the input latency for
+ *					JSGetLatency().
+ */
+int JSInit(
+	js_data_struct *jsd,
+	const char *device,
+	const char *calibration,
+	unsigned int flags
+)
+{
+	const int status = JSInitOpen(jsd, device, calibration, flags);
+	if(status != JSSuccess)
+	    return(status);
+
 	/* Load calibration from calibration file */
 	JSLoadCalibrationUNIX(jsd);
 
 	/* Set axis tolorance for error correction */
 	JSResetAllAxisTolorance(jsd);
 
+	return(JSSuccess);
+}
+
+/*
+ *	Same as JSInit() except that the calibration is loaded on a
+ *	worker thread.
+ *
+ *	The joystick is opened and can be used as soon as this
+ *	function returns, its axises will have default calibration
+ *	values until the calibration is loaded. The calibration is
+ *	applied by JSUpdate() once it has been loaded, or by
+ *	JSInitWait().
+ */
+int JSInitAsync(
+	js_data_struct *jsd,
+	const char *device,
+	const char *calibration,
+	unsigned int flags
+)
+{
+	js_private_struct *priv;
+	const int status = JSInitOpen(jsd, device, calibration, flags);
+	if(status != JSSuccess)
+	    return(status);
+
+	/* Start loading calibration from calibration file */
+	priv = JS_PRIVATE_DATA(jsd->priv);
+	priv->calibration_loader = JSCalibLoaderNew(jsd);
+	if(priv->calibration_loader == NULL)
+	{
+	    /* Unable to start the worker thread, load calibration
+	     * from calibration file now
+	     */
+	    JSLoadCalibrationUNIX(jsd);
+	    JSResetAllAxisTolorance(jsd);
+	}
+
+	return(JSSuccess);
+}
+
+/*
+ *	Waits for the calibration being loaded by JSInitAsync() to be
+ *	loaded and applies it to the jsd.
+ *
+ *	Returns JSSuccess if the calibration has been applied or was
+ *	not being loaded.
+ */
+int JSInitWait(js_data_struct *jsd)
+{
+	js_private_struct *priv;
+
+	if(jsd == NULL)
+	    return(JSBadValue);
+
+	priv = JS_PRIVATE_DATA(jsd->priv);
+	if((priv != NULL) && (priv->calibration_loader != NULL))
+	{
+	    JSCalibLoaderPoll(priv->calibration_loader, jsd, 1);
+	    JSCalibLoaderDelete(priv->calibration_loader);
+	    priv->calibration_loader = NULL;
+	}
 
 	return(JSSuccess);
 }
 
+/*
+ *	JSInitMany() worker thread, opens one joystick.
+ */
+static void *JSInitManyThread(void *data)
+{
+	js_init_many_struct *req = (js_init_many_struct *)data;
+
+	req->status = JSInitOpen(
+	    req->jsd, req->device, req->calibration, req->flags
+	);
+
+	return(NULL);
+}
+
+/*
+ *	Initializes total joysticks, the joystick specified by device[i]
+ *	is initialized on jsd[i] as if by JSInit().
+ *
+ *	The joysticks are opened and queried at the same time on
+ *	worker threads and the calibration file is read only once for
+ *	all of them.
+ *
+ *	If device is NULL then all the devices are defaulted as with
+ *	JSInit(), the calibration is the same for all the joysticks.
+ *
+ *	If status is not NULL then it must have total entries, each
+ *	is set to the value that JSInit() would have returned for that
+ *	joystick.
+ *
+ *	Returns JSSuccess if all the joysticks were initialized,
+ *	JSError if some were not or JSBadValue if the arguments are
+ *	invalid. The joysticks that were initialized must be closed
+ *	with JSClose() either way.
+ */
+int JSInitMany(
+	js_data_struct *jsd,
+	const char **device,
+	int total,
+	const char *calibration,
+	unsigned int flags,
+	int *status
+)
+{
+	int i, total_opened, rtn = JSSuccess;
+	char *calibration_path = NULL;
+	js_init_many_struct *req;
+	js_data_struct **opened;
+
+	if((jsd == NULL) || (total <= 0))
+	    return(JSBadValue);
+
+	req = (js_init_many_struct *)calloc(
+	    total, sizeof(js_init_many_struct)
+	);
+	opened = (js_data_struct **)calloc(
+	    total, sizeof(js_data_struct *)
+	);
+	if((req == NULL) || (opened == NULL))
+	{
+	    free(req);
+	    free(opened);
+	    for(i = 0; i < total; i++)
+	    {
+		memset(&jsd[i], 0x00, sizeof(js_data_struct));
+		jsd[i].fd = -1;
+		if(status != NULL)
+		    status[i] = JSNoBuffers;
+	    }
+	    return(JSError);
+	}
+
+	/* Get the default calibration file name here since
+	 * PrefixPaths() is not reentrant
+	 */
+	if(calibration == NULL)
+	{
+	    const char *home = getenv("HOME");
+	    calibration = PrefixPaths(
+		(home != NULL) ? home : "/",
+		JSDefaultCalibration
+	    );
+	    if(calibration == NULL)
+		calibration = JSDefaultCalibration;
+	}
+	calibration = calibration_path = STRDUP(calibration);
+
+	/* Open and query all the joysticks at the same time, a
+	 * joystick whose thread could not be started is opened on
+	 * this thread
+	 */
+	for(i = 0; i < total; i++)
+	{
+	    js_init_many_struct *r = &req[i];
+	    r->jsd = &jsd[i];
+	    r->device = (device != NULL) ? device[i] : NULL;
+	    r->calibration = calibration;
+	    r->flags = flags;
+	    r->started = !pthread_create(
+		&r->thread, NULL, JSInitManyThread, r
+	    );
+	    if(!r->started)
+		JSInitManyThread(r);
+	}
+	for(i = 0; i < total; i++)
+	{
+	    if(req[i].started)
+		pthread_join(req[i].thread, NULL);
+	}
+
+	/* Load calibration from calibration file for all the
+	 * joysticks that were opened
+	 */
+	total_opened = 0;
+	for(i = 0; i < total; i++)
+	{
+	    if(req[i].status == JSSuccess)
+		opened[total_opened++] = &jsd[i];
+	}
+	JSLoadCalibrationManyUNIX(opened, total_opened);
+
+	/* Set axis tolorance for error correction */
+	for(i = 0; i < total_opened; i++)
+	    JSResetAllAxisTolorance(opened[i]);
+
+	for(i = 0; i < total; i++)
+	{
+	    if(status != NULL)
+		status[i] = req[i].status;
+	    if(req[i].status != JSSuccess)
+		rtn = JSError;
+	}
+
+	free(req);
+	free(opened);
+	free(calibration_path);
+
+	return(rtn);
+}
+
+
+/*
+ *	Called by JSUpdate() when the joystick's device has been
+ *	disconnected and JSFlagReconnect is set.
+ *
+ *	The joystick is closed but its calibration is kept, all its
+ *	axises are centered and all its buttons are released.
+ */
+static void JSDisconnect(js_data_struct *jsd)
+{
+	int i;
+	js_private_struct *priv = JS_PRIVATE_DATA(jsd->priv);
+	js_axis_struct *axis;
+	js_button_struct *button;
+
+	/* The calibration being loaded by JSInitAsync() uses the
+	 * descriptor, so apply it before closing
+	 */
+	if(priv->calibration_loader != NULL)
+	{
+	    JSCalibLoaderPoll(priv->calibration_loader, jsd, 1);
+	    JSCalibLoaderDelete(priv->calibration_loader);
+	    priv->calibration_loader = NULL;
+	}
+
+	/* Remove the descriptor from the poll descriptor before it is
+	 * closed and wake up the event loop to try to reconnect
+	 */
+	JSPollFDSetDevice(priv->poll_fd, -1, 0);
+
+	if(jsd->fd > -1)
+	{
+	    JS_PROBE3(device_close, jsd, jsd->device_name, jsd->fd);
+	    JSDeviceClose(jsd->fd, priv->device);
+	    JSHotplugDeviceClosed(jsd->device_name);
+	    jsd->fd = -1;
+	    priv->device = NULL;
+	}
+
+	for(i = 0; i < jsd->total_axises; i++)
+	{
+	    axis = jsd->axis[i];
+	    if(axis == NULL)
+		continue;
+
+	    axis->prev = axis->cur;
+	    axis->cur = axis->cen;
+	    if(axis->cur != axis->prev)
+		JSEventChanged(jsd, JSEventAxis, i, axis->cur, axis->time);
+	}
+	for(i = 0; i < jsd->total_buttons; i++)
+	{
+	    button = jsd->button[i];
+	    if(button == NULL)
+		continue;
+
+	    button->prev_state = button->state;
+	    button->state = JSButtonStateOff;
+	    button->changed_state =
+		(button->prev_state == JSButtonStateOn) ?
+		    JSButtonChangedStateOnToOff :
+		    JSButtonChangedStateNone;
+	    if(button->state != button->prev_state)
+	    {
+		button->releases++;
+		JSEventChanged(
+		    jsd, JSEventButtonRelease, i,
+		    button->state, button->time
+		);
+	    }
+	}
+
+	JSHotplugReconnectDelete(priv->hotplug);
+	priv->hotplug = JSHotplugReconnectNew();
+}
+
+/*
+ *	Called by JSUpdate() to re-attach a disconnected joystick to
+ *	its device, the device is looked up by the joystick's identity.
+ *
+ *	The calibration is kept, additional axises and buttons are
+ *	allocated if the device now has more.
+ *
+ *	Returns JSSuccess if the joystick was re-attached.
+ */
+static int JSReconnect(js_data_struct *jsd)
+{
+	int fd, i;
+	char *device_name;
+	void *device;
+	js_private_struct *priv = JS_PRIVATE_DATA(jsd->priv);
+#if defined(__linux__)
+	unsigned char axes = 0, buttons = 0;
+#endif
+
+	/* Not time to try again yet? */
+	if(!JSHotplugReconnectCheck(priv->hotplug))
+	    return(JSNoAccess);
+
+	/* Devices opened by a backend have no device node to look up,
+	 * so they are reopened by the same name
+	 */
+	if(JSDeviceIsBackend(jsd->device_name))
+	    device_name = STRDUP(jsd->device_name);
+	else
+	    device_name = JSHotplugFindDevice(
+		&jsd->identity, jsd->device_name
+	    );
+	if(device_name == NULL)
+	    return(JSNoAccess);
+
+	fd = JSDeviceOpen(device_name, &device);
+	if(fd < 0)
+	{
+	    free(device_name);
+	    return(JSNoAccess);
+	}
+
+#if defined(__linux__)
+	JSDeviceIoctl(fd, device, JSIOCGAXES, &axes);
+	JSDeviceIoctl(fd, device, JSIOCGBUTTONS, &buttons);
+
+	/* Allocate any additional axises */
+	if((int)axes > jsd->total_axises)
+	{
+	    js_axis_struct	*axis,
+				**axis_list = (js_axis_struct **)realloc(
+		jsd->axis, axes * sizeof(js_axis_struct *)
+	    );
+	    if(axis_list != NULL)
+	    {
+		jsd->axis = axis_list;
+		for(i = jsd->total_axises; i < (int)axes; i++)
+		{
+		    jsd->axis[i] = axis = (js_axis_struct *)JSArenaAlloc(
+			&priv->arena, sizeof(js_axis_struct)
+		    );
+		    if(axis == NULL)
+			break;
+
+		    axis->cur = JSDefaultCenter;
+		    axis->min = JSDefaultMin;
+		    axis->max = JSDefaultMax;
+		    axis->cen = JSDefaultCenter;
+		    axis->nz = JSDefaultNullZone;
+		    axis->tolorance = JSDefaultTolorance;
+		}
+		jsd->total_axises = i;
+	    }
+	}
+
+	/* Allocate any additional buttons */
+	if((int)buttons > jsd->total_buttons)
+	{
+	    js_button_struct	*button,
+				**button_list = (js_button_struct **)realloc(
+		jsd->button, buttons * sizeof(js_button_struct *)
+	    );
+	    if(button_list != NULL)
+	    {
+		jsd->button = button_list;
+		for(i = jsd->total_buttons; i < (int)buttons; i++)
+		{
+		    jsd->button[i] = button = (js_button_struct *)JSArenaAlloc(
+			&priv->arena, sizeof(js_button_struct)
+		    );
+		    if(button == NULL)
+			break;
+
+		    button->state = JSButtonStateOff;
+		}
+		jsd->total_buttons = i;
+	    }
+	}
+#endif
+
+	if(jsd->flags & JSFlagNonBlocking)
+	    fcntl(fd, F_SETFL, O_NONBLOCK);
+
+	jsd->fd = fd;
+	priv->device = device;
+	JSPollFDSetDevice(priv->poll_fd, fd, -1);
+	JSStatsDeviceOpened(priv->stats);
+
+	/* The device may now be at a different device node */
+	if((jsd->device_name == NULL) ||
+	   strcmp(jsd->device_name, device_name)
+	)
+	{
+	    free(jsd->device_name);
+	    jsd->device_name = device_name;
+	}
+	else
+	{
+	    free(device_name);
+	}
+	JS_PROBE3(device_open, jsd, jsd->device_name, jsd->fd);
+	JSHotplugDeviceOpened(jsd->device_name);
+
+	JSHotplugReconnectDelete(priv->hotplug);
+	priv->hotplug = NULL;
+
+	/* Set the low-level joystick driver's tolorance again */
+	JSResetAllAxisTolorance(jsd);
+
+	return(JSSuccess);
+}
 
 /*
  *	Called by JSUpdate() to set axis structure value.
@@ -282,15 +840,23 @@ static void SetButtonValue(js_button_struct *button, int value, time_t t)
        /* Set new button state */
        button->state = value ? JSButtonStateOn : JSButtonStateOff;
 
-       /* Update state change */
+       /* Update state change and count the presses and releases
+        * for JSBeginFrame()
+        */
        if((button->prev_state == JSButtonStateOn) &&
 	       (button->state == JSButtonStateOff)
        )
+       {
 	       button->changed_state = JSButtonChangedStateOnToOff;
+	       button->releases++;
+       }
        else if((button->prev_state == JSButtonStateOff) &&
 	       (button->state == JSButtonStateOn)
        )
+       {
 	       button->changed_state = JSButtonChangedStateOffToOn;
+	       button->presses++;
+       }
 
        /* Record time stamp (in ms) */
        button->last_time = button->time;
@@ -300,20 +866,92 @@ static void SetButtonValue(js_button_struct *button, int value, time_t t)
 }
 
 /*
- *	Updates the information in jsd, returns JSGotEvent if there
- *	was some change or JSNoEvent if there was no change.
+ *	Called by JSUpdate() when axis or button number on jsd changed,
+ *	the event is one of JSEvent*.
  *
- *	jsd needs to be previously initialized by a call to
- *	JSInit().
+ *	Adds the event to the event ring and calls the callbacks.
  */
-int JSUpdate(js_data_struct *jsd)
+static void JSEventChanged(
+	js_data_struct *jsd, int event, int number, int value, time_t t
+)
+{
+	const js_private_struct *priv = JS_PRIVATE_DATA(jsd->priv);
+
+	if(priv->event_ring != NULL)
+	{
+	    js_event_struct ev;
+	    ev.type = event;
+	    ev.number = number;
+	    ev.value = value;
+	    ev.time = t;
+	    JSEventRingPush(priv->event_ring, &ev);
+	}
+
+	if((priv->event_callback != NULL) && !priv->close_pending)
+	    JSEventCallbackDispatch(jsd, event, number);
+}
+
+/*
+ *	Called by JSUpdate() to set the value of axis n on jsd and call
+ *	its callbacks if the value changed.
+ */
+static void JSUpdateAxis(js_data_struct *jsd, int n, int value, time_t t)
+{
+	js_axis_struct *axis;
+	const js_private_struct *priv = JS_PRIVATE_DATA(jsd->priv);
+
+	/* Does axis exist? */
+	if(!JSIsAxisAllocated(jsd, n))
+	    return;
+
+	axis = jsd->axis[n];
+	SetAxisValue(axis, value, t);
+
+	if(priv->axis_history != NULL)
+	    JSAxisHistoryAdd(priv->axis_history, n, value, t);
+
+	if(axis->cur != axis->prev)
+	    JSEventChanged(jsd, JSEventAxis, n, axis->cur, t);
+}
+
+/*
+ *	Called by JSUpdate() to set the state of button n on jsd and
+ *	call its callbacks if the state changed.
+ */
+static void JSUpdateButton(js_data_struct *jsd, int n, int value, time_t t)
+{
+	js_button_struct *button;
+
+	/* Does button exist? */
+	if(!JSIsButtonAllocated(jsd, n))
+	    return;
+
+	button = jsd->button[n];
+	SetButtonValue(button, value, t);
+
+	if(button->state != button->prev_state)
+	    JSEventChanged(
+		jsd,
+		(button->state == JSButtonStateOn) ?
+		    JSEventButtonPress : JSEventButtonRelease,
+		n, button->state, t
+	    );
+}
+
+/*
+ *	Called by JSUpdate() to read and handle the events.
+ */
+static int JSDoUpdate(js_data_struct *jsd)
 {
 	int n;
 	int status = JSNoEvent;
+	js_private_struct *priv;
 #if defined(__linux__)
-	int keep_handling = 1;
-	int bytes_read, cycles;
-	struct js_event event;
+	int i, total_events;
+	ssize_t bytes_read;
+	struct js_event event[JS_UPDATE_BATCH], *ev;
+	char coalesced[JS_UPDATE_BATCH];
+	unsigned char axis_seen[256 / 8];
 #elif defined(__FreeBSD__)
 	struct joystick js;
 #endif
@@ -326,9 +964,57 @@ int JSUpdate(js_data_struct *jsd)
 	if(jsd == NULL)
 	    return(status);
 
-	if(jsd->fd < 0)
+	/* Not initialized? */
+	priv = JS_PRIVATE_DATA(jsd->priv);
+	if(priv == NULL)
 	    return(status);
 
+	JS_STATS_ADD(priv->stats, updates, 1);
+
+	/* Device disconnected? Try to re-attach to it if
+	 * JSFlagReconnect is set
+	 */
+	if(jsd->fd < 0)
+	{
+	    if(priv->hotplug == NULL)
+		return(status);
+
+	    if(JSReconnect(jsd) != JSSuccess)
+	    {
+		/* Wake up the event loop when the next attempt is
+		 * due
+		 */
+		if(priv->poll_fd != NULL)
+		    JSPollFDSetDevice(
+			priv->poll_fd, -1,
+			JSHotplugReconnectWaitMS(priv->hotplug)
+		    );
+
+		/* Reset the button state changes made when the device
+		 * was disconnected
+		 */
+		for(n = 0; n < jsd->total_buttons; n++)
+		{
+		    if(jsd->button[n] != NULL)
+			jsd->button[n]->changed_state =
+			    JSButtonChangedStateNone;
+		}
+		return(status);
+	    }
+	}
+
+	/* Apply the calibration being loaded by JSInitAsync() once
+	 * it has been loaded
+	 */
+	if(priv->calibration_loader != NULL)
+	{
+	    if(JSCalibLoaderPoll(priv->calibration_loader, jsd, 0))
+	    {
+		JSCalibLoaderDelete(priv->calibration_loader);
+		priv->calibration_loader = NULL;
+	    }
+	}
+
 #if defined(__linux__) || defined(__FreeBSD__)
 	/* Reset all button state change value on all buttons */
 	for(n = 0, button = jsd->button;
@@ -355,81 +1041,170 @@ int JSUpdate(js_data_struct *jsd)
 #if defined(__linux__)
 	/* Linux joystick device fetching
 	 *
-	 * Handle up to 16 events from joystick driver
+	 * Read up to JS_UPDATE_BATCH events from joystick driver at
+	 * once
 	 */
-	cycles = 0;
-	while(keep_handling &&
-	      (cycles < 16)
-	)
+	bytes_read = read(jsd->fd, event, sizeof(event));
+	JS_STATS_ADD(priv->stats, reads, 1);
+	JS_PROBE2(read_batch, jsd, bytes_read);
+	/* No more events to be read? */
+	if(bytes_read < (ssize_t)sizeof(struct js_event))
 	{
-	    /* Get event */
-	    bytes_read = read(
-	        jsd->fd,
-	        &event,
-	        sizeof(struct js_event)
-	    );
-	    /* No more events to be read? */
-	    if(bytes_read != sizeof(struct js_event))
-	        return(status);
+	    JS_STATS_ADD(priv->stats, empty_reads, 1);
+
+	    /* The device was disconnected? */
+	    if((bytes_read < 0) && (errno == ENODEV) &&
+	       (jsd->flags & JSFlagReconnect)
+	    )
+	    {
+		JSDisconnect(jsd);
+		status = JSGotEvent;
+	    }
+	    return(status);
+	}
+	total_events = (int)(bytes_read / sizeof(struct js_event));
+
+	/* Filled the buffer, more events may still be queued */
+	if(total_events == JS_UPDATE_BATCH)
+	    JS_STATS_ADD(priv->stats, full_reads, 1);
+
+	/* Record the events before any are coalesced */
+	if(priv->recorder != NULL)
+	    JSRecorderAdd(priv->recorder, event, total_events);
+
+	/* Mark all but the last event for each axis in this batch as
+	 * coalesced, button events are never coalesced so that no
+	 * press or release is lost
+	 */
+	memset(coalesced, 0x00, sizeof(coalesced));
+	if((jsd->flags & JSFlagCoalesce) && (total_events > 1))
+	{
+	    memset(axis_seen, 0x00, sizeof(axis_seen));
+	    for(i = total_events - 1; i >= 0; i--)
+	    {
+		ev = &event[i];
+		if((ev->type & ~JS_EVENT_INIT) != JS_EVENT_AXIS)
+		    continue;
+
+		n = ev->number;
+		if(axis_seen[n / 8] & (1 << (n % 8)))
+		    coalesced[i] = 1;
+		else
+		    axis_seen[n / 8] |= (1 << (n % 8));
+	    }
+	}
+
+	for(i = 0; i < total_events; i++)
+	{
+	    ev = &event[i];
+
+	    /* Skip events of an unknown type, the events after them
+	     * in this batch are still handled
+	     */
+	    n = ev->type & ~JS_EVENT_INIT;
+	    if((n != JS_EVENT_AXIS) && (n != JS_EVENT_BUTTON))
+		continue;
+
+	    jsd->events_received++;	/* Increment events recv count */
+	    status = JSGotEvent;	/* Mark that we got event */
+	    JSStatsAddEvent(priv->stats, ev->type, ev->number);
+
+	    /* Superseded by a later event for the same axis? */
+	    if(coalesced[i])
+	    {
+		JS_STATS_ADD(priv->stats, events_coalesced, 1);
+		continue;
+	    }
+
+	    /* Record the latency of the events from the device, the
+	     * init events only report its state
+	     */
+	    if((priv->latency != NULL) && !(ev->type & JS_EVENT_INIT))
+		JSLatencyApplied(priv->latency, (unsigned int)ev->time);
 
 	    /* Handle by event type */
-	    switch(event.type & ~JS_EVENT_INIT)
+	    switch(ev->type & ~JS_EVENT_INIT)
 	    {
 	      /* Axis event */
 	      case JS_EVENT_AXIS:
-	        /* Get axis number */
-		n = event.number;
-
-		/* Does axis exist? */
-		if(JSIsAxisAllocated(jsd, n))
-		    SetAxisValue(
-			jsd->axis[n],
-			(int)event.value,
-			(time_t)event.time
-		    );
-		jsd->events_received++;	/* Increment events recv count */
-	        status = JSGotEvent;	/* Mark that we got event */
-	        break;
+		JSUpdateAxis(
+		    jsd, ev->number,
+		    (int)ev->value, (time_t)ev->time
+		);
+		break;
 
 	      /* Button event */
 	      case JS_EVENT_BUTTON:
-	        /* Get button number */
-	        n = event.number;
-
-	        /* Does button exist? */
-		if(JSIsButtonAllocated(jsd, n))
-		    SetButtonValue(
-			jsd->button[n],
-			(int)event.value, (time_t)event.time
-		    );
-		jsd->events_received++;	/* Increment events recv count */
-	        status = JSGotEvent;	/* Mark that we got event */
-	        break;
-
-	      /* Other event */
-	      default:
-		keep_handling = 0;	/* Stop handling events */
+		JSUpdateButton(
+		    jsd, ev->number,
+		    (int)ev->value, (time_t)ev->time
+		);
 		break;
 	    }
-
-	    cycles++;
 	}
 #elif defined(__FreeBSD__)
 	/* FreeBSD joystick device fetching */
-	if(read(jsd->fd, &js, sizeof(struct joystick)) == sizeof(struct joystick))
+	JS_STATS_ADD(priv->stats, reads, 1);
+	n = (int)read(jsd->fd, &js, sizeof(struct joystick));
+	JS_PROBE2(read_batch, jsd, n);
+	if(n == sizeof(struct joystick))
 	{
+	    JS_STATS_ADD(priv->stats, events, 1);
 	    status = JSGotEvent;
-	    if(JSIsAxisAllocated(jsd, 0))
-		SetAxisValue(jsd->axis[0], js.x, time(NULL));
-	    if(JSIsAxisAllocated(jsd, 1))
-		SetAxisValue(jsd->axis[1], js.y, time(NULL));
-	    if(JSIsButtonAllocated(jsd, 0))
-		SetButtonValue(jsd->button[0], js.b1, time(NULL));
-	    if(JSIsButtonAllocated(jsd, 1))
-		SetButtonValue(jsd->button[1], js.b2, time(NULL));
+	    JSUpdateAxis(jsd, 0, js.x, time(NULL));
+	    JSUpdateAxis(jsd, 1, js.y, time(NULL));
+	    JSUpdateButton(jsd, 0, js.b1, time(NULL));
+	    JSUpdateButton(jsd, 1, js.b2, time(NULL));
 	}
 #endif
 
+	/* Stop backing off in JSPollModeIdle */
+	if((status == JSGotEvent) && (priv->poll_policy != NULL))
+	    JSPollPolicyGotEvent(priv->poll_policy);
+
+	return(status);
+}
+
+/*
+ *	Updates the information in jsd, returns JSGotEvent if there
+ *	was some change or JSNoEvent if there was no change.
+ *
+ *	jsd needs to be previously initialized by a call to
+ *	JSInit().
+ */
+int JSUpdate(js_data_struct *jsd)
+{
+	int status;
+	js_private_struct *priv = (jsd != NULL) ?
+	    JS_PRIVATE_DATA(jsd->priv) : NULL;
+#if defined(JS_PROBES)
+	const unsigned int events = (jsd != NULL) ? jsd->events_received : 0;
+#endif
+
+	if(priv != NULL)
+	    priv->updating++;
+
+#if defined(JS_PROBES)
+	JS_PROBE1(update_entry, jsd);
+	status = JSDoUpdate(jsd);
+	JS_PROBE3(
+	    update_return, jsd, status,
+	    (jsd != NULL) ? (jsd->events_received - events) : 0
+	);
+#else
+	status = JSDoUpdate(jsd);
+#endif
+
+	/* Close the joystick now if an event callback called
+	 * JSClose()
+	 */
+	if(priv != NULL)
+	{
+	    priv->updating--;
+	    if((priv->updating == 0) && priv->close_pending)
+		JSClose(jsd);
+	}
+
 	return(status);
 }
 
@@ -437,14 +1212,80 @@ int JSUpdate(js_data_struct *jsd)
  *	Closes the joystick and deallocates all resources on the given
  *	jsd structure. The jsd structure itself is not deallocated however
  *	its values will be reset to defaults.
+ *
+ *	If this is called by an event callback then the joystick is
+ *	closed when JSUpdate() returns, since JSUpdate() is still using
+ *	it.
  */
 void JSClose(js_data_struct *jsd)
 {
 	int i;
+	js_private_struct none, *priv;
 
 	if(jsd == NULL)
 	    return;
 
+	/* The private data is not allocated if the jsd was never
+	 * initialized
+	 */
+	priv = JS_PRIVATE_DATA(jsd->priv);
+	if(priv == NULL)
+	{
+	    memset(&none, 0x00, sizeof(js_private_struct));
+	    priv = &none;
+	}
+
+	/* Called by an event callback during JSUpdate()? */
+	if(priv->updating > 0)
+	{
+	    priv->close_pending = 1;
+	    return;
+	}
+
+	/* Stop the reader thread before anything it uses is
+	 * deleted
+	 */
+	JSPollPolicyDelete(priv->poll_policy);
+	priv->poll_policy = NULL;
+
+	/* Stop loading the calibration, this must be done before
+	 * the joystick is closed
+	 */
+	JSCalibLoaderDelete(priv->calibration_loader);
+	priv->calibration_loader = NULL;
+
+	/* Delete the reconnect state */
+	JSHotplugReconnectDelete(priv->hotplug);
+	priv->hotplug = NULL;
+
+	/* Delete the poll descriptor */
+	JSPollFDDelete(priv->poll_fd);
+	priv->poll_fd = NULL;
+
+	/* Delete the event ring */
+	JSEventRingDelete(priv->event_ring);
+	priv->event_ring = NULL;
+
+	/* Delete the statistics */
+	JSStatsDelete(priv->stats);
+	priv->stats = NULL;
+
+	/* Stop recording */
+	JSRecorderDelete(priv->recorder);
+	priv->recorder = NULL;
+
+	/* Delete the latency histograms */
+	JSLatencyDelete(priv->latency);
+	priv->latency = NULL;
+
+	/* Delete the axis histories */
+	JSAxisHistoryDelete(priv->axis_history);
+	priv->axis_history = NULL;
+
+	/* Delete the event callbacks */
+	JSEventCallbackDelete(priv->event_callback);
+	priv->event_callback = NULL;
+
 	/* Delete the force feedback resources */
 	JSFFDelete(jsd->force_feedback);
 	jsd->force_feedback = NULL;
@@ -452,27 +1293,37 @@ void JSClose(js_data_struct *jsd)
 	/* Close the joystick */
 	if(jsd->fd > -1)
 	{
-	    close(jsd->fd);
-	    jsd->fd = -1;
+	    JS_PROBE3(device_close, jsd, jsd->device_name, jsd->fd);
+	    JSHotplugDeviceClosed(jsd->device_name);
 	}
+	JSDeviceClose(jsd->fd, priv->device);
+	jsd->fd = -1;
+	priv->device = NULL;
 
 	free(jsd->name);
 	jsd->name = NULL;
 
-	/* Delete all axises */
+	/* Delete all axises, the ones allocated from the arena are
+	 * deleted with the arena
+	 */
 	for(i = 0; i < jsd->total_axises; i++)
-	    free(jsd->axis[i]);
+	    JSArenaFree(priv->arena, jsd->axis[i]);
 	free(jsd->axis);
 	jsd->axis = NULL;
 	jsd->total_axises = 0;
 
 	/* Delete all buttons */
 	for(i = 0; i < jsd->total_buttons; i++)
-	    free(jsd->button[i]);
+	    JSArenaFree(priv->arena, jsd->button[i]);
 	free(jsd->button);
 	jsd->button = NULL;
 	jsd->total_buttons = 0;
 
+	/* Delete the arena and the private data */
+	JSArenaDelete(priv->arena);
+	free(jsd->priv);
+	jsd->priv = NULL;
+
 	/* Delete device name */
 	free(jsd->device_name);
 	jsd->device_name = NULL;
@@ -481,6 +1332,9 @@ void JSClose(js_data_struct *jsd)
 	free(jsd->calibration_file);
 	jsd->calibration_file = NULL;
 
+	/* Delete identity */
+	JSIdentityClear(&jsd->identity);
+
 	/* Reset rest of the values */
 	jsd->flags = 0;
 	jsd->driver_version = 0;
@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#if defined(__linux__)
+# include <sys/epoll.h>
+# include <sys/timerfd.h>
+#endif
+
+#include "../include/jsw.h"
+
+#include "hotplug.h"
+#include "pollfd.h"
+#include "pollpolicy.h"
+#include "private.h"
+
+
+/*
+ *	Poll Descriptor:
+ *
+ *	Allocated on a jsd by JSGetPollFD() when JSFlagReconnect is
+ *	set, since the device's descriptor changes each time the
+ *	device is reconnected.
+ *
+ *	The epoll descriptor stays the same for the life of the jsd,
+ *	it contains the device's descriptor while connected and a timer
+ *	that expires when JSUpdate() should try to reconnect while
+ *	disconnected.
+ */
+typedef struct {
+
+	int		epoll_fd,
+			timer_fd,
+			device_fd;	/* Device descriptor in epoll_fd
+					 * or -1 */
+
+} js_poll_fd_struct;
+
+
+void *JSPollFDNew(int fd);
+int JSPollFDGet(void *ptr);
+void JSPollFDSetDevice(void *ptr, int fd, int wait_ms);
+void JSPollFDDelete(void *ptr);
+
+int JSGetPollFD(js_data_struct *jsd);
+
+
+/*
+ *	Allocates a new Poll Descriptor for the device descriptor fd,
+ *	fd can be -1 if the device is disconnected.
+ *
+ *	Returns NULL on error.
+ */
+void *JSPollFDNew(int fd)
+{
+#if defined(__linux__)
+	struct epoll_event ev;
+	js_poll_fd_struct *pfd = (js_poll_fd_struct *)malloc(
+	    sizeof(js_poll_fd_struct)
+	);
+	if(pfd == NULL)
+	    return(NULL);
+
+	pfd->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	pfd->timer_fd = timerfd_create(
+	    CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC
+	);
+	pfd->device_fd = -1;
+	if((pfd->epoll_fd < 0) || (pfd->timer_fd < 0))
+	{
+	    JSPollFDDelete(pfd);
+	    return(NULL);
+	}
+
+	memset(&ev, 0x00, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = pfd->timer_fd;
+	if(epoll_ctl(pfd->epoll_fd, EPOLL_CTL_ADD, pfd->timer_fd, &ev))
+	{
+	    JSPollFDDelete(pfd);
+	    return(NULL);
+	}
+
+	JSPollFDSetDevice(pfd, fd, -1);
+
+	return(pfd);
+#else
+	return(NULL);
+#endif
+}
+
+/*
+ *	Returns the epoll descriptor.
+ */
+int JSPollFDGet(void *ptr)
+{
+	js_poll_fd_struct *pfd = (js_poll_fd_struct *)ptr;
+	return((pfd != NULL) ? pfd->epoll_fd : -1);
+}
+
+/*
+ *	Sets the device descriptor, must be called with -1 before the
+ *	device's descriptor is closed.
+ *
+ *	If wait_ms is not negative then the timer is set to expire in
+ *	wait_ms milliseconds, otherwise it is stopped. Any expiration
+ *	of the timer is cleared.
+ */
+void JSPollFDSetDevice(void *ptr, int fd, int wait_ms)
+{
+#if defined(__linux__)
+	unsigned long long expirations;
+	struct epoll_event ev;
+	struct itimerspec its;
+	js_poll_fd_struct *pfd = (js_poll_fd_struct *)ptr;
+	if(pfd == NULL)
+	    return;
+
+	if(fd != pfd->device_fd)
+	{
+	    if(pfd->device_fd > -1)
+		epoll_ctl(
+		    pfd->epoll_fd, EPOLL_CTL_DEL, pfd->device_fd, NULL
+		);
+	    pfd->device_fd = -1;
+
+	    if(fd > -1)
+	    {
+		memset(&ev, 0x00, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.fd = fd;
+		if(!epoll_ctl(pfd->epoll_fd, EPOLL_CTL_ADD, fd, &ev))
+		    pfd->device_fd = fd;
+	    }
+	}
+
+	/* Clear the expiration and set the timer, a value of 0 stops
+	 * the timer so expire in at least 1 ms
+	 */
+	while(read(pfd->timer_fd, &expirations, sizeof(expirations)) > 0);
+
+	memset(&its, 0x00, sizeof(its));
+	if(wait_ms > -1)
+	{
+	    if(wait_ms == 0)
+		wait_ms = 1;
+	    its.it_value.tv_sec = wait_ms / 1000;
+	    its.it_value.tv_nsec = (long)(wait_ms % 1000) * 1000000l;
+	}
+	timerfd_settime(pfd->timer_fd, 0, &its, NULL);
+#endif
+}
+
+/*
+ *	Deletes the Poll Descriptor, the device's descriptor is not
+ *	closed.
+ */
+void JSPollFDDelete(void *ptr)
+{
+	js_poll_fd_struct *pfd = (js_poll_fd_struct *)ptr;
+	if(pfd == NULL)
+	    return;
+
+	if(pfd->timer_fd > -1)
+	    close(pfd->timer_fd);
+	if(pfd->epoll_fd > -1)
+	    close(pfd->epoll_fd);
+	free(pfd);
+}
+
+
+/*
+ *	Returns a descriptor that becomes readable when JSUpdate()
+ *	should be called, for use with select(), poll(), epoll or
+ *	other event loops.
+ *
+ *	If JSFlagReconnect is not set then this is the device's
+ *	descriptor. Otherwise it is an epoll descriptor that stays the
+ *	same when the device is disconnected and reconnected.
+ *
+ *	While the reader thread started by JSReaderStart() is running
+ *	this is its event descriptor instead, since the thread reads
+ *	the device.
+ *
+ *	Returns -1 on error or if the joystick is not initialized.
+ */
+int JSGetPollFD(js_data_struct *jsd)
+{
+	int fd;
+	js_private_struct *priv;
+
+	if(jsd == NULL)
+	    return(-1);
+
+	fd = JSPollPolicyGetFD(JS_PRIVATE(jsd)->poll_policy);
+	if(fd > -1)
+	    return(fd);
+
+	if(!(jsd->flags & JSFlagReconnect))
+	    return(jsd->fd);
+
+	/* Not initialized? */
+	priv = JS_PRIVATE_DATA(jsd->priv);
+	if(priv == NULL)
+	    return(-1);
+
+	if(priv->poll_fd == NULL)
+	{
+	    /* Not initialized and not disconnected? */
+	    if((jsd->fd < 0) && (priv->hotplug == NULL))
+		return(-1);
+
+	    priv->poll_fd = JSPollFDNew(jsd->fd);
+	    if(priv->poll_fd == NULL)
+		return(jsd->fd);
+
+	    /* Disconnected, wake up when the next attempt to
+	     * reconnect is due
+	     */
+	    if(jsd->fd < 0)
+		JSPollFDSetDevice(
+		    priv->poll_fd, -1,
+		    JSHotplugReconnectWaitMS(priv->hotplug)
+		);
+	}
+
+	return(JSPollFDGet(priv->poll_fd));
+}
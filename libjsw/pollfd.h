@@ -0,0 +1,14 @@
+#ifndef POLLFD_H
+#define POLLFD_H
+
+#include <sys/types.h>
+#include "../include/jsw.h"
+
+
+extern void *JSPollFDNew(int fd);
+extern int JSPollFDGet(void *ptr);
+extern void JSPollFDSetDevice(void *ptr, int fd, int wait_ms);
+extern void JSPollFDDelete(void *ptr);
+
+
+#endif	/* POLLFD_H */
@@ -0,0 +1,492 @@
+#if defined(__linux__)
+/* For the CPU affinity of the reader thread */
+# define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <sys/types.h>
+#if defined(__linux__)
+# include <sys/eventfd.h>
+#endif
+
+#include "../include/jsw.h"
+
+#include "hotplug.h"
+#include "pollpolicy.h"
+#include "utils.h"
+#include "private.h"
+
+
+/*
+ *	Poll Policy:
+ *
+ *	Allocated on a jsd by JSSetPollPolicy() or JSReaderStart().
+ */
+typedef struct {
+
+	js_poll_policy_struct	policy;
+
+	/* JSPollModeIdle backoff */
+	unsigned long	last_event_ms;	/* Time of the last event */
+	int		interval_ms;	/* Current wait or 0 if not
+					 * backing off */
+
+	/* Reader thread */
+	js_data_struct	*jsd;
+	pthread_t	thread;
+	int		running;
+	int		stop_fd[2];	/* Written to by JSReaderStop() */
+	int		event_fd;	/* Signaled by the thread after
+					 * each JSUpdate() or -1 */
+	js_poll_policy_struct	reader_policy;	/* Policy the thread
+						 * runs with */
+
+} js_poll_policy_data_struct;
+#define JS_POLL_POLICY_DATA(p)	((js_poll_policy_data_struct *)(p))
+
+
+static js_poll_policy_data_struct *JSPollPolicyGet(js_data_struct *jsd);
+int JSPollPolicyWaitMS(void *ptr, int timeout_ms);
+int JSPollPolicyIsBusy(void *ptr);
+void JSPollPolicyGotEvent(void *ptr);
+int JSPollPolicyGetFD(void *ptr);
+void JSPollPolicyDelete(void *ptr);
+static void *JSReaderThread(void *data);
+static int JSReaderCreate(
+	js_poll_policy_data_struct *pp, int realtime, int affinity
+);
+
+int JSSetPollPolicy(
+	js_data_struct *jsd, const js_poll_policy_struct *policy
+);
+int JSReaderStart(js_data_struct *jsd);
+int JSGetReaderPolicy(
+	js_data_struct *jsd, js_poll_policy_struct *policy
+);
+void JSReaderStop(js_data_struct *jsd);
+
+
+#define MAX(a,b)        (((a) > (b)) ? (a) : (b))
+#define MIN(a,b)        (((a) < (b)) ? (a) : (b))
+
+
+/*
+ *	Returns the jsd's Poll Policy, it is allocated with
+ *	JSPollModeDefault on the first call.
+ *
+ *	Returns NULL on error.
+ */
+static js_poll_policy_data_struct *JSPollPolicyGet(js_data_struct *jsd)
+{
+	js_poll_policy_data_struct *pp;
+	js_private_struct *priv = JSPrivateGet(jsd);
+	if(priv == NULL)
+	    return(NULL);
+
+	pp = JS_POLL_POLICY_DATA(priv->poll_policy);
+	if(pp != NULL)
+	    return(pp);
+
+	pp = JS_POLL_POLICY_DATA(calloc(1, sizeof(js_poll_policy_data_struct)));
+	if(pp == NULL)
+	    return(NULL);
+
+	pp->policy.mode = JSPollModeDefault;
+	pp->policy.cpu = -1;
+	pp->last_event_ms = JSCurrentNS() / 1000000;
+	pp->jsd = jsd;
+	pp->stop_fd[0] = -1;
+	pp->stop_fd[1] = -1;
+	pp->event_fd = -1;
+
+	priv->poll_policy = pp;
+
+	return(pp);
+}
+
+/*
+ *	Called by JSWaitEvent() and JSWaitEventMany() to get how long
+ *	to wait instead of timeout_ms.
+ *
+ *	In JSPollModeIdle the wait is doubled on each call once there
+ *	have been no events for idle_quiet_ms, up to idle_max_ms. The
+ *	wait still ends as soon as there is an event.
+ */
+int JSPollPolicyWaitMS(void *ptr, int timeout_ms)
+{
+	int quiet_ms, max_ms;
+	js_poll_policy_data_struct *pp = JS_POLL_POLICY_DATA(ptr);
+
+	if((pp == NULL) || (pp->policy.mode != JSPollModeIdle) ||
+	   (timeout_ms < 0)
+	)
+	    return(timeout_ms);
+
+	quiet_ms = (pp->policy.idle_quiet_ms > 0) ?
+	    pp->policy.idle_quiet_ms : JSDefaultPollIdleQuietMS;
+	max_ms = (pp->policy.idle_max_ms > 0) ?
+	    pp->policy.idle_max_ms : JSDefaultPollIdleMaxMS;
+
+	/* Not quiet for long enough? */
+	if(((JSCurrentNS() / 1000000) - pp->last_event_ms) <
+	   (unsigned long)quiet_ms
+	)
+	{
+	    pp->interval_ms = 0;
+	    return(timeout_ms);
+	}
+
+	if(pp->interval_ms <= 0)
+	    pp->interval_ms = MAX(timeout_ms, 1);
+	else
+	    pp->interval_ms = MIN(pp->interval_ms * 2, max_ms);
+
+	return(MAX(timeout_ms, pp->interval_ms));
+}
+
+/*
+ *	Checks if JSWaitEvent() and JSWaitEventMany() should busy-poll.
+ */
+int JSPollPolicyIsBusy(void *ptr)
+{
+	js_poll_policy_data_struct *pp = JS_POLL_POLICY_DATA(ptr);
+	return((pp != NULL) && (pp->policy.mode == JSPollModeLatency));
+}
+
+/*
+ *	Called by JSUpdate() when it got events, stops backing off.
+ */
+void JSPollPolicyGotEvent(void *ptr)
+{
+	js_poll_policy_data_struct *pp = JS_POLL_POLICY_DATA(ptr);
+	if((pp == NULL) || (pp->policy.mode != JSPollModeIdle))
+	    return;
+
+	pp->last_event_ms = JSCurrentNS() / 1000000;
+	pp->interval_ms = 0;
+}
+
+/*
+ *	Returns the descriptor signaled by the reader thread or -1 if
+ *	the thread is not running.
+ */
+int JSPollPolicyGetFD(void *ptr)
+{
+	js_poll_policy_data_struct *pp = JS_POLL_POLICY_DATA(ptr);
+	if((pp == NULL) || !pp->running)
+	    return(-1);
+
+	return(pp->event_fd);
+}
+
+/*
+ *	Stops the reader thread and deletes the Poll Policy.
+ */
+void JSPollPolicyDelete(void *ptr)
+{
+	js_poll_policy_data_struct *pp = JS_POLL_POLICY_DATA(ptr);
+	if(pp == NULL)
+	    return;
+
+	JSReaderStop(pp->jsd);
+	free(pp);
+}
+
+
+/*
+ *	Reader thread, calls JSUpdate() whenever the device has events
+ *	until JSReaderStop() is called and signals the event descriptor
+ *	after each call.
+ *
+ *	In JSPollModeLatency the device is polled without ever
+ *	sleeping, otherwise the thread sleeps until there are events
+ *	or a reconnect attempt is due.
+ */
+static void *JSReaderThread(void *data)
+{
+	int n, wait_ms;
+	const uint64_t one = 1;
+	struct pollfd pfd[2];
+	js_poll_policy_data_struct *pp = JS_POLL_POLICY_DATA(data);
+	js_data_struct *jsd = pp->jsd;
+	const int busy = (pp->policy.mode == JSPollModeLatency);
+
+	pfd[1].fd = pp->stop_fd[0];
+	pfd[1].events = POLLIN;
+
+	for(;;)
+	{
+	    pfd[0].fd = jsd->fd;
+	    pfd[0].events = POLLIN;
+	    pfd[0].revents = 0;
+	    pfd[1].revents = 0;
+
+	    /* Disconnected, wake up for the next reconnect attempt */
+	    if((jsd->fd < 0) && (JS_PRIVATE(jsd)->hotplug != NULL))
+		wait_ms = JSHotplugReconnectWaitMS(JS_PRIVATE(jsd)->hotplug);
+	    else
+		wait_ms = -1;
+
+	    n = poll(pfd, 2, busy ? 0 : wait_ms);
+	    if(n < 0)
+	    {
+		if(errno == EINTR)
+		    continue;
+		break;
+	    }
+
+	    /* JSReaderStop() was called? */
+	    if(pfd[1].revents)
+		break;
+
+	    if(pfd[0].revents || (wait_ms == 0) ||
+	       ((n == 0) && !busy && (wait_ms > 0))
+	    )
+	    {
+		JSUpdate(jsd);
+		if(pp->event_fd > -1)
+		    while((write(pp->event_fd, &one, sizeof(one)) < 0) &&
+			  (errno == EINTR));
+
+		/* The device was lost and will not be reconnected */
+		if((pfd[0].revents & (POLLERR | POLLHUP | POLLNVAL)) &&
+		   !(jsd->flags & JSFlagReconnect)
+		)
+		    break;
+	    }
+	    else if(busy)
+	    {
+		JS_CPU_RELAX();
+	    }
+	}
+
+	return(NULL);
+}
+
+/*
+ *	Creates the reader thread, with the SCHED_FIFO priority if
+ *	realtime is true and on the CPU if affinity is true.
+ *
+ *	Returns the error from pthread_create().
+ */
+static int JSReaderCreate(
+	js_poll_policy_data_struct *pp, int realtime, int affinity
+)
+{
+	int status;
+	pthread_attr_t attr;
+	struct sched_param param;
+#if defined(__linux__)
+	cpu_set_t cpus;
+#endif
+
+	status = pthread_attr_init(&attr);
+	if(status)
+	    return(status);
+
+	if(realtime)
+	{
+	    memset(&param, 0x00, sizeof(param));
+	    param.sched_priority = pp->policy.priority;
+	    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	    pthread_attr_setschedparam(&attr, &param);
+	}
+
+#if defined(__linux__)
+	if(affinity)
+	{
+	    CPU_ZERO(&cpus);
+	    CPU_SET(pp->policy.cpu, &cpus);
+	    pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+	}
+#endif
+
+	status = pthread_create(&pp->thread, &attr, JSReaderThread, pp);
+	pthread_attr_destroy(&attr);
+
+	return(status);
+}
+
+
+/*
+ *	Sets how JSWaitEvent(), JSWaitEventMany() and the reader
+ *	thread wait for events on the jsd, if policy is NULL then
+ *	JSPollModeDefault is set.
+ *
+ *	This must be called from the thread that calls JSUpdate() and
+ *	not while the reader thread is running.
+ */
+int JSSetPollPolicy(
+	js_data_struct *jsd, const js_poll_policy_struct *policy
+)
+{
+	js_poll_policy_data_struct *pp;
+
+	if(!JSIsInit(jsd))
+	    return(JSBadValue);
+
+	if((policy != NULL) &&
+	   ((policy->mode < JSPollModeDefault) ||
+	    (policy->mode > JSPollModeLatency))
+	)
+	    return(JSBadValue);
+
+	pp = JSPollPolicyGet(jsd);
+	if(pp == NULL)
+	    return(JSNoBuffers);
+
+	if(pp->running)
+	    return(JSError);
+
+	if(policy != NULL)
+	{
+	    memcpy(&pp->policy, policy, sizeof(js_poll_policy_struct));
+	}
+	else
+	{
+	    memset(&pp->policy, 0x00, sizeof(js_poll_policy_struct));
+	    pp->policy.mode = JSPollModeDefault;
+	    pp->policy.cpu = -1;
+	}
+	pp->last_event_ms = JSCurrentNS() / 1000000;
+	pp->interval_ms = 0;
+
+	return(JSSuccess);
+}
+
+/*
+ *	Starts a thread that calls JSUpdate() on the jsd whenever it
+ *	has events, as set by the jsd's Poll Policy.
+ *
+ *	If the SCHED_FIFO priority or the CPU of JSPollModeLatency
+ *	cannot be set then the thread runs without them, the policy
+ *	that it runs with is returned by JSGetReaderPolicy().
+ */
+int JSReaderStart(js_data_struct *jsd)
+{
+	int status, realtime, affinity;
+	js_poll_policy_data_struct *pp;
+
+	if(!JSIsInit(jsd))
+	    return(JSBadValue);
+
+	pp = JSPollPolicyGet(jsd);
+	if(pp == NULL)
+	    return(JSNoBuffers);
+
+	if(pp->running)
+	    return(JSSuccess);
+
+	if(pipe(pp->stop_fd))
+	{
+	    pp->stop_fd[0] = -1;
+	    pp->stop_fd[1] = -1;
+	    return(JSError);
+	}
+#if defined(__linux__)
+	pp->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+
+	realtime = (pp->policy.mode == JSPollModeLatency) &&
+	    (pp->policy.priority > 0);
+	affinity = (pp->policy.mode == JSPollModeLatency) &&
+	    (pp->policy.cpu > -1);
+
+	status = JSReaderCreate(pp, realtime, affinity);
+	if(status && realtime)
+	{
+	    realtime = 0;
+	    status = JSReaderCreate(pp, realtime, affinity);
+	}
+	if(status && affinity)
+	{
+	    affinity = 0;
+	    status = JSReaderCreate(pp, realtime, affinity);
+	}
+	if(status)
+	{
+	    close(pp->stop_fd[0]);
+	    close(pp->stop_fd[1]);
+	    pp->stop_fd[0] = -1;
+	    pp->stop_fd[1] = -1;
+	    if(pp->event_fd > -1)
+	    {
+		close(pp->event_fd);
+		pp->event_fd = -1;
+	    }
+	    return(JSError);
+	}
+
+	/* Record what the thread got */
+	memcpy(&pp->reader_policy, &pp->policy, sizeof(js_poll_policy_struct));
+	if(!realtime)
+	    pp->reader_policy.priority = 0;
+	if(!affinity)
+	    pp->reader_policy.cpu = -1;
+
+	pp->running = 1;
+
+	return(JSSuccess);
+}
+
+/*
+ *	Gets the Poll Policy that the reader thread runs with, the
+ *	priority is 0 and the cpu is -1 if they could not be set by
+ *	JSReaderStart().
+ */
+int JSGetReaderPolicy(
+	js_data_struct *jsd, js_poll_policy_struct *policy
+)
+{
+	js_poll_policy_data_struct *pp;
+
+	if((jsd == NULL) || (policy == NULL))
+	    return(JSBadValue);
+
+	pp = JS_POLL_POLICY_DATA(JS_PRIVATE(jsd)->poll_policy);
+	if((pp == NULL) || !pp->running)
+	    return(JSError);
+
+	memcpy(policy, &pp->reader_policy, sizeof(js_poll_policy_struct));
+
+	return(JSSuccess);
+}
+
+/*
+ *	Stops the reader thread and waits for it to exit.
+ */
+void JSReaderStop(js_data_struct *jsd)
+{
+	char c = 0;
+	js_poll_policy_data_struct *pp;
+
+	if(jsd == NULL)
+	    return;
+
+	pp = JS_POLL_POLICY_DATA(JS_PRIVATE(jsd)->poll_policy);
+	if((pp == NULL) || !pp->running)
+	    return;
+
+	while((write(pp->stop_fd[1], &c, 1) < 0) && (errno == EINTR));
+	pthread_join(pp->thread, NULL);
+
+	close(pp->stop_fd[0]);
+	close(pp->stop_fd[1]);
+	pp->stop_fd[0] = -1;
+	pp->stop_fd[1] = -1;
+	if(pp->event_fd > -1)
+	{
+	    close(pp->event_fd);
+	    pp->event_fd = -1;
+	}
+	pp->running = 0;
+}
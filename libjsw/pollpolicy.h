@@ -0,0 +1,15 @@
+#ifndef POLLPOLICY_H
+#define POLLPOLICY_H
+
+#include <sys/types.h>
+#include "../include/jsw.h"
+
+
+extern int JSPollPolicyWaitMS(void *ptr, int timeout_ms);
+extern int JSPollPolicyIsBusy(void *ptr);
+extern void JSPollPolicyGotEvent(void *ptr);
+extern int JSPollPolicyGetFD(void *ptr);
+extern void JSPollPolicyDelete(void *ptr);
+
+
+#endif	/* POLLPOLICY_H */
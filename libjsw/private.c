@@ -0,0 +1,47 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "../include/jsw.h"
+
+#include "arena.h"
+#include "private.h"
+
+
+const js_private_struct js_private_none;
+
+js_private_struct *JSPrivateGet(js_data_struct *jsd);
+void *JSPrivateAlloc(js_data_struct *jsd, size_t size);
+
+
+/*
+ *	Returns the jsd's Private Joystick Data, it is allocated with
+ *	all of its members NULL on the first call.
+ *
+ *	Returns NULL on error.
+ */
+js_private_struct *JSPrivateGet(js_data_struct *jsd)
+{
+	if(jsd == NULL)
+	    return(NULL);
+
+	if(jsd->priv == NULL)
+	    jsd->priv = calloc(1, sizeof(js_private_struct));
+
+	return(JS_PRIVATE_DATA(jsd->priv));
+}
+
+/*
+ *	Allocates size bytes from the jsd's arena, see JSArenaAlloc().
+ *
+ *	Returns NULL on error.
+ */
+void *JSPrivateAlloc(js_data_struct *jsd, size_t size)
+{
+	js_private_struct *priv = JSPrivateGet(jsd);
+	if(priv == NULL)
+	    return(NULL);
+
+	return(JSArenaAlloc(&priv->arena, size));
+}
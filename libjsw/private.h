@@ -0,0 +1,70 @@
+#ifndef PRIVATE_H
+#define PRIVATE_H
+
+#include <sys/types.h>
+#include "../include/jsw.h"
+
+
+/*
+ *	Private Joystick Data:
+ *
+ *	The jsd's state that is not part of js_data_struct, so that
+ *	it can grow without changing the structure's layout. It is
+ *	allocated by JSInit() or by the first call to JSPrivateGet()
+ *	and deleted by JSClose().
+ */
+typedef struct {
+
+	void		*calibration_loader;	/* Calibration being loaded
+						 * by JSInitAsync(), can be
+						 * NULL */
+	void		*arena;		/* Axises and buttons are allocated
+					 * from this arena */
+	void		*hotplug;	/* Reconnect state while the
+					 * device is disconnected, can be
+					 * NULL */
+	void		*event_callback;	/* Callbacks added by
+						 * JSAddEventCallback(), can
+						 * be NULL */
+	void		*poll_fd;	/* Descriptor returned by
+					 * JSGetPollFD(), can be NULL */
+	void		*event_ring;	/* Events for the readers set up
+					 * by JSEventReaderInit(), can be
+					 * NULL */
+	void		*stats;		/* Counters returned by
+					 * JSGetStats() */
+	void		*latency;	/* Histograms returned by
+					 * JSGetLatency(), NULL unless
+					 * JSFlagLatency is set */
+	void		*device;	/* Device backend, NULL for a
+					 * device node */
+	void		*recorder;	/* Recording started by
+					 * JSRecordStart(), can be NULL */
+	void		*poll_policy;	/* Set by JSSetPollPolicy() or
+					 * JSReaderStart(), can be NULL */
+	void		*axis_history;	/* Samples kept for the axises
+					 * set by JSSetAxisHistory(), can
+					 * be NULL */
+
+	int		updating,	/* JSUpdate() calls in progress */
+			close_pending;	/* JSClose() was called by an
+					 * event callback */
+
+} js_private_struct;
+#define JS_PRIVATE_DATA(p)	((js_private_struct *)(p))
+
+/*
+ *	Returns the jsd's Private Joystick Data for reading, all of
+ *	its members are NULL if it is not allocated.
+ */
+#define JS_PRIVATE(jsd)		(((jsd)->priv != NULL) ?	\
+	(const js_private_struct *)(jsd)->priv : &js_private_none)
+
+
+extern const js_private_struct js_private_none;
+
+extern js_private_struct *JSPrivateGet(js_data_struct *jsd);
+extern void *JSPrivateAlloc(js_data_struct *jsd, size_t size);
+
+
+#endif	/* PRIVATE_H */
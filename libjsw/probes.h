@@ -0,0 +1,47 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+
+/*
+ *	Static Tracepoints:
+ *
+ *	USDT probes of the libjsw provider. When SystemTap's
+ *	<sys/sdt.h> is available each probe is a nop instruction with
+ *	a .note.stapsdt note that perf, bpftrace and SystemTap attach
+ *	to at run time, for example:
+ *
+ *	bpftrace -e 'usdt:/usr/lib/libjsw.so:libjsw:update_return
+ *	    { @events = hist(arg2); }'
+ *
+ *	Otherwise, or if JS_NO_PROBES is defined, the probes expand to
+ *	nothing and their arguments are not evaluated.
+ *
+ *	update_entry(jsd)
+ *	update_return(jsd, status, events)
+ *	read_batch(jsd, bytes_read)
+ *	calibration_start(jsd, calibration_file)
+ *	calibration_done(jsd, status)
+ *	device_open(jsd, device_name, fd)
+ *	device_close(jsd, device_name, fd)
+ */
+#if !defined(JS_NO_PROBES) && !defined(HAVE_SYS_SDT_H) && \
+    defined(__has_include)
+# if __has_include(<sys/sdt.h>)
+#  define HAVE_SYS_SDT_H
+# endif
+#endif
+
+#if !defined(JS_NO_PROBES) && defined(HAVE_SYS_SDT_H)
+# include <sys/sdt.h>
+# define JS_PROBES
+# define JS_PROBE1(name,a)		DTRACE_PROBE1(libjsw, name, a)
+# define JS_PROBE2(name,a,b)		DTRACE_PROBE2(libjsw, name, a, b)
+# define JS_PROBE3(name,a,b,c)		DTRACE_PROBE3(libjsw, name, a, b, c)
+#else
+# define JS_PROBE1(name,a)		((void)0)
+# define JS_PROBE2(name,a,b)		((void)0)
+# define JS_PROBE3(name,a,b,c)		((void)0)
+#endif
+
+
+#endif	/* PROBES_H */
@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "../include/jsw.h"
+
+#include "record.h"
+#include "utils.h"
+#include "private.h"
+
+
+/*
+ *	Recorder:
+ *
+ *	Appends the events read by JSUpdate() to a recording file, see
+ *	record.h for the format.
+ */
+typedef struct {
+
+	int		fd;
+	int		error;		/* Writing failed, stop recording */
+	unsigned long	start;		/* Time the recording started (in
+					 * us) */
+	off_t		offset;		/* Offset of the current block */
+
+	/* State after the last event added */
+	int16_t		axis_value[JS_RECORD_MAX_AXES];
+	uint8_t		button_state[JS_RECORD_MAX_BUTTONS];
+
+	/* Current block */
+	union {
+	    js_record_block_struct	header;
+	    char			buf[JS_RECORD_BLOCK_SIZE];
+	} block;
+
+} js_recorder_struct;
+#define JS_RECORDER(p)		((js_recorder_struct *)(p))
+
+
+static int JSRecorderWriteBlock(js_recorder_struct *r);
+#if defined(__linux__)
+void JSRecorderAdd(
+	void *ptr,
+	const struct js_event *event, int total
+);
+#endif
+void JSRecorderDelete(void *ptr);
+
+int JSRecordStart(js_data_struct *jsd, const char *path);
+void JSRecordStop(js_data_struct *jsd);
+
+
+#define MIN(a,b)        (((a) < (b)) ? (a) : (b))
+
+
+/*
+ *	Writes the current block at its offset, the whole block is
+ *	written even if it is not full.
+ */
+static int JSRecorderWriteBlock(js_recorder_struct *r)
+{
+	if(r->block.header.total_events == 0)
+	    return(0);
+
+	if(pwrite(
+	    r->fd, r->block.buf, JS_RECORD_BLOCK_SIZE, r->offset
+	) != JS_RECORD_BLOCK_SIZE)
+	{
+	    r->error = 1;
+	    return(-1);
+	}
+
+	return(0);
+}
+
+#if defined(__linux__)
+/*
+ *	Called by JSUpdate() with the events read from the device.
+ */
+void JSRecorderAdd(
+	void *ptr,
+	const struct js_event *event, int total
+)
+{
+	int i;
+	const unsigned long t = JSCurrentNS() / 1000;
+	js_recorder_struct *r = JS_RECORDER(ptr);
+	js_record_block_struct *b;
+	js_record_event_struct *rec;
+
+	if((r == NULL) || r->error)
+	    return;
+
+	b = &r->block.header;
+	for(i = 0; i < total; i++)
+	{
+	    /* Start the next block when the current one is full */
+	    if(b->total_events >= JS_RECORD_BLOCK_EVENTS)
+	    {
+		if(JSRecorderWriteBlock(r))
+		    return;
+		memset(r->block.buf, 0x00, JS_RECORD_BLOCK_SIZE);
+		r->offset += JS_RECORD_BLOCK_SIZE;
+	    }
+
+	    if(b->total_events == 0)
+	    {
+		b->magic = JS_RECORD_BLOCK_MAGIC;
+		b->time = (uint64_t)(t - r->start);
+		memcpy(b->axis_value, r->axis_value, sizeof(b->axis_value));
+		memcpy(
+		    b->button_state, r->button_state,
+		    sizeof(b->button_state)
+		);
+	    }
+
+	    rec = &JS_RECORD_BLOCK_EVENT_LIST(b)[b->total_events];
+	    rec->time = (uint64_t)(t - r->start);
+	    rec->event_time = (uint32_t)event[i].time;
+	    rec->type = (uint8_t)event[i].type;
+	    rec->number = (uint8_t)event[i].number;
+	    rec->value = (int16_t)event[i].value;
+	    b->total_events++;
+
+	    if(((rec->type & ~JS_EVENT_INIT) == JS_EVENT_AXIS) &&
+	       (rec->number < JS_RECORD_MAX_AXES)
+	    )
+		r->axis_value[rec->number] = rec->value;
+	    else if((rec->type & ~JS_EVENT_INIT) == JS_EVENT_BUTTON)
+		r->button_state[rec->number] = (uint8_t)rec->value;
+	}
+}
+#endif	/* __linux__ */
+
+/*
+ *	Writes the last block and deletes the Recorder.
+ */
+void JSRecorderDelete(void *ptr)
+{
+	js_recorder_struct *r = JS_RECORDER(ptr);
+	if(r == NULL)
+	    return;
+
+	if(!r->error)
+	    JSRecorderWriteBlock(r);
+
+	close(r->fd);
+	free(r);
+}
+
+
+/*
+ *	Starts recording the events read by JSUpdate() to the file
+ *	specified by path.
+ */
+int JSRecordStart(js_data_struct *jsd, const char *path)
+{
+#if defined(__linux__)
+	int i;
+	js_recorder_struct *r;
+	js_record_header_struct *h;
+	js_private_struct *priv;
+	char *buf;
+
+	if(!JSIsInit(jsd) || (path == NULL))
+	    return(JSBadValue);
+
+	priv = JSPrivateGet(jsd);
+	if(priv == NULL)
+	    return(JSNoBuffers);
+
+	/* Stop the current recording */
+	JSRecordStop(jsd);
+
+	r = JS_RECORDER(calloc(1, sizeof(js_recorder_struct)));
+	buf = (char *)calloc(1, JS_RECORD_BLOCK_SIZE);
+	if((r == NULL) || (buf == NULL))
+	{
+	    free(r);
+	    free(buf);
+	    return(JSNoBuffers);
+	}
+
+	r->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if(r->fd < 0)
+	{
+	    free(r);
+	    free(buf);
+	    return(JSNoAccess);
+	}
+
+	/* Write the header with the joystick's current state, the
+	 * header is padded to the size of a block
+	 */
+	h = (js_record_header_struct *)buf;
+	memcpy(h->magic, JS_RECORD_MAGIC, sizeof(h->magic));
+	h->version = JS_RECORD_VERSION;
+	h->block_size = JS_RECORD_BLOCK_SIZE;
+	h->record_size = sizeof(js_record_event_struct);
+	h->driver_version = jsd->driver_version;
+	h->axes = (uint32_t)MIN(jsd->total_axises, JS_RECORD_MAX_AXES);
+	h->buttons = (uint32_t)MIN(jsd->total_buttons, JS_RECORD_MAX_BUTTONS);
+	h->start_time = (uint64_t)time(NULL);
+	if(jsd->name != NULL)
+	    strncpy(h->name, jsd->name, sizeof(h->name) - 1);
+	if(jsd->device_name != NULL)
+	    strncpy(h->device_name, jsd->device_name, sizeof(h->device_name) - 1);
+	for(i = 0; i < (int)h->axes; i++)
+	{
+	    if(jsd->axis[i] != NULL)
+		h->axis_value[i] = (int16_t)jsd->axis[i]->cur;
+	}
+	for(i = 0; i < (int)h->buttons; i++)
+	{
+	    if(jsd->button[i] != NULL)
+		h->button_state[i] = (uint8_t)jsd->button[i]->state;
+	}
+
+	if(write(r->fd, buf, JS_RECORD_BLOCK_SIZE) != JS_RECORD_BLOCK_SIZE)
+	{
+	    close(r->fd);
+	    unlink(path);
+	    free(r);
+	    free(buf);
+	    return(JSNoAccess);
+	}
+	memcpy(r->axis_value, h->axis_value, sizeof(r->axis_value));
+	memcpy(r->button_state, h->button_state, sizeof(r->button_state));
+	free(buf);
+
+	r->offset = JS_RECORD_BLOCK_SIZE;
+	r->start = JSCurrentNS() / 1000;
+
+	priv->recorder = r;
+
+	return(JSSuccess);
+#else
+	return(JSError);
+#endif
+}
+
+/*
+ *	Stops recording.
+ */
+void JSRecordStop(js_data_struct *jsd)
+{
+	js_private_struct *priv;
+
+	if(jsd == NULL)
+	    return;
+
+	priv = JS_PRIVATE_DATA(jsd->priv);
+	if(priv == NULL)
+	    return;
+
+	JSRecorderDelete(priv->recorder);
+	priv->recorder = NULL;
+}
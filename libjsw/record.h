@@ -0,0 +1,95 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "../include/jsw.h"
+
+
+/*
+ *	Recording File Format:
+ *
+ *	All values are in host byte order. The file is a header of
+ *	JS_RECORD_BLOCK_SIZE bytes followed by blocks of the same size,
+ *	so the blocks can be found by their offset in a mapped file.
+ *	Each block starts with the time of its first event which allows
+ *	a binary search by time, and the state of the joystick before
+ *	its first event so that a position can be found without the
+ *	events in the blocks before it.
+ *
+ *	Blocks are only appended, each block is written once it is
+ *	full and the last block may hold fewer events.
+ */
+#define JS_RECORD_MAGIC			"JSWREC\0\1"
+#define JS_RECORD_VERSION		2
+#define JS_RECORD_BLOCK_SIZE		4096
+#define JS_RECORD_BLOCK_MAGIC		0x424a534a	/* "JSJB" */
+#define JS_RECORD_MAX_AXES		64
+#define JS_RECORD_MAX_BUTTONS		256
+
+typedef struct {
+
+	char		magic[8];	/* JS_RECORD_MAGIC */
+	uint32_t	version,	/* JS_RECORD_VERSION */
+			block_size,	/* JS_RECORD_BLOCK_SIZE */
+			record_size;	/* sizeof(js_record_event_struct) */
+	uint32_t	driver_version,
+			axes,
+			buttons;
+	uint64_t	start_time;	/* Systime seconds */
+	char		name[128];	/* Descriptive name */
+	char		device_name[256];
+
+	/* State when the recording started */
+	int16_t		axis_value[JS_RECORD_MAX_AXES];
+	uint8_t		button_state[JS_RECORD_MAX_BUTTONS];
+
+} js_record_header_struct;
+
+typedef struct {
+
+	uint64_t	time;		/* Time read (in us) since the
+					 * recording started */
+	uint32_t	event_time;	/* Driver's time stamp (in ms) */
+	uint8_t		type,		/* Driver's event */
+			number;
+	int16_t		value;
+
+} js_record_event_struct;
+
+typedef struct {
+
+	uint32_t	magic;		/* JS_RECORD_BLOCK_MAGIC */
+	uint32_t	total_events;
+	uint64_t	time;		/* Time of the first event */
+
+	/* State before the first event */
+	int16_t		axis_value[JS_RECORD_MAX_AXES];
+	uint8_t		button_state[JS_RECORD_MAX_BUTTONS];
+
+} js_record_block_struct;
+
+/* Events in each block */
+#define JS_RECORD_BLOCK_EVENTS		\
+((JS_RECORD_BLOCK_SIZE - sizeof(js_record_block_struct)) / \
+ sizeof(js_record_event_struct))
+
+/* Returns the block's events */
+#define JS_RECORD_BLOCK_EVENT_LIST(b)	\
+((js_record_event_struct *)((char *)(b) + sizeof(js_record_block_struct)))
+
+
+#if defined(__linux__)
+extern void JSRecorderAdd(
+	void *ptr,
+	const struct js_event *event, int total
+);
+#endif
+extern void JSRecorderDelete(void *ptr);
+
+extern void *JSReplayNew(const char *args, int *fd);
+extern int JSReplayIoctl(void *ptr, unsigned long request, void *arg);
+extern void JSReplayDelete(void *ptr);
+
+
+#endif	/* RECORD_H */
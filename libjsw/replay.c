@@ -0,0 +1,533 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+
+#include "../include/jsw.h"
+
+#include "record.h"
+#include "utils.h"
+
+
+#if defined(__linux__)
+
+/*
+ *	Number of events written at once:
+ */
+#define JS_REPLAY_BATCH		64
+
+
+/*
+ *	Replay:
+ *
+ *	Stands in for a joystick device node like the synthetic
+ *	joystick, a thread writes the events from a mapped recording
+ *	to one end of a socket pair and JSUpdate() reads them from the
+ *	other end.
+ */
+typedef struct {
+
+	/* Parameters */
+	double		speed;		/* 1.0 for the recorded speed, 0
+					 * for as fast as they are read */
+	unsigned long	start;		/* Time to start at (in ms) */
+
+	/* Mapped recording */
+	void		*map;
+	size_t		map_len;
+	const js_record_header_struct	*header;
+	unsigned long	total_blocks;
+
+	/* Position of the next event */
+	unsigned long	block;
+	int		event;
+
+	/* Player */
+	pthread_t	thread;
+	pthread_mutex_t	mutex;
+	pthread_cond_t	cond;
+	int		stop;
+	int		fd;		/* Player's end */
+
+	struct js_corr	corr[JS_RECORD_MAX_AXES];
+
+} js_replay_struct;
+#define JS_REPLAY(p)		((js_replay_struct *)(p))
+
+
+static unsigned long JSReplayDue(
+	js_replay_struct *rp, unsigned long t0,
+	const js_record_event_struct *rec
+);
+static const js_record_block_struct *JSReplayBlock(
+	js_replay_struct *rp, unsigned long i
+);
+static const js_record_event_struct *JSReplayNext(js_replay_struct *rp);
+static void JSReplaySeek(js_replay_struct *rp, struct js_event *init);
+static int JSReplayWrite(
+	js_replay_struct *rp, const struct js_event *ev, int total
+);
+static void *JSReplayThread(void *data);
+
+void *JSReplayNew(const char *args, int *fd);
+int JSReplayIoctl(void *ptr, unsigned long request, void *arg);
+void JSReplayDelete(void *ptr);
+
+
+#define MIN(a,b)        (((a) < (b)) ? (a) : (b))
+
+
+/*
+ *	Returns the time (in ns) that the event is due when playing
+ *	started at t0.
+ */
+static unsigned long JSReplayDue(
+	js_replay_struct *rp, unsigned long t0,
+	const js_record_event_struct *rec
+)
+{
+	const uint64_t start = (uint64_t)rp->start * 1000;
+	if((rp->speed <= 0.0) || (rec->time <= start))
+	    return(t0);
+	return(t0 + (unsigned long)(
+	    (double)(rec->time - start) * 1000.0 / rp->speed
+	));
+}
+
+/*
+ *	Returns block i or NULL if it is past the end of the recording.
+ */
+static const js_record_block_struct *JSReplayBlock(
+	js_replay_struct *rp, unsigned long i
+)
+{
+	if(i >= rp->total_blocks)
+	    return(NULL);
+	return((const js_record_block_struct *)(
+	    (const char *)rp->map + ((i + 1) * JS_RECORD_BLOCK_SIZE)
+	));
+}
+
+/*
+ *	Returns the next event without advancing the position or NULL
+ *	at the end of the recording.
+ */
+static const js_record_event_struct *JSReplayNext(js_replay_struct *rp)
+{
+	const js_record_block_struct *b = JSReplayBlock(rp, rp->block);
+	while((b != NULL) && (rp->event >= (int)b->total_events))
+	{
+	    rp->block++;
+	    rp->event = 0;
+	    b = JSReplayBlock(rp, rp->block);
+	}
+	if(b == NULL)
+	    return(NULL);
+	return(&JS_RECORD_BLOCK_EVENT_LIST(b)[rp->event]);
+}
+
+/*
+ *	Moves the position to the first event at or after the start
+ *	time and sets init to the init events for the state of the
+ *	joystick at that time, init must have room for all the axises
+ *	and buttons.
+ *
+ *	The block is found by a binary search on the time of each
+ *	block's first event, the state is found by applying the events
+ *	before the position in that block to the state stored at the
+ *	start of the block.
+ */
+static void JSReplaySeek(js_replay_struct *rp, struct js_event *init)
+{
+	const js_record_header_struct *h = rp->header;
+	const js_record_block_struct *b;
+	const js_record_event_struct *rec;
+	const uint64_t start = (uint64_t)rp->start * 1000;
+	unsigned long lo = 0, hi = rp->total_blocks, mid;
+	int i;
+	int16_t axis_value[JS_RECORD_MAX_AXES];
+	uint8_t button_state[JS_RECORD_MAX_BUTTONS];
+
+	/* Find the last block that starts before the start time */
+	while((hi - lo) > 1)
+	{
+	    mid = (lo + hi) / 2;
+	    if(JSReplayBlock(rp, mid)->time <= start)
+		lo = mid;
+	    else
+		hi = mid;
+	}
+	rp->block = lo;
+	rp->event = 0;
+
+	/* Apply the events in the block before the position */
+	b = JSReplayBlock(rp, rp->block);
+	if(b != NULL)
+	{
+	    memcpy(axis_value, b->axis_value, sizeof(axis_value));
+	    memcpy(button_state, b->button_state, sizeof(button_state));
+
+	    for(rec = JS_RECORD_BLOCK_EVENT_LIST(b);
+		(rp->event < (int)b->total_events) && (rec->time < start);
+		rec++
+	    )
+	    {
+		if(((rec->type & ~JS_EVENT_INIT) == JS_EVENT_AXIS) &&
+		   (rec->number < JS_RECORD_MAX_AXES)
+		)
+		    axis_value[rec->number] = rec->value;
+		else if((rec->type & ~JS_EVENT_INIT) == JS_EVENT_BUTTON)
+		    button_state[rec->number] = (uint8_t)rec->value;
+		rp->event++;
+	    }
+	}
+	else
+	{
+	    memcpy(axis_value, h->axis_value, sizeof(axis_value));
+	    memcpy(button_state, h->button_state, sizeof(button_state));
+	}
+
+	/* The init events have the time stamp of the next event */
+	rec = JSReplayNext(rp);
+	for(i = 0; i < (int)(h->axes + h->buttons); i++)
+	{
+	    init[i].time = (rec != NULL) ? rec->event_time : 0;
+	    if(i < (int)h->axes)
+	    {
+		init[i].type = JS_EVENT_INIT | JS_EVENT_AXIS;
+		init[i].number = (unsigned char)i;
+		init[i].value = axis_value[i];
+	    }
+	    else
+	    {
+		init[i].type = JS_EVENT_INIT | JS_EVENT_BUTTON;
+		init[i].number = (unsigned char)(i - h->axes);
+		init[i].value = button_state[i - h->axes];
+	    }
+	}
+}
+
+/*
+ *	Writes the events to the player's end, returns -1 if the device
+ *	was closed.
+ */
+static int JSReplayWrite(
+	js_replay_struct *rp, const struct js_event *ev, int total
+)
+{
+	const char *buf = (const char *)ev;
+	size_t len = total * sizeof(struct js_event);
+	ssize_t n;
+
+	while(len > 0)
+	{
+	    n = send(rp->fd, buf, len, MSG_NOSIGNAL);
+	    if(n < 0)
+	    {
+		if(errno == EINTR)
+		    continue;
+		return(-1);
+	    }
+	    buf += n;
+	    len -= (size_t)n;
+	}
+
+	return(0);
+}
+
+/*
+ *	Player thread.
+ */
+static void *JSReplayThread(void *data)
+{
+	js_replay_struct *rp = JS_REPLAY(data);
+	const js_record_header_struct *h = rp->header;
+	const js_record_event_struct *rec;
+	struct js_event ev[JS_RECORD_MAX_AXES + JS_RECORD_MAX_BUTTONS];
+	unsigned long t0, now, due;
+	int n;
+	struct timespec ts;
+
+	/* Report the state at the start time first like the driver
+	 * does when it is opened
+	 */
+	JSReplaySeek(rp, ev);
+	if(JSReplayWrite(rp, ev, (int)(h->axes + h->buttons)))
+	    return(NULL);
+
+	t0 = JSCurrentNS();
+
+	pthread_mutex_lock(&rp->mutex);
+	while(!rp->stop)
+	{
+	    rec = JSReplayNext(rp);
+	    if(rec == NULL)
+	    {
+		/* End of the recording, wait to be stopped */
+		pthread_cond_wait(&rp->cond, &rp->mutex);
+		continue;
+	    }
+
+	    /* Wait until the next event is due */
+	    now = JSCurrentNS();
+	    due = JSReplayDue(rp, t0, rec);
+	    if(now < due)
+	    {
+		ts.tv_sec = (time_t)(due / 1000000000);
+		ts.tv_nsec = (long)(due % 1000000000);
+		pthread_cond_timedwait(&rp->cond, &rp->mutex, &ts);
+		continue;
+	    }
+
+	    /* Get all the events that are due */
+	    for(n = 0; (n < JS_REPLAY_BATCH) && (rec != NULL); n++)
+	    {
+		if(JSReplayDue(rp, t0, rec) > now)
+		    break;
+
+		ev[n].time = rec->event_time;
+		ev[n].type = rec->type;
+		ev[n].number = rec->number;
+		ev[n].value = rec->value;
+		rp->event++;
+		rec = JSReplayNext(rp);
+	    }
+	    pthread_mutex_unlock(&rp->mutex);
+
+	    if(JSReplayWrite(rp, ev, n))
+		return(NULL);
+
+	    pthread_mutex_lock(&rp->mutex);
+	}
+	pthread_mutex_unlock(&rp->mutex);
+
+	return(NULL);
+}
+
+
+/*
+ *	Opens a recording for replay with the parameters args and
+ *	starts playing it, the descriptor to read the events from is
+ *	returned in fd.
+ */
+void *JSReplayNew(const char *args, int *fd)
+{
+	int sv[2], rfd;
+	unsigned long i;
+	const char *arg = args, *path = NULL;
+	struct stat stat_buf;
+	pthread_condattr_t attr;
+	const js_record_header_struct *h;
+	const js_record_block_struct *b;
+	js_replay_struct *rp;
+
+	if(args == NULL)
+	    return(NULL);
+
+	rp = JS_REPLAY(calloc(1, sizeof(js_replay_struct)));
+	if(rp == NULL)
+	    return(NULL);
+	rp->speed = 1.0;
+	rp->start = 0;
+
+	/* Get the parameters, file is the last one and takes the
+	 * rest of args
+	 */
+	while((arg != NULL) && (*arg != '\0'))
+	{
+	    if(!strncmp(arg, "file=", 5))
+	    {
+		path = arg + 5;
+		break;
+	    }
+	    else if(!strncmp(arg, "speed=", 6))
+		rp->speed = atof(arg + 6);
+	    else if(!strncmp(arg, "start=", 6))
+		rp->start = strtoul(arg + 6, NULL, 10);
+
+	    arg = strchr(arg, ',');
+	    if(arg != NULL)
+		arg++;
+	}
+	if(path == NULL)
+	    path = args;
+
+	/* Map the recording and check its header */
+	rfd = open(path, O_RDONLY);
+	if(rfd < 0)
+	{
+	    free(rp);
+	    return(NULL);
+	}
+	if(fstat(rfd, &stat_buf) ||
+	   (stat_buf.st_size < (off_t)JS_RECORD_BLOCK_SIZE)
+	)
+	{
+	    close(rfd);
+	    free(rp);
+	    return(NULL);
+	}
+	rp->map_len = (size_t)stat_buf.st_size;
+	rp->map = mmap(NULL, rp->map_len, PROT_READ, MAP_SHARED, rfd, 0);
+	close(rfd);
+	if(rp->map == MAP_FAILED)
+	{
+	    free(rp);
+	    return(NULL);
+	}
+
+	rp->header = h = (const js_record_header_struct *)rp->map;
+	if(memcmp(h->magic, JS_RECORD_MAGIC, sizeof(h->magic)) ||
+	   (h->version != JS_RECORD_VERSION) ||
+	   (h->block_size != JS_RECORD_BLOCK_SIZE) ||
+	   (h->record_size != sizeof(js_record_event_struct)) ||
+	   (h->axes > JS_RECORD_MAX_AXES) ||
+	   (h->buttons > JS_RECORD_MAX_BUTTONS)
+	)
+	{
+	    munmap(rp->map, rp->map_len);
+	    free(rp);
+	    return(NULL);
+	}
+
+	/* Count the blocks up to the first one that is not valid,
+	 * which is where the recording was cut off
+	 */
+	rp->total_blocks = (rp->map_len / JS_RECORD_BLOCK_SIZE) - 1;
+	for(i = 0; i < rp->total_blocks; i++)
+	{
+	    b = JSReplayBlock(rp, i);
+	    if((b->magic != JS_RECORD_BLOCK_MAGIC) ||
+	       (b->total_events > JS_RECORD_BLOCK_EVENTS)
+	    )
+		break;
+	}
+	rp->total_blocks = i;
+
+	if(socketpair(AF_UNIX, SOCK_STREAM, 0, sv))
+	{
+	    munmap(rp->map, rp->map_len);
+	    free(rp);
+	    return(NULL);
+	}
+	rp->fd = sv[1];
+
+	pthread_mutex_init(&rp->mutex, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&rp->cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	if(pthread_create(&rp->thread, NULL, JSReplayThread, rp))
+	{
+	    close(sv[0]);
+	    close(sv[1]);
+	    pthread_cond_destroy(&rp->cond);
+	    pthread_mutex_destroy(&rp->mutex);
+	    munmap(rp->map, rp->map_len);
+	    free(rp);
+	    return(NULL);
+	}
+
+	*fd = sv[0];
+	return(rp);
+}
+
+/*
+ *	Answers the joystick driver's ioctl() requests from the
+ *	recording's header.
+ */
+int JSReplayIoctl(void *ptr, unsigned long request, void *arg)
+{
+	int len;
+	js_replay_struct *rp = JS_REPLAY(ptr);
+	const js_record_header_struct *h;
+	if((rp == NULL) || (arg == NULL))
+	{
+	    errno = EINVAL;
+	    return(-1);
+	}
+
+	h = rp->header;
+	switch(request)
+	{
+	  case JSIOCGVERSION:
+	    *(int *)arg = (int)h->driver_version;
+	    return(0);
+
+	  case JSIOCGAXES:
+	    *(unsigned char *)arg = (unsigned char)h->axes;
+	    return(0);
+
+	  case JSIOCGBUTTONS:
+	    *(unsigned char *)arg = (unsigned char)h->buttons;
+	    return(0);
+
+	  case JSIOCSCORR:
+	    pthread_mutex_lock(&rp->mutex);
+	    memcpy(rp->corr, arg, h->axes * sizeof(struct js_corr));
+	    pthread_mutex_unlock(&rp->mutex);
+	    return(0);
+
+	  case JSIOCGCORR:
+	    pthread_mutex_lock(&rp->mutex);
+	    memcpy(arg, rp->corr, h->axes * sizeof(struct js_corr));
+	    pthread_mutex_unlock(&rp->mutex);
+	    return(0);
+	}
+
+	/* JSIOCGNAME has the buffer length in the request */
+	if((_IOC_TYPE(request) == _IOC_TYPE(JSIOCGNAME(0))) &&
+	   (_IOC_NR(request) == _IOC_NR(JSIOCGNAME(0)))
+	)
+	{
+	    len = (int)_IOC_SIZE(request);
+	    if(len > 0)
+		snprintf(
+		    (char *)arg, len, "%.*s",
+		    (int)sizeof(h->name), h->name
+		);
+	    return((int)MIN(strlen((char *)arg) + 1, (size_t)len));
+	}
+
+	errno = ENOTTY;
+	return(-1);
+}
+
+/*
+ *	Stops playing and closes the recording, the reader's
+ *	descriptor must already be closed.
+ */
+void JSReplayDelete(void *ptr)
+{
+	js_replay_struct *rp = JS_REPLAY(ptr);
+	if(rp == NULL)
+	    return;
+
+	pthread_mutex_lock(&rp->mutex);
+	rp->stop = 1;
+	pthread_cond_signal(&rp->cond);
+	pthread_mutex_unlock(&rp->mutex);
+
+	/* Wake the player if it is blocked writing */
+	shutdown(rp->fd, SHUT_RDWR);
+
+	pthread_join(rp->thread, NULL);
+
+	close(rp->fd);
+	pthread_cond_destroy(&rp->cond);
+	pthread_mutex_destroy(&rp->mutex);
+	munmap(rp->map, rp->map_len);
+	free(rp);
+}
+
+#endif	/* __linux__ */
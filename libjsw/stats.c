@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "../include/jsw.h"
+
+#include "stats.h"
+#include "utils.h"
+#include "private.h"
+
+
+
+void *JSStatsNew(void);
+void JSStatsAddEvent(void *ptr, int type, int number);
+void JSStatsDeviceOpened(void *ptr);
+void JSStatsDelete(void *ptr);
+
+int JSGetStats(js_data_struct *jsd, js_stats_struct *stats);
+void JSResetStats(js_data_struct *jsd);
+
+
+#define JS_LOAD(p)		__atomic_load_n((p), __ATOMIC_RELAXED)
+#define JS_STORE(p,v)		__atomic_store_n((p), (v), __ATOMIC_RELAXED)
+
+
+
+/*
+ *	Allocates new Statistics.
+ */
+void *JSStatsNew(void)
+{
+	js_stats_data_struct *s = (js_stats_data_struct *)calloc(
+	    1, sizeof(js_stats_data_struct)
+	);
+	if(s == NULL)
+	    return(NULL);
+
+	s->start_ms = JSCurrentNS() / 1000000;
+
+	return(s);
+}
+
+/*
+ *	Called by JSUpdate() for each event read, the type is the
+ *	driver's event type.
+ *
+ *	After a kernel event queue overflow the driver sends init
+ *	events for all the axises and buttons again, so init events
+ *	after other events are counted as an overflow.
+ */
+void JSStatsAddEvent(void *ptr, int type, int number)
+{
+	js_stats_data_struct *s = JS_STATS_DATA(ptr);
+	if(s == NULL)
+	    return;
+
+	JS_STATS_ADD(s, events, 1);
+
+#if defined(__linux__)
+	if(type & JS_EVENT_INIT)
+	{
+	    if(s->got_events && !s->in_init)
+		JS_STATS_ADD(s, overflows, 1);
+	    s->in_init = 1;
+	}
+	else
+	{
+	    s->got_events = 1;
+	    s->in_init = 0;
+	}
+
+	if(((type & ~JS_EVENT_INIT) == JS_EVENT_AXIS) &&
+	   (number >= 0) && (number < JSStatsMaxAxises)
+	)
+	    JS_STATS_ADD(s, axis_events[number], 1);
+#endif
+}
+
+/*
+ *	Called when the device has been opened again, the init events
+ *	that follow are not an overflow.
+ */
+void JSStatsDeviceOpened(void *ptr)
+{
+	js_stats_data_struct *s = JS_STATS_DATA(ptr);
+	if(s == NULL)
+	    return;
+
+	s->got_events = 0;
+	s->in_init = 0;
+}
+
+/*
+ *	Deletes the Statistics.
+ */
+void JSStatsDelete(void *ptr)
+{
+	free(ptr);
+}
+
+
+/*
+ *	Gets the joystick's statistics.
+ *
+ *	Can be called from any thread while another thread calls
+ *	JSUpdate(), each counter is read atomically but the counters
+ *	are not read all at the same time.
+ */
+int JSGetStats(js_data_struct *jsd, js_stats_struct *stats)
+{
+	int i;
+	js_stats_data_struct *s;
+
+	if((jsd == NULL) || (stats == NULL))
+	    return(JSBadValue);
+
+	memset(stats, 0x00, sizeof(js_stats_struct));
+
+	s = JS_STATS_DATA(JS_PRIVATE(jsd)->stats);
+	if(s == NULL)
+	    return(JSError);
+
+	stats->updates = JS_LOAD(&s->updates);
+	stats->reads = JS_LOAD(&s->reads);
+	stats->empty_reads = JS_LOAD(&s->empty_reads);
+	stats->events = JS_LOAD(&s->events);
+	stats->events_coalesced = JS_LOAD(&s->events_coalesced);
+	stats->full_reads = JS_LOAD(&s->full_reads);
+	stats->overflows = JS_LOAD(&s->overflows);
+	for(i = 0; i < JSStatsMaxAxises; i++)
+	    stats->axis_events[i] = JS_LOAD(&s->axis_events[i]);
+	stats->elapsed_ms = (JSCurrentNS() / 1000000) - JS_LOAD(&s->start_ms);
+
+	return(JSSuccess);
+}
+
+/*
+ *	Resets the joystick's statistics.
+ *
+ *	Can be called from any thread, events counted by JSUpdate()
+ *	while the counters are being reset may be lost.
+ */
+void JSResetStats(js_data_struct *jsd)
+{
+	int i;
+	js_stats_data_struct *s;
+
+	if(jsd == NULL)
+	    return;
+
+	s = JS_STATS_DATA(JS_PRIVATE(jsd)->stats);
+	if(s == NULL)
+	    return;
+
+	JS_STORE(&s->updates, 0);
+	JS_STORE(&s->reads, 0);
+	JS_STORE(&s->empty_reads, 0);
+	JS_STORE(&s->events, 0);
+	JS_STORE(&s->events_coalesced, 0);
+	JS_STORE(&s->full_reads, 0);
+	JS_STORE(&s->overflows, 0);
+	for(i = 0; i < JSStatsMaxAxises; i++)
+	    JS_STORE(&s->axis_events[i], 0);
+	JS_STORE(&s->start_ms, JSCurrentNS() / 1000000);
+}
@@ -0,0 +1,51 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <sys/types.h>
+#include "../include/jsw.h"
+
+
+/*
+ *	Statistics:
+ *
+ *	Allocated on each jsd by JSInit(), the counters are updated by
+ *	JSUpdate() with relaxed atomics so that they can be read from
+ *	any thread.
+ */
+typedef struct {
+
+	unsigned long	updates,
+			reads,
+			empty_reads,
+			events,
+			events_coalesced,
+			full_reads,
+			overflows;
+	unsigned long	axis_events[JSStatsMaxAxises];
+	unsigned long	start_ms;	/* Time of the last reset */
+
+	/* Used only by JSUpdate() to detect kernel queue overflows */
+	int		got_events,	/* Got events since opened */
+			in_init;	/* Last event was an init event */
+
+} js_stats_data_struct;
+#define JS_STATS_DATA(p)	((js_stats_data_struct *)(p))
+
+/*
+ *	Adds n to the statistics counter:
+ */
+#define JS_STATS_ADD(s,counter,n)	do {				\
+	if((s) != NULL)							\
+	    __atomic_fetch_add(						\
+		&JS_STATS_DATA(s)->counter, (n), __ATOMIC_RELAXED	\
+	    );								\
+} while(0)
+
+
+extern void *JSStatsNew(void);
+extern void JSStatsAddEvent(void *ptr, int type, int number);
+extern void JSStatsDeviceOpened(void *ptr);
+extern void JSStatsDelete(void *ptr);
+
+
+#endif	/* STATS_H */
@@ -0,0 +1,478 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+
+#include "../include/jsw.h"
+
+#include "synthetic.h"
+#include "utils.h"
+
+
+#if defined(__linux__)
+
+/*
+ *	Patterns:
+ */
+#define JS_SYNTHETIC_PATTERN_IDLE	0	/* Only the init events */
+#define JS_SYNTHETIC_PATTERN_SWEEP	1	/* Each axis in turn sweeps
+						 * its range */
+#define JS_SYNTHETIC_PATTERN_BUTTONS	2	/* Each button in turn is
+						 * pressed and released */
+#define JS_SYNTHETIC_PATTERN_BURST	3	/* Sweeps sent in bursts */
+#define JS_SYNTHETIC_PATTERN_MIXED	4	/* Random axis and button
+						 * events */
+
+/*
+ *	Limits, the same as the driver's:
+ */
+#define JS_SYNTHETIC_MAX_AXES		64
+#define JS_SYNTHETIC_MAX_BUTTONS	255
+
+/*
+ *	Number of events written at once:
+ */
+#define JS_SYNTHETIC_BATCH		64
+
+/*
+ *	Driver version reported by JSIOCGVERSION:
+ */
+#define JS_SYNTHETIC_VERSION		0x020100
+
+
+/*
+ *	Synthetic Joystick:
+ *
+ *	Stands in for a joystick device node. A generator thread writes
+ *	struct js_event to one end of a socket pair and JSUpdate()
+ *	reads them from the other end, the JSIOC* requests are answered
+ *	from the parameters given in the device name.
+ *
+ *	The generator blocks when the reader falls behind, so no events
+ *	are lost.
+ */
+typedef struct {
+
+	/* Parameters */
+	int		axes,
+			buttons;
+	char		name[128];
+	int		pattern;	/* One of JS_SYNTHETIC_PATTERN_* */
+	unsigned long	rate,		/* Events per second, 0 for as
+					 * fast as they are read */
+			count;		/* Events to generate after the
+					 * init events, 0 for no limit */
+	int		burst;		/* Events in each burst */
+	unsigned int	seed;
+
+	/* Generator */
+	pthread_t	thread;
+	pthread_mutex_t	mutex;
+	pthread_cond_t	cond;
+	int		stop;
+	int		fd;		/* Generator's end */
+
+	unsigned char	button_state[256];
+	struct js_corr	corr[JS_SYNTHETIC_MAX_AXES];
+
+} js_synthetic_struct;
+#define JS_SYNTHETIC(p)		((js_synthetic_struct *)(p))
+
+
+static void JSSyntheticParse(js_synthetic_struct *s, const char *args);
+static void JSSyntheticGenerate(
+	js_synthetic_struct *s, struct js_event *ev, unsigned long k
+);
+static int JSSyntheticWrite(
+	js_synthetic_struct *s, const struct js_event *ev, int total
+);
+static void *JSSyntheticThread(void *data);
+
+void *JSSyntheticNew(const char *args, int *fd);
+int JSSyntheticIoctl(void *ptr, unsigned long request, void *arg);
+void JSSyntheticDelete(void *ptr);
+
+
+#define MAX(a,b)        (((a) > (b)) ? (a) : (b))
+#define MIN(a,b)        (((a) < (b)) ? (a) : (b))
+#define CLIP(a,l,h)     (MIN(MAX((a),(l)),(h)))
+
+
+/*
+ *	Sets the parameters from the comma separated list of
+ *	parameter=value in args.
+ */
+static void JSSyntheticParse(js_synthetic_struct *s, const char *args)
+{
+	const char *arg = args, *end, *value;
+	int len;
+	char buf[128];
+
+	while((arg != NULL) && (*arg != '\0'))
+	{
+	    end = strchr(arg, ',');
+	    len = (end != NULL) ? (int)(end - arg) : (int)strlen(arg);
+
+	    value = memchr(arg, '=', len);
+	    if(value != NULL)
+	    {
+		value++;
+		snprintf(
+		    buf, sizeof(buf), "%.*s",
+		    len - (int)(value - arg), value
+		);
+
+#define IS_PARM(_parm_)	(!strncmp(arg, (_parm_), strlen(_parm_)) && \
+			 (arg[strlen(_parm_)] == '='))
+		if(IS_PARM("axes"))
+		    s->axes = CLIP(atoi(buf), 0, JS_SYNTHETIC_MAX_AXES);
+		else if(IS_PARM("buttons"))
+		    s->buttons = CLIP(atoi(buf), 0, JS_SYNTHETIC_MAX_BUTTONS);
+		else if(IS_PARM("name"))
+		    snprintf(s->name, sizeof(s->name), "%s", buf);
+		else if(IS_PARM("rate"))
+		    s->rate = strtoul(buf, NULL, 10);
+		else if(IS_PARM("count"))
+		    s->count = strtoul(buf, NULL, 10);
+		else if(IS_PARM("burst"))
+		    s->burst = MAX(atoi(buf), 1);
+		else if(IS_PARM("seed"))
+		    s->seed = (unsigned int)strtoul(buf, NULL, 10);
+		else if(IS_PARM("pattern"))
+		{
+		    if(!strcmp(buf, "idle"))
+			s->pattern = JS_SYNTHETIC_PATTERN_IDLE;
+		    else if(!strcmp(buf, "sweep"))
+			s->pattern = JS_SYNTHETIC_PATTERN_SWEEP;
+		    else if(!strcmp(buf, "buttons"))
+			s->pattern = JS_SYNTHETIC_PATTERN_BUTTONS;
+		    else if(!strcmp(buf, "burst"))
+			s->pattern = JS_SYNTHETIC_PATTERN_BURST;
+		    else if(!strcmp(buf, "mixed"))
+			s->pattern = JS_SYNTHETIC_PATTERN_MIXED;
+		}
+#undef IS_PARM
+	    }
+
+	    arg = (end != NULL) ? (end + 1) : NULL;
+	}
+}
+
+/*
+ *	Generates the event k of the pattern, the init events are not
+ *	counted.
+ */
+static void JSSyntheticGenerate(
+	js_synthetic_struct *s, struct js_event *ev, unsigned long k
+)
+{
+	int pattern = s->pattern, t;
+
+	/* Fall back to the other kind of event if the device has none
+	 * of the kind the pattern needs
+	 */
+	if((s->axes == 0) && (pattern != JS_SYNTHETIC_PATTERN_BUTTONS))
+	    pattern = JS_SYNTHETIC_PATTERN_BUTTONS;
+	else if((s->buttons == 0) && (pattern == JS_SYNTHETIC_PATTERN_BUTTONS))
+	    pattern = JS_SYNTHETIC_PATTERN_SWEEP;
+
+	ev->time = (unsigned int)(JSCurrentNS() / 1000000);
+
+	switch(pattern)
+	{
+	  case JS_SYNTHETIC_PATTERN_SWEEP:
+	  case JS_SYNTHETIC_PATTERN_BURST:
+	    /* Triangle wave from -32767 to 32705 and back over 128
+	     * events on each axis
+	     */
+	    ev->type = JS_EVENT_AXIS;
+	    ev->number = (unsigned char)(k % s->axes);
+	    t = (int)((k / s->axes) % 128);
+	    ev->value = (short)(((t < 64) ? t : (128 - t)) * 1023 - 32767);
+	    break;
+
+	  case JS_SYNTHETIC_PATTERN_BUTTONS:
+	    ev->type = JS_EVENT_BUTTON;
+	    ev->number = (unsigned char)((k / 2) % s->buttons);
+	    ev->value = (k & 1) ? 0 : 1;
+	    break;
+
+	  case JS_SYNTHETIC_PATTERN_MIXED:
+	    s->seed = (s->seed * 1103515245) + 12345;
+	    t = (int)((s->seed >> 16) & 0x7fff);
+	    if((s->buttons > 0) && ((t & 3) == 0))
+	    {
+		ev->type = JS_EVENT_BUTTON;
+		ev->number = (unsigned char)((t >> 2) % s->buttons);
+		s->button_state[ev->number] = !s->button_state[ev->number];
+		ev->value = s->button_state[ev->number];
+	    }
+	    else
+	    {
+		ev->type = JS_EVENT_AXIS;
+		ev->number = (unsigned char)((t >> 2) % s->axes);
+		ev->value = (short)((t * 2) - 32767);
+	    }
+	    break;
+	}
+}
+
+/*
+ *	Writes the events to the generator's end, returns -1 if the
+ *	device was closed.
+ */
+static int JSSyntheticWrite(
+	js_synthetic_struct *s, const struct js_event *ev, int total
+)
+{
+	const char *buf = (const char *)ev;
+	size_t len = total * sizeof(struct js_event);
+	ssize_t n;
+
+	while(len > 0)
+	{
+	    n = send(s->fd, buf, len, MSG_NOSIGNAL);
+	    if(n < 0)
+	    {
+		if(errno == EINTR)
+		    continue;
+		return(-1);
+	    }
+	    buf += n;
+	    len -= (size_t)n;
+	}
+
+	return(0);
+}
+
+/*
+ *	Generator thread.
+ */
+static void *JSSyntheticThread(void *data)
+{
+	js_synthetic_struct *s = JS_SYNTHETIC(data);
+	struct js_event ev[JS_SYNTHETIC_BATCH];
+	unsigned long k = 0, start, now, due, next;
+	int i, n, group;
+	struct timespec ts;
+
+	/* The driver first reports the state of each axis and
+	 * button
+	 */
+	for(i = 0, n = 0; i < (s->axes + s->buttons); i++)
+	{
+	    ev[n].time = (unsigned int)(JSCurrentNS() / 1000000);
+	    ev[n].type = JS_EVENT_INIT |
+		((i < s->axes) ? JS_EVENT_AXIS : JS_EVENT_BUTTON);
+	    ev[n].number = (unsigned char)((i < s->axes) ? i : (i - s->axes));
+	    ev[n].value = 0;
+	    n++;
+	    if((n == JS_SYNTHETIC_BATCH) || (i == (s->axes + s->buttons - 1)))
+	    {
+		if(JSSyntheticWrite(s, ev, n))
+		    return(NULL);
+		n = 0;
+	    }
+	}
+
+	/* Events are due in groups of burst for the burst pattern and
+	 * one at a time otherwise
+	 */
+	group = (s->pattern == JS_SYNTHETIC_PATTERN_BURST) ? s->burst : 1;
+	start = JSCurrentNS();
+
+	pthread_mutex_lock(&s->mutex);
+	while(!s->stop)
+	{
+	    if((s->pattern == JS_SYNTHETIC_PATTERN_IDLE) ||
+	       ((s->axes + s->buttons) == 0) ||
+	       ((s->count > 0) && (k >= s->count))
+	    )
+	    {
+		/* Nothing more to generate, wait to be stopped */
+		pthread_cond_wait(&s->cond, &s->mutex);
+		continue;
+	    }
+
+	    n = JS_SYNTHETIC_BATCH;
+	    if(s->count > 0)
+		n = (int)MIN((unsigned long)n, s->count - k);
+
+	    if(s->rate > 0)
+	    {
+		/* Get the number of events due by now */
+		now = JSCurrentNS();
+		due = (unsigned long)(
+		    (double)(now - start) * (double)s->rate / 1e9
+		);
+		due = ((due / group) + 1) * group;
+		if(due <= k)
+		{
+		    /* Wait until the next group is due */
+		    next = start + (unsigned long)(
+			(double)((k / group) * group) * 1e9 / (double)s->rate
+		    );
+		    ts.tv_sec = (time_t)(next / 1000000000);
+		    ts.tv_nsec = (long)(next % 1000000000);
+		    pthread_cond_timedwait(&s->cond, &s->mutex, &ts);
+		    continue;
+		}
+		n = (int)MIN((unsigned long)n, due - k);
+	    }
+	    pthread_mutex_unlock(&s->mutex);
+
+	    for(i = 0; i < n; i++)
+		JSSyntheticGenerate(s, &ev[i], k + i);
+	    k += n;
+
+	    if(JSSyntheticWrite(s, ev, n))
+		return(NULL);
+
+	    pthread_mutex_lock(&s->mutex);
+	}
+	pthread_mutex_unlock(&s->mutex);
+
+	return(NULL);
+}
+
+
+/*
+ *	Opens a new Synthetic Joystick with the parameters args and
+ *	starts its generator, the descriptor to read the events from
+ *	is returned in fd.
+ */
+void *JSSyntheticNew(const char *args, int *fd)
+{
+	int sv[2];
+	pthread_condattr_t attr;
+	js_synthetic_struct *s = JS_SYNTHETIC(calloc(
+	    1, sizeof(js_synthetic_struct)
+	));
+	if(s == NULL)
+	    return(NULL);
+
+	s->axes = 2;
+	s->buttons = 2;
+	strcpy(s->name, "Synthetic Joystick");
+	s->pattern = JS_SYNTHETIC_PATTERN_SWEEP;
+	s->rate = 1000;
+	s->count = 0;
+	s->burst = 16;
+	s->seed = 1;
+	JSSyntheticParse(s, args);
+
+	if(socketpair(AF_UNIX, SOCK_STREAM, 0, sv))
+	{
+	    free(s);
+	    return(NULL);
+	}
+	s->fd = sv[1];
+
+	pthread_mutex_init(&s->mutex, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&s->cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	if(pthread_create(&s->thread, NULL, JSSyntheticThread, s))
+	{
+	    close(sv[0]);
+	    close(sv[1]);
+	    pthread_cond_destroy(&s->cond);
+	    pthread_mutex_destroy(&s->mutex);
+	    free(s);
+	    return(NULL);
+	}
+
+	*fd = sv[0];
+	return(s);
+}
+
+/*
+ *	Answers the joystick driver's ioctl() requests.
+ */
+int JSSyntheticIoctl(void *ptr, unsigned long request, void *arg)
+{
+	int len;
+	js_synthetic_struct *s = JS_SYNTHETIC(ptr);
+	if((s == NULL) || (arg == NULL))
+	{
+	    errno = EINVAL;
+	    return(-1);
+	}
+
+	switch(request)
+	{
+	  case JSIOCGVERSION:
+	    *(int *)arg = JS_SYNTHETIC_VERSION;
+	    return(0);
+
+	  case JSIOCGAXES:
+	    *(unsigned char *)arg = (unsigned char)s->axes;
+	    return(0);
+
+	  case JSIOCGBUTTONS:
+	    *(unsigned char *)arg = (unsigned char)s->buttons;
+	    return(0);
+
+	  case JSIOCSCORR:
+	    pthread_mutex_lock(&s->mutex);
+	    memcpy(s->corr, arg, s->axes * sizeof(struct js_corr));
+	    pthread_mutex_unlock(&s->mutex);
+	    return(0);
+
+	  case JSIOCGCORR:
+	    pthread_mutex_lock(&s->mutex);
+	    memcpy(arg, s->corr, s->axes * sizeof(struct js_corr));
+	    pthread_mutex_unlock(&s->mutex);
+	    return(0);
+	}
+
+	/* JSIOCGNAME has the buffer length in the request */
+	if((_IOC_TYPE(request) == _IOC_TYPE(JSIOCGNAME(0))) &&
+	   (_IOC_NR(request) == _IOC_NR(JSIOCGNAME(0)))
+	)
+	{
+	    len = (int)_IOC_SIZE(request);
+	    if(len > 0)
+		snprintf((char *)arg, len, "%s", s->name);
+	    return((int)MIN(strlen(s->name) + 1, (size_t)len));
+	}
+
+	errno = ENOTTY;
+	return(-1);
+}
+
+/*
+ *	Stops the generator and deletes the Synthetic Joystick, the
+ *	reader's descriptor must already be closed.
+ */
+void JSSyntheticDelete(void *ptr)
+{
+	js_synthetic_struct *s = JS_SYNTHETIC(ptr);
+	if(s == NULL)
+	    return;
+
+	pthread_mutex_lock(&s->mutex);
+	s->stop = 1;
+	pthread_cond_signal(&s->cond);
+	pthread_mutex_unlock(&s->mutex);
+
+	/* Wake the generator if it is blocked writing */
+	shutdown(s->fd, SHUT_RDWR);
+
+	pthread_join(s->thread, NULL);
+
+	close(s->fd);
+	pthread_cond_destroy(&s->cond);
+	pthread_mutex_destroy(&s->mutex);
+	free(s);
+}
+
+#endif	/* __linux__ */
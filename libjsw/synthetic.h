@@ -0,0 +1,13 @@
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+#include <sys/types.h>
+#include "../include/jsw.h"
+
+
+extern void *JSSyntheticNew(const char *args, int *fd);
+extern int JSSyntheticIoctl(void *ptr, unsigned long request, void *arg);
+extern void JSSyntheticDelete(void *ptr);
+
+
+#endif	/* SYNTHETIC_H */
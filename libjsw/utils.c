@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #include <fcntl.h>
@@ -9,6 +10,10 @@
 
 #include "../include/jsw.h"
 
+#include "utils.h"
+
+
+uint64_t JSCurrentNS(void);
 
 /* Public functions */
 int JSIsInit(js_data_struct *jsd);
@@ -24,6 +29,18 @@ int JSDriverQueryVersion(
 #define CLIP(a,l,h)     (MIN(MAX((a),(l)),(h)))
 
 
+/*
+ *	Returns the current monotonic time in nanoseconds.
+ */
+uint64_t JSCurrentNS(void)
+{
+	struct timespec ts;
+	if(clock_gettime(CLOCK_MONOTONIC, &ts))
+	    return(0);
+	return(((uint64_t)ts.tv_sec * 1000000000) + (uint64_t)ts.tv_nsec);
+}
+
+
 /*
  *	Checks if the joystick is initialized.
  */
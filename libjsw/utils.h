@@ -0,0 +1,20 @@
+#ifndef UTILS_H
+#define UTILS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "../include/jsw.h"
+
+
+/* Hints to the CPU that this is a busy-poll loop */
+#if defined(__i386__) || defined(__x86_64__)
+# define JS_CPU_RELAX()	__builtin_ia32_pause()
+#else
+# define JS_CPU_RELAX()
+#endif
+
+
+extern uint64_t JSCurrentNS(void);
+
+
+#endif	/* UTILS_H */
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <poll.h>
+
+#include "../include/jsw.h"
+
+#include "hotplug.h"
+#include "pollpolicy.h"
+#include "utils.h"
+#include "private.h"
+
+
+/*
+ *	Number of joysticks that JSWaitEventMany() can wait on without
+ *	allocating:
+ */
+#define JS_WAIT_STATIC_FDS	8
+
+
+static int JSWaitPoll(struct pollfd *pfd, int total, int timeout_ms);
+
+/* Public functions */
+int JSWaitEvent(js_data_struct *jsd, int timeout_ms);
+int JSWaitEventMany(
+	js_data_struct *jsd, int total,
+	int timeout_ms, int *ready
+);
+
+
+#define MIN(a,b)        (((a) < (b)) ? (a) : (b))
+
+
+/*
+ *	Busy-polls the descriptors until any has events or until
+ *	timeout_ms milliseconds have passed, returns the same as
+ *	poll().
+ */
+static int JSWaitPoll(struct pollfd *pfd, int total, int timeout_ms)
+{
+	int n;
+	const uint64_t start = JSCurrentNS();
+
+	if(start == 0)
+	    return(poll(pfd, (nfds_t)total, timeout_ms));
+
+	for(;;)
+	{
+	    n = poll(pfd, (nfds_t)total, 0);
+	    if(n != 0)
+		return(n);
+
+	    if((timeout_ms >= 0) &&
+	       (((JSCurrentNS() - start) / 1000000) >= (uint64_t)timeout_ms)
+	    )
+		return(0);
+
+	    JS_CPU_RELAX();
+	}
+}
+
+
+/*
+ *	Waits until the joystick has events for JSUpdate() to handle or
+ *	until timeout_ms milliseconds have passed. If timeout_ms is
+ *	negative then waits forever.
+ *
+ *	Returns JSGotEvent if JSUpdate() should be called, JSNoEvent on
+ *	timeout or JSEventError on error.
+ */
+int JSWaitEvent(js_data_struct *jsd, int timeout_ms)
+{
+	if(jsd == NULL)
+	    return(JSEventError);
+
+	return(JSWaitEventMany(jsd, 1, timeout_ms, NULL));
+}
+
+/*
+ *	Waits until any of the total joysticks in the array jsd have
+ *	events for JSUpdate() to handle or until timeout_ms
+ *	milliseconds have passed. If timeout_ms is negative then waits
+ *	forever.
+ *
+ *	If ready is not NULL then it must be an array of total ints,
+ *	each is set to JSGotEvent or JSNoEvent for the joystick at the
+ *	same index.
+ *
+ *	A disconnected joystick that was initialized with
+ *	JSFlagReconnect is reported as having events when JSUpdate()
+ *	may try to re-attach it.
+ *
+ *	Returns JSGotEvent if JSUpdate() should be called on any of the
+ *	joysticks, JSNoEvent on timeout or JSEventError on error.
+ */
+int JSWaitEventMany(
+	js_data_struct *jsd, int total,
+	int timeout_ms, int *ready
+)
+{
+	int i, n, wait_ms, total_waitable = 0, busy = 0;
+	int status = JSNoEvent;
+	js_data_struct *jsd_ptr;
+	struct pollfd pfd_buf[JS_WAIT_STATIC_FDS], *pfd;
+
+	if((jsd == NULL) || (total <= 0))
+	    return(JSEventError);
+
+	if(total > JS_WAIT_STATIC_FDS)
+	{
+	    pfd = (struct pollfd *)malloc(total * sizeof(struct pollfd));
+	    if(pfd == NULL)
+		return(JSEventError);
+	}
+	else
+	{
+	    pfd = pfd_buf;
+	}
+
+	/* Set up the descriptors to wait on, the descriptors of the
+	 * joysticks that are not opened are negative and ignored by
+	 * poll()
+	 *
+	 * Wait no longer than any of the joysticks' poll policies
+	 * allow, busy-poll if any is in JSPollModeLatency
+	 */
+	wait_ms = -1;
+	for(i = 0; i < total; i++)
+	{
+	    jsd_ptr = &jsd[i];
+	    if(ready != NULL)
+		ready[i] = JSNoEvent;
+
+	    n = JSPollPolicyWaitMS(JS_PRIVATE(jsd_ptr)->poll_policy, timeout_ms);
+	    wait_ms = (wait_ms < 0) ? n : MIN(wait_ms, n);
+	    if(JSPollPolicyIsBusy(JS_PRIVATE(jsd_ptr)->poll_policy))
+		busy = 1;
+
+	    pfd[i].fd = jsd_ptr->fd;
+	    pfd[i].events = POLLIN;
+	    pfd[i].revents = 0;
+
+	    if(jsd_ptr->fd > -1)
+	    {
+		total_waitable++;
+	    }
+	    else if(JS_PRIVATE(jsd_ptr)->hotplug != NULL)
+	    {
+		/* Disconnected, wait no longer than until the next
+		 * reconnect attempt
+		 */
+		n = JSHotplugReconnectWaitMS(JS_PRIVATE(jsd_ptr)->hotplug);
+		wait_ms = (wait_ms < 0) ? n : MIN(wait_ms, n);
+		total_waitable++;
+	    }
+	}
+	if(total_waitable == 0)
+	{
+	    if(pfd != pfd_buf)
+		free(pfd);
+	    return(JSEventError);
+	}
+
+	if(busy)
+	    n = JSWaitPoll(pfd, total, wait_ms);
+	else
+	    n = poll(pfd, (nfds_t)total, wait_ms);
+	if((n < 0) && (errno != EINTR))
+	{
+	    if(pfd != pfd_buf)
+		free(pfd);
+	    return(JSEventError);
+	}
+
+	for(i = 0; i < total; i++)
+	{
+	    jsd_ptr = &jsd[i];
+
+	    /* Errors and hangups are reported as events so that
+	     * JSUpdate() can handle the disconnect
+	     */
+	    if(jsd_ptr->fd > -1)
+		n = (pfd[i].revents & (POLLIN | POLLERR | POLLHUP)) ? 1 : 0;
+	    else if(JS_PRIVATE(jsd_ptr)->hotplug != NULL)
+		n = (JSHotplugReconnectWaitMS(JS_PRIVATE(jsd_ptr)->hotplug) == 0) ? 1 : 0;
+	    else
+		n = 0;
+
+	    if(n)
+	    {
+		if(ready != NULL)
+		    ready[i] = JSGotEvent;
+		status = JSGotEvent;
+	    }
+	}
+
+	if(pfd != pfd_buf)
+	    free(pfd);
+
+	return(status);
+}